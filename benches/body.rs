@@ -3,10 +3,16 @@
 
 extern crate test;
 
-use bytes::Buf;
+use std::io;
+use std::pin::Pin;
+use std::task::{Context, Poll, Waker};
+
+use bytes::{Buf, Bytes};
 use futures_util::stream;
 use futures_util::StreamExt;
 use hyper::body::Body;
+use hyper::client::conn;
+use tokio::io::{AsyncRead, AsyncWrite, ReadBuf};
 
 macro_rules! bench_stream {
     ($bencher:ident, bytes: $bytes:expr, count: $count:expr, $total_ident:ident, $body_pat:pat, $block:expr) => {{
@@ -86,3 +92,105 @@ benches! {
     bytes_10_000_count_1, 10_000, 1;
     bytes_10_000_count_10, 10_000, 10;
 }
+
+// ===== Chunked decoding =====
+
+/// A transport that reads back a canned response once a request has been
+/// written to it.
+struct Replay {
+    resp: Bytes,
+    written: bool,
+    waker: Option<Waker>,
+}
+
+impl AsyncRead for Replay {
+    fn poll_read(
+        mut self: Pin<&mut Self>,
+        cx: &mut Context<'_>,
+        buf: &mut ReadBuf<'_>,
+    ) -> Poll<io::Result<()>> {
+        if !self.written {
+            self.waker = Some(cx.waker().clone());
+            return Poll::Pending;
+        }
+        let n = std::cmp::min(buf.remaining(), self.resp.len());
+        buf.put_slice(&self.resp.split_to(n));
+        Poll::Ready(Ok(()))
+    }
+}
+
+impl AsyncWrite for Replay {
+    fn poll_write(
+        mut self: Pin<&mut Self>,
+        _: &mut Context<'_>,
+        buf: &[u8],
+    ) -> Poll<io::Result<usize>> {
+        self.written = true;
+        if let Some(waker) = self.waker.take() {
+            waker.wake();
+        }
+        Poll::Ready(Ok(buf.len()))
+    }
+
+    fn poll_flush(self: Pin<&mut Self>, _: &mut Context<'_>) -> Poll<io::Result<()>> {
+        Poll::Ready(Ok(()))
+    }
+
+    fn poll_shutdown(self: Pin<&mut Self>, _: &mut Context<'_>) -> Poll<io::Result<()>> {
+        Poll::Ready(Ok(()))
+    }
+}
+
+fn chunked_response(bytes: usize, count: usize) -> Bytes {
+    let mut resp = b"HTTP/1.1 200 OK\r\ntransfer-encoding: chunked\r\n\r\n".to_vec();
+    for _ in 0..count {
+        resp.extend(format!("{:x}\r\n", bytes).as_bytes());
+        resp.extend(std::iter::repeat(b'x').take(bytes));
+        resp.extend(b"\r\n");
+    }
+    resp.extend(b"0\r\n\r\n");
+    resp.into()
+}
+
+macro_rules! chunked_benches {
+    ($($name:ident, $bytes:expr, $count:expr;)+) => (
+        mod chunked_decode {
+            use super::*;
+
+            $(
+            #[bench]
+            fn $name(b: &mut test::Bencher) {
+                let rt = tokio::runtime::Builder::new_current_thread()
+                    .build()
+                    .expect("rt build");
+
+                let total: usize = $bytes * $count;
+                b.bytes = total as u64;
+                let resp = chunked_response($bytes, $count);
+
+                b.iter(|| {
+                    rt.block_on(async {
+                        let io = Replay {
+                            resp: resp.clone(),
+                            written: false,
+                            waker: None,
+                        };
+                        let (mut tx, conn) = conn::handshake::<_, Body>(io).await.unwrap();
+                        tokio::spawn(conn);
+
+                        let res = tx.send_request(Default::default()).await.unwrap();
+                        let bytes = hyper::body::to_bytes(res.into_body()).await.unwrap();
+                        assert_eq!(bytes.len(), total);
+                    });
+                });
+            }
+            )+
+        }
+    )
+}
+
+chunked_benches! {
+    bytes_10_count_1_000, 10, 1_000;
+    bytes_100_count_1_000, 100, 1_000;
+    bytes_1_000_count_100, 1_000, 100;
+}
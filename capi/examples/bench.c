@@ -0,0 +1,693 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <assert.h>
+#include <time.h>
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <string.h>
+
+#include "hyper.h"
+
+//
+// Benchmarks the C API over loopback.
+//
+// A server and its clients run on the same executor and reactor, so every
+// request goes through the FFI layer twice: once for the client, and once
+// for the server. For each scenario this reports the requests per second,
+// the p50 and p99 latencies, and the allocations made per request.
+//
+// Usage: bench [-n requests] [-c connections] [-s body_size] [-m get|upload]
+//
+// Without options, every combination of the default connection counts,
+// body sizes and modes is run. Build libhyper with `--release` and point
+// `RPATH` at it for numbers worth comparing.
+//
+
+
+// ===== Allocation counting =====
+//
+// The allocations of libhyper go through the C allocator, so they can be
+// counted by wrapping it with glibc's own entry points.
+
+static size_t alloc_count = 0;
+
+#ifdef __GLIBC__
+#define COUNTS_ALLOCS 1
+
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t nmemb, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+extern void *__libc_memalign(size_t alignment, size_t size);
+extern void __libc_free(void *ptr);
+
+void *malloc(size_t size) {
+    alloc_count++;
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t nmemb, size_t size) {
+    alloc_count++;
+    return __libc_calloc(nmemb, size);
+}
+
+void *realloc(void *ptr, size_t size) {
+    if (!ptr) {
+        alloc_count++;
+    }
+    return __libc_realloc(ptr, size);
+}
+
+void *memalign(size_t alignment, size_t size) {
+    alloc_count++;
+    return __libc_memalign(alignment, size);
+}
+
+void *aligned_alloc(size_t alignment, size_t size) {
+    alloc_count++;
+    return __libc_memalign(alignment, size);
+}
+
+int posix_memalign(void **memptr, size_t alignment, size_t size) {
+    alloc_count++;
+    void *ptr = __libc_memalign(alignment, size);
+    if (!ptr) {
+        return ENOMEM;
+    }
+    *memptr = ptr;
+    return 0;
+}
+
+void free(void *ptr) {
+    __libc_free(ptr);
+}
+#else
+#define COUNTS_ALLOCS 0
+#endif
+
+
+// ===== IO =====
+
+struct conn_data {
+    int fd;
+    hyper_reactor *reactor;
+};
+
+static size_t read_cb(void *userdata, hyper_context *ctx, uint8_t *buf, size_t buf_len) {
+    struct conn_data *conn = (struct conn_data *)userdata;
+    ssize_t ret = read(conn->fd, buf, buf_len);
+
+    if (ret < 0) {
+        int err = errno;
+        if (err == EAGAIN) {
+            // would block, register interest
+            hyper_reactor_want_read(conn->reactor, conn->fd, ctx);
+            return HYPER_IO_PENDING;
+        } else {
+            // kaboom
+            return HYPER_IO_ERROR;
+        }
+    } else {
+        return ret;
+    }
+}
+
+static size_t write_cb(void *userdata, hyper_context *ctx, const uint8_t *buf, size_t buf_len) {
+    struct conn_data *conn = (struct conn_data *)userdata;
+    ssize_t ret = write(conn->fd, buf, buf_len);
+
+    if (ret < 0) {
+        int err = errno;
+        if (err == EAGAIN) {
+            // would block, register interest
+            hyper_reactor_want_write(conn->reactor, conn->fd, ctx);
+            return HYPER_IO_PENDING;
+        } else {
+            // kaboom
+            return HYPER_IO_ERROR;
+        }
+    } else {
+        return ret;
+    }
+}
+
+static hyper_io *new_io(struct conn_data *conn) {
+    hyper_io *io = hyper_io_new();
+    hyper_io_set_userdata(io, (void *)conn);
+    hyper_io_set_read(io, read_cb);
+    hyper_io_set_write(io, write_cb);
+    return io;
+}
+
+static int set_nonblocking(int fd) {
+    return fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+}
+
+static int listen_loopback(uint16_t *port) {
+    int sfd = socket(AF_INET, SOCK_STREAM, 0);
+    if (sfd == -1) {
+        return -1;
+    }
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = 0;
+
+    socklen_t addr_len = sizeof(addr);
+    if (bind(sfd, (struct sockaddr *)&addr, sizeof(addr)) != 0
+            || listen(sfd, 1024) != 0
+            || getsockname(sfd, (struct sockaddr *)&addr, &addr_len) != 0) {
+        close(sfd);
+        return -1;
+    }
+
+    *port = ntohs(addr.sin_port);
+    return sfd;
+}
+
+static int connect_loopback(uint16_t port) {
+    int sfd = socket(AF_INET, SOCK_STREAM, 0);
+    if (sfd == -1) {
+        return -1;
+    }
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(port);
+
+    if (connect(sfd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        close(sfd);
+        return -1;
+    }
+
+    return sfd;
+}
+
+
+// ===== Bodies =====
+
+#define STR_ARG(XX) (uint8_t *)XX, strlen(XX)
+
+#define CHUNK_SIZE (16 * 1024)
+
+static uint8_t chunk_bytes[CHUNK_SIZE];
+
+// The userdata is a `size_t *` of the bytes left to send.
+static int send_chunk(void *userdata, hyper_context *ctx, hyper_buf **chunk) {
+    size_t *remaining = (size_t *)userdata;
+
+    if (*remaining == 0) {
+        // the body is done
+        *chunk = NULL;
+    } else {
+        size_t len = *remaining < CHUNK_SIZE ? *remaining : CHUNK_SIZE;
+        *remaining -= len;
+        *chunk = hyper_buf_copy(chunk_bytes, len);
+    }
+
+    return HYPER_POLL_READY;
+}
+
+static int discard_chunk(void *userdata, const hyper_buf *chunk) {
+    return HYPER_ITER_CONTINUE;
+}
+
+static void set_content_length(hyper_headers *headers, size_t len) {
+    char value[32];
+    snprintf(value, sizeof(value), "%zu", len);
+    hyper_headers_set(headers, STR_ARG("Content-Length"), STR_ARG(value));
+}
+
+
+// ===== Connections =====
+
+typedef enum {
+    TASK_NOT_SET = 0, // tasks we don't know about won't have a userdata set
+    TASK_HANDSHAKE,
+    TASK_SEND,
+    TASK_RESP_BODY,
+    TASK_SERVE,
+    TASK_REQ_BODY,
+} task_kind;
+
+// Tasks point their userdata at one of these, to find their connection.
+struct task_tag {
+    task_kind kind;
+    void *conn;
+};
+
+struct bench;
+
+struct client_conn {
+    struct bench *bench;
+    struct conn_data io;
+    hyper_clientconn *client;
+    struct task_tag handshake_tag;
+    struct task_tag send_tag;
+    struct task_tag body_tag;
+    uint64_t started;
+    size_t body_remaining;
+};
+
+struct server_conn {
+    struct bench *bench;
+    struct conn_data io;
+    hyper_response_channel *channel;
+    struct task_tag serve_tag;
+    struct task_tag body_tag;
+    size_t body_remaining;
+};
+
+struct scenario {
+    int upload;
+    size_t body_size;
+    size_t conns;
+    size_t requests;
+};
+
+struct bench {
+    struct scenario scenario;
+    const hyper_executor *exec;
+    hyper_reactor *reactor;
+    struct client_conn *clients;
+    struct server_conn *servers;
+    size_t handshakes;
+    size_t serving;
+    size_t sent;
+    size_t completed;
+    uint64_t *latencies;
+    int failed;
+};
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void print_error(const char *what, hyper_error *err) {
+    uint8_t errbuf [256];
+    size_t errlen = hyper_error_print(err, errbuf, sizeof(errbuf));
+    printf("%s error: %.*s\n", what, (int) errlen, errbuf);
+    hyper_error_free(err);
+}
+
+static void handle_request(void *userdata, hyper_request *req, hyper_response_channel *channel) {
+    struct server_conn *conn = (struct server_conn *)userdata;
+
+    // Read the whole request body before responding, so the connection
+    // can be kept alive.
+    conn->channel = channel;
+    hyper_task *body = hyper_body_foreach(hyper_request_body(req), discard_chunk, NULL);
+    hyper_task_set_userdata(body, (void *)&conn->body_tag);
+    hyper_executor_push(conn->bench->exec, body);
+
+    hyper_request_free(req);
+}
+
+static void respond(struct server_conn *conn) {
+    struct scenario *scenario = &conn->bench->scenario;
+    hyper_response *resp = hyper_response_new();
+
+    size_t len = scenario->upload ? 0 : scenario->body_size;
+    set_content_length(hyper_response_headers(resp), len);
+    if (len > 0) {
+        conn->body_remaining = len;
+        hyper_body *body = hyper_body_new();
+        hyper_body_set_userdata(body, (void *)&conn->body_remaining);
+        hyper_body_set_data_func(body, send_chunk);
+        hyper_response_set_body(resp, body);
+    }
+
+    hyper_response_channel_send(conn->channel, resp);
+    conn->channel = NULL;
+}
+
+static void send_next(struct client_conn *conn) {
+    struct bench *b = conn->bench;
+    struct scenario *scenario = &b->scenario;
+
+    if (b->sent == scenario->requests) {
+        return;
+    }
+    b->sent++;
+
+    hyper_request *req = hyper_request_new();
+    hyper_headers *headers = hyper_request_headers(req);
+    hyper_request_set_uri(req, STR_ARG("/"));
+    hyper_headers_set(headers, STR_ARG("Host"), STR_ARG("127.0.0.1"));
+
+    if (scenario->upload) {
+        hyper_request_set_method(req, STR_ARG("POST"));
+        set_content_length(headers, scenario->body_size);
+        if (scenario->body_size > 0) {
+            conn->body_remaining = scenario->body_size;
+            hyper_body *body = hyper_body_new();
+            hyper_body_set_userdata(body, (void *)&conn->body_remaining);
+            hyper_body_set_data_func(body, send_chunk);
+            hyper_request_set_body(req, body);
+        }
+    } else {
+        hyper_request_set_method(req, STR_ARG("GET"));
+    }
+
+    conn->started = now_ns();
+    hyper_task *send = hyper_clientconn_send(conn->client, req);
+    hyper_task_set_userdata(send, (void *)&conn->send_tag);
+    hyper_executor_push(b->exec, send);
+}
+
+// Poll all ready tasks and act on them.
+static void poll_tasks(struct bench *b) {
+    while (1) {
+        hyper_task *task = hyper_executor_poll(b->exec);
+        if (!task) {
+            break;
+        }
+
+        struct task_tag *tag = (struct task_tag *)hyper_task_userdata(task);
+        if (!tag) {
+            // A background task for hyper completed...
+            hyper_task_free(task);
+            continue;
+        }
+
+        if (hyper_task_type(task) == HYPER_TASK_ERROR) {
+            print_error(tag->kind == TASK_SERVE ? "serve" : "client", hyper_task_value(task));
+            hyper_task_free(task);
+            if (tag->kind == TASK_SERVE) {
+                b->serving--;
+            }
+            b->failed = 1;
+            continue;
+        }
+
+        struct client_conn *client = (struct client_conn *)tag->conn;
+        struct server_conn *server = (struct server_conn *)tag->conn;
+        hyper_response *resp;
+
+        switch (tag->kind) {
+        case TASK_HANDSHAKE:
+            assert(hyper_task_type(task) == HYPER_TASK_CLIENTCONN);
+            client->client = hyper_task_value(task);
+            b->handshakes++;
+            break;
+        case TASK_SEND:
+            assert(hyper_task_type(task) == HYPER_TASK_RESPONSE);
+            resp = hyper_task_value(task);
+            hyper_task *body = hyper_body_foreach(hyper_response_body(resp), discard_chunk, NULL);
+            hyper_task_set_userdata(body, (void *)&client->body_tag);
+            hyper_executor_push(b->exec, body);
+            hyper_response_free(resp);
+            break;
+        case TASK_RESP_BODY:
+            b->latencies[b->completed++] = now_ns() - client->started;
+            send_next(client);
+            break;
+        case TASK_SERVE:
+            b->serving--;
+            break;
+        case TASK_REQ_BODY:
+            respond(server);
+            break;
+        case TASK_NOT_SET:
+            break;
+        }
+
+        hyper_task_free(task);
+    }
+}
+
+// Drive the executor and reactor until `*count` reaches `target`.
+static int drive_until(struct bench *b, size_t *count, size_t target) {
+    while (1) {
+        poll_tasks(b);
+        if (b->failed) {
+            return -1;
+        }
+        if (*count == target) {
+            return 0;
+        }
+
+        // All futures are pending on IO work, so wait on the reactor.
+        if (hyper_reactor_run_once(b->reactor, -1) < 0) {
+            printf("reactor error\n");
+            return -1;
+        }
+    }
+}
+
+static int open_conns(struct bench *b, int listener, uint16_t port) {
+    size_t conns = b->scenario.conns;
+
+    hyper_serverconn_options *server_opts = hyper_serverconn_options_new(b->exec);
+
+    for (size_t i = 0; i < conns; i++) {
+        struct client_conn *client = &b->clients[i];
+        struct server_conn *server = &b->servers[i];
+
+        int client_fd = connect_loopback(port);
+        int server_fd = client_fd < 0 ? -1 : accept(listener, NULL, NULL);
+        if (server_fd < 0) {
+            printf("failed to connect over loopback\n");
+            hyper_serverconn_options_free(server_opts);
+            return -1;
+        }
+        set_nonblocking(client_fd);
+        set_nonblocking(server_fd);
+
+        client->bench = b;
+        client->io.fd = client_fd;
+        client->io.reactor = b->reactor;
+        client->handshake_tag = (struct task_tag) { TASK_HANDSHAKE, client };
+        client->send_tag = (struct task_tag) { TASK_SEND, client };
+        client->body_tag = (struct task_tag) { TASK_RESP_BODY, client };
+
+        server->bench = b;
+        server->io.fd = server_fd;
+        server->io.reactor = b->reactor;
+        server->serve_tag = (struct task_tag) { TASK_SERVE, server };
+        server->body_tag = (struct task_tag) { TASK_REQ_BODY, server };
+
+        hyper_reactor_register_fd(b->reactor, client_fd);
+        hyper_reactor_register_fd(b->reactor, server_fd);
+
+        hyper_service *service = hyper_service_new(handle_request);
+        hyper_service_set_userdata(service, (void *)server);
+        hyper_task *serve = hyper_serverconn_serve(new_io(&server->io), service, server_opts);
+        hyper_task_set_userdata(serve, (void *)&server->serve_tag);
+        hyper_executor_push(b->exec, serve);
+        b->serving++;
+
+        hyper_clientconn_options *opts = hyper_clientconn_options_new();
+        hyper_clientconn_options_exec(opts, b->exec);
+        hyper_task *handshake = hyper_clientconn_handshake(new_io(&client->io), opts);
+        hyper_task_set_userdata(handshake, (void *)&client->handshake_tag);
+        hyper_executor_push(b->exec, handshake);
+    }
+
+    hyper_serverconn_options_free(server_opts);
+
+    return drive_until(b, &b->handshakes, conns);
+}
+
+static void close_conns(struct bench *b) {
+    static size_t no_servers = 0;
+    size_t conns = b->scenario.conns;
+
+    // Dropping the clients lets their connection tasks finish, and closing
+    // their sockets then lets the servers finish.
+    for (size_t i = 0; i < b->handshakes; i++) {
+        hyper_clientconn_free(b->clients[i].client);
+    }
+    poll_tasks(b);
+    for (size_t i = 0; i < conns; i++) {
+        if (b->clients[i].io.fd > 0) {
+            hyper_reactor_deregister_fd(b->reactor, b->clients[i].io.fd);
+            close(b->clients[i].io.fd);
+        }
+    }
+
+    b->failed = 0;
+    drive_until(b, &b->serving, no_servers);
+
+    for (size_t i = 0; i < conns; i++) {
+        if (b->servers[i].io.fd > 0) {
+            hyper_reactor_deregister_fd(b->reactor, b->servers[i].io.fd);
+            close(b->servers[i].io.fd);
+        }
+    }
+}
+
+static int compare_u64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a;
+    uint64_t y = *(const uint64_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+static int run_scenario(struct scenario scenario, int listener, uint16_t port) {
+    int ret = -1;
+    struct bench b;
+    memset(&b, 0, sizeof(b));
+    b.scenario = scenario;
+    b.exec = hyper_executor_new();
+    b.reactor = hyper_reactor_new();
+    b.clients = calloc(scenario.conns, sizeof(struct client_conn));
+    b.servers = calloc(scenario.conns, sizeof(struct server_conn));
+    b.latencies = calloc(scenario.requests, sizeof(uint64_t));
+
+    if (!b.reactor) {
+        printf("failed to create reactor\n");
+        goto done;
+    }
+
+    if (open_conns(&b, listener, port) < 0) {
+        goto close;
+    }
+
+    size_t allocs_before = alloc_count;
+    uint64_t started = now_ns();
+
+    for (size_t i = 0; i < scenario.conns; i++) {
+        send_next(&b.clients[i]);
+    }
+    if (drive_until(&b, &b.completed, scenario.requests) < 0) {
+        goto close;
+    }
+
+    uint64_t elapsed = now_ns() - started;
+    size_t allocs = alloc_count - allocs_before;
+
+    qsort(b.latencies, scenario.requests, sizeof(uint64_t), compare_u64);
+    uint64_t p50 = b.latencies[scenario.requests * 50 / 100];
+    uint64_t p99 = b.latencies[scenario.requests * 99 / 100];
+
+    printf("%-8s %10zu %6zu %9zu %12.0f %10.1f %10.1f ",
+        scenario.upload ? "upload" : "get",
+        scenario.body_size,
+        scenario.conns,
+        scenario.requests,
+        scenario.requests / (elapsed / 1e9),
+        p50 / 1e3,
+        p99 / 1e3);
+    if (COUNTS_ALLOCS) {
+        printf("%11.1f\n", (double) allocs / scenario.requests);
+    } else {
+        printf("%11s\n", "-");
+    }
+    ret = 0;
+
+close:
+    close_conns(&b);
+done:
+    free(b.latencies);
+    free(b.servers);
+    free(b.clients);
+    if (b.reactor) {
+        hyper_reactor_free(b.reactor);
+    }
+    hyper_executor_free(b.exec);
+
+    return ret;
+}
+
+static void usage(const char *name) {
+    printf("usage: %s [-n requests] [-c connections] [-s body_size] [-m get|upload]\n", name);
+}
+
+int main(int argc, char *argv[]) {
+    size_t default_conns[] = { 1, 10, 100 };
+    size_t default_sizes[] = { 0, 1024, 64 * 1024 };
+    int default_modes[] = { 0, 1 };
+
+    size_t *conns = default_conns;
+    size_t conns_len = sizeof(default_conns) / sizeof(default_conns[0]);
+    size_t *sizes = default_sizes;
+    size_t sizes_len = sizeof(default_sizes) / sizeof(default_sizes[0]);
+    int *modes = default_modes;
+    size_t modes_len = sizeof(default_modes) / sizeof(default_modes[0]);
+    size_t requests = 10000;
+
+    size_t conns_arg, size_arg;
+    int mode_arg;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "n:c:s:m:h")) != -1) {
+        switch (opt) {
+        case 'n':
+            requests = strtoul(optarg, NULL, 10);
+            break;
+        case 'c':
+            conns_arg = strtoul(optarg, NULL, 10);
+            conns = &conns_arg;
+            conns_len = 1;
+            break;
+        case 's':
+            size_arg = strtoul(optarg, NULL, 10);
+            sizes = &size_arg;
+            sizes_len = 1;
+            break;
+        case 'm':
+            if (strcmp(optarg, "get") == 0) {
+                mode_arg = 0;
+            } else if (strcmp(optarg, "upload") == 0) {
+                mode_arg = 1;
+            } else {
+                usage(argv[0]);
+                return 1;
+            }
+            modes = &mode_arg;
+            modes_len = 1;
+            break;
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (requests == 0) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    uint16_t port;
+    int listener = listen_loopback(&port);
+    if (listener < 0) {
+        printf("listen failed on loopback\n");
+        return 1;
+    }
+
+    printf("%-8s %10s %6s %9s %12s %10s %10s %11s\n",
+        "mode", "body", "conns", "requests", "req/s", "p50 (us)", "p99 (us)", "allocs/req");
+
+    for (size_t m = 0; m < modes_len; m++) {
+        for (size_t s = 0; s < sizes_len; s++) {
+            for (size_t c = 0; c < conns_len; c++) {
+                struct scenario scenario = {
+                    .upload = modes[m],
+                    .body_size = sizes[s],
+                    .conns = conns[c] < requests ? conns[c] : requests,
+                    .requests = requests,
+                };
+                if (scenario.conns == 0 || run_scenario(scenario, listener, port) < 0) {
+                    close(listener);
+                    return 1;
+                }
+            }
+        }
+    }
+
+    close(listener);
+
+    return 0;
+}
@@ -3,7 +3,6 @@
 #include <unistd.h>
 #include <fcntl.h>
 #include <errno.h>
-#include <sys/select.h>
 #include <assert.h>
 
 #include <sys/types.h>
@@ -16,8 +15,7 @@
 
 struct conn_data {
     int fd;
-    hyper_waker *read_waker;
-    hyper_waker *write_waker;
+    hyper_reactor *reactor;
 };
 
 static size_t read_cb(void *userdata, hyper_context *ctx, uint8_t *buf, size_t buf_len) {
@@ -28,10 +26,7 @@ static size_t read_cb(void *userdata, hyper_context *ctx, uint8_t *buf, size_t b
         int err = errno;
         if (err == EAGAIN) {
             // would block, register interest
-            if (conn->read_waker != NULL) {
-                hyper_waker_free(conn->read_waker);
-            }
-            conn->read_waker = hyper_context_waker(ctx);
+            hyper_reactor_want_read(conn->reactor, conn->fd, ctx);
             return HYPER_IO_PENDING;
         } else {
             // kaboom
@@ -50,10 +45,7 @@ static size_t write_cb(void *userdata, hyper_context *ctx, const uint8_t *buf, s
         int err = errno;
         if (err == EAGAIN) {
             // would block, register interest
-            if (conn->write_waker != NULL) {
-                hyper_waker_free(conn->write_waker);
-            }
-            conn->write_waker = hyper_context_waker(ctx);
+            hyper_reactor_want_write(conn->reactor, conn->fd, ctx);
             return HYPER_IO_PENDING;
         } else {
             // kaboom
@@ -65,14 +57,8 @@ static size_t write_cb(void *userdata, hyper_context *ctx, const uint8_t *buf, s
 }
 
 static void free_conn_data(struct conn_data *conn) {
-    if (conn->read_waker) {
-        hyper_waker_free(conn->read_waker);
-        conn->read_waker = NULL;
-    }
-    if (conn->write_waker) {
-        hyper_waker_free(conn->write_waker);
-        conn->write_waker = NULL;
-    }
+    hyper_reactor_deregister_fd(conn->reactor, conn->fd);
+    close(conn->fd);
 
     free(conn);
 }
@@ -158,15 +144,22 @@ int main(int argc, char *argv[]) {
         return 1;
     }
 
-    fd_set fds_read;
-    fd_set fds_write;
-    fd_set fds_excep;
+    // The reactor waits on the socket, and wakes the tasks using it
+    hyper_reactor *reactor = hyper_reactor_new();
+    if (!reactor) {
+        printf("failed to create reactor\n");
+        return 1;
+    }
 
     struct conn_data *conn = malloc(sizeof(struct conn_data));
 
     conn->fd = fd;
-    conn->read_waker = NULL;
-    conn->write_waker = NULL;
+    conn->reactor = reactor;
+
+    if (hyper_reactor_register_fd(reactor, fd) != HYPERE_OK) {
+        printf("failed to register socket with reactor\n");
+        return 1;
+    }
 
 
     // Hookup the IO
@@ -233,6 +226,8 @@ int main(int argc, char *argv[]) {
                 // Send it!
                 hyper_task *send = hyper_clientconn_send(client, req);
                 hyper_task_set_userdata(send, (void *)EXAMPLE_SEND);
+                // Give up on the response after 30 seconds
+                hyper_task_set_timeout(send, 30000);
                 printf("sending ...\n");
                 hyper_executor_push(exec, send);
 
@@ -288,6 +283,7 @@ int main(int argc, char *argv[]) {
                 hyper_task_free(task);
                 hyper_executor_free(exec);
                 free_conn_data(conn);
+                hyper_reactor_free(reactor);
 
                 return 0;
             case EXAMPLE_NOT_SET:
@@ -297,35 +293,12 @@ int main(int argc, char *argv[]) {
             }
         }
 
-        // All futures are pending on IO work, so select on the fds.
-
-        FD_ZERO(&fds_read);
-        FD_ZERO(&fds_write);
-        FD_ZERO(&fds_excep);
-
-        if (conn->read_waker) {
-            FD_SET(conn->fd, &fds_read);
-        }
-        if (conn->write_waker) {
-            FD_SET(conn->fd, &fds_write);
-        }
-
-        int sel_ret = select(conn->fd + 1, &fds_read, &fds_write, &fds_excep, NULL);
-
-        if (sel_ret < 0) {
-            printf("select() error\n");
+        // All futures are pending on IO work, so wait on the reactor, but
+        // no longer than until the next task deadline.
+        if (hyper_reactor_run_once(reactor, hyper_executor_next_timeout(exec)) < 0) {
+            printf("reactor error\n");
             return 1;
-        } else {
-            if (FD_ISSET(conn->fd, &fds_read)) {
-                hyper_waker_wake(conn->read_waker);
-                conn->read_waker = NULL;
-            }
-            if (FD_ISSET(conn->fd, &fds_write)) {
-                hyper_waker_wake(conn->write_waker);
-                conn->write_waker = NULL;
-            }
         }
-
     }
 
     return 0;
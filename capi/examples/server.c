@@ -0,0 +1,261 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <assert.h>
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netdb.h>
+#include <string.h>
+
+#include "hyper.h"
+
+
+struct conn_data {
+    int fd;
+    hyper_reactor *reactor;
+};
+
+static size_t read_cb(void *userdata, hyper_context *ctx, uint8_t *buf, size_t buf_len) {
+    struct conn_data *conn = (struct conn_data *)userdata;
+    ssize_t ret = read(conn->fd, buf, buf_len);
+
+    if (ret < 0) {
+        int err = errno;
+        if (err == EAGAIN) {
+            // would block, register interest
+            hyper_reactor_want_read(conn->reactor, conn->fd, ctx);
+            return HYPER_IO_PENDING;
+        } else {
+            // kaboom
+            return HYPER_IO_ERROR;
+        }
+    } else {
+        return ret;
+    }
+}
+
+static size_t write_cb(void *userdata, hyper_context *ctx, const uint8_t *buf, size_t buf_len) {
+    struct conn_data *conn = (struct conn_data *)userdata;
+    ssize_t ret = write(conn->fd, buf, buf_len);
+
+    if (ret < 0) {
+        int err = errno;
+        if (err == EAGAIN) {
+            // would block, register interest
+            hyper_reactor_want_write(conn->reactor, conn->fd, ctx);
+            return HYPER_IO_PENDING;
+        } else {
+            // kaboom
+            return HYPER_IO_ERROR;
+        }
+    } else {
+        return ret;
+    }
+}
+
+static void free_conn_data(struct conn_data *conn) {
+    hyper_reactor_deregister_fd(conn->reactor, conn->fd);
+    close(conn->fd);
+
+    free(conn);
+}
+
+static int listen_on(const char *host, const char *port) {
+    struct addrinfo hints;
+    memset(&hints, 0, sizeof(struct addrinfo));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_PASSIVE;
+
+    struct addrinfo *result, *rp;
+    if (getaddrinfo(host, port, &hints, &result) != 0) {
+        printf("dns failed for %s\n", host);
+        return -1;
+    }
+
+    int sfd;
+    for (rp = result; rp != NULL; rp = rp->ai_next) {
+        sfd = socket(rp->ai_family, rp->ai_socktype, rp->ai_protocol);
+        if (sfd == -1) {
+            continue;
+        }
+
+        int reuse = 1;
+        setsockopt(sfd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+        if (bind(sfd, rp->ai_addr, rp->ai_addrlen) == 0 && listen(sfd, 128) == 0) {
+            break;
+        } else {
+            close(sfd);
+        }
+    }
+
+    freeaddrinfo(result);
+
+    // no address succeeded
+    if (rp == NULL) {
+        printf("listen failed for %s\n", host);
+        return -1;
+    }
+
+    return sfd;
+}
+
+#define STR_ARG(XX) (uint8_t *)XX, strlen(XX)
+
+static int send_hello(void *userdata, hyper_context *ctx, hyper_buf **chunk) {
+    int *sent = (int *)userdata;
+
+    if (*sent) {
+        // the body is done
+        free(sent);
+        *chunk = NULL;
+    } else {
+        *sent = 1;
+        *chunk = hyper_buf_copy(STR_ARG("Hello from hyper!\n"));
+    }
+
+    return HYPER_POLL_READY;
+}
+
+static void handle_request(void *userdata, hyper_request *req, hyper_response_channel *channel) {
+    const uint8_t *method = hyper_request_method(req);
+    size_t method_len = hyper_request_method_len(req);
+    const uint8_t *path = hyper_request_path_and_query(req);
+    size_t path_len = hyper_request_path_and_query_len(req);
+
+    printf("%.*s %.*s\n", (int) method_len, method, (int) path_len, path);
+
+    // This example doesn't look at request bodies
+    hyper_request_free(req);
+
+    hyper_response *resp = hyper_response_new();
+    hyper_response_set_status(resp, 200);
+
+    hyper_headers *headers = hyper_response_headers(resp);
+    hyper_headers_set(headers, STR_ARG("Content-Type"), STR_ARG("text/plain"));
+
+    hyper_body *body = hyper_body_new();
+    int *sent = malloc(sizeof(int));
+    *sent = 0;
+    hyper_body_set_userdata(body, (void *)sent);
+    hyper_body_set_data_func(body, send_hello);
+    hyper_response_set_body(resp, body);
+
+    hyper_response_channel_send(channel, resp);
+}
+
+typedef enum {
+    EXAMPLE_NOT_SET = 0, // tasks we don't know about won't have a userdata set
+    EXAMPLE_SERVE
+} example_id;
+
+int main(int argc, char *argv[]) {
+    const char *host = argc > 1 ? argv[1] : "127.0.0.1";
+    const char *port = argc > 2 ? argv[2] : "8080";
+
+    int listener = listen_on(host, port);
+    if (listener < 0) {
+        return 1;
+    }
+    printf("listening on port %s on %s...\n", port, host);
+
+    // The reactor waits on the sockets, and wakes the tasks using them
+    hyper_reactor *reactor = hyper_reactor_new();
+    if (!reactor) {
+        printf("failed to create reactor\n");
+        return 1;
+    }
+
+    // We need an executor generally to poll futures
+    const hyper_executor *exec = hyper_executor_new();
+
+    // The same options are used for every connection
+    hyper_serverconn_options *opts = hyper_serverconn_options_new(exec);
+
+    // Serve one connection at a time, for simplicity
+    while (1) {
+        int fd = accept(listener, NULL, NULL);
+        if (fd < 0) {
+            printf("accept failed\n");
+            break;
+        }
+
+        if (fcntl(fd, F_SETFL, O_NONBLOCK) != 0) {
+            printf("failed to set socket to non-blocking\n");
+            close(fd);
+            continue;
+        }
+
+        struct conn_data *conn = malloc(sizeof(struct conn_data));
+
+        conn->fd = fd;
+        conn->reactor = reactor;
+
+        if (hyper_reactor_register_fd(reactor, fd) != HYPERE_OK) {
+            printf("failed to register socket with reactor\n");
+            close(fd);
+            free(conn);
+            continue;
+        }
+
+        // Hookup the IO
+        hyper_io *io = hyper_io_new();
+        hyper_io_set_userdata(io, (void *)conn);
+        hyper_io_set_read(io, read_cb);
+        hyper_io_set_write(io, write_cb);
+
+        hyper_service *service = hyper_service_new(handle_request);
+
+        hyper_task *serve = hyper_serverconn_serve(io, service, opts);
+        hyper_task_set_userdata(serve, (void *)EXAMPLE_SERVE);
+        hyper_executor_push(exec, serve);
+
+        // The polling state machine, until the connection is done!
+        int done = 0;
+        while (!done) {
+            // Poll all ready tasks and act on them...
+            while (1) {
+                hyper_task *task = hyper_executor_poll(exec);
+                if (!task) {
+                    break;
+                }
+                switch ((example_id) hyper_task_userdata(task)) {
+                case EXAMPLE_SERVE:
+                    if (hyper_task_type(task) == HYPER_TASK_ERROR) {
+                        hyper_error *err = hyper_task_value(task);
+                        uint8_t errbuf [256];
+                        size_t errlen = hyper_error_print(err, errbuf, sizeof(errbuf));
+                        printf("connection error: %.*s\n", (int) errlen, errbuf);
+                        hyper_error_free(err);
+                    }
+                    hyper_task_free(task);
+                    done = 1;
+                    break;
+                case EXAMPLE_NOT_SET:
+                    // A background task for hyper completed...
+                    hyper_task_free(task);
+                    break;
+                }
+            }
+
+            // All futures are pending on IO work, so wait on the reactor.
+            if (!done && hyper_reactor_run_once(reactor, -1) < 0) {
+                printf("reactor error\n");
+                return 1;
+            }
+        }
+
+        free_conn_data(conn);
+    }
+
+    hyper_serverconn_options_free(opts);
+    hyper_executor_free(exec);
+    hyper_reactor_free(reactor);
+    close(listener);
+
+    return 0;
+}
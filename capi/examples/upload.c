@@ -4,6 +4,7 @@
 #include <fcntl.h>
 #include <errno.h>
 #include <sys/select.h>
+#include <sys/uio.h>
 #include <assert.h>
 
 #include <sys/types.h>
@@ -28,10 +29,7 @@ static size_t read_cb(void *userdata, hyper_context *ctx, uint8_t *buf, size_t b
         int err = errno;
         if (err == EAGAIN) {
             // would block, register interest
-            if (conn->read_waker != NULL) {
-                hyper_waker_free(conn->read_waker);
-            }
-            conn->read_waker = hyper_context_waker(ctx);
+            conn->read_waker = hyper_context_waker_update(ctx, conn->read_waker);
             return HYPER_IO_PENDING;
         } else {
             // kaboom
@@ -50,10 +48,39 @@ static size_t write_cb(void *userdata, hyper_context *ctx, const uint8_t *buf, s
         int err = errno;
         if (err == EAGAIN) {
             // would block, register interest
-            if (conn->write_waker != NULL) {
-                hyper_waker_free(conn->write_waker);
-            }
-            conn->write_waker = hyper_context_waker(ctx);
+            conn->write_waker = hyper_context_waker_update(ctx, conn->write_waker);
+            return HYPER_IO_PENDING;
+        } else {
+            // kaboom
+            return HYPER_IO_ERROR;
+        }
+    } else {
+        return ret;
+    }
+}
+
+static size_t write_vectored_cb(void *userdata,
+                                hyper_context *ctx,
+                                const hyper_io_slice *bufs,
+                                size_t bufs_len) {
+    struct conn_data *conn = (struct conn_data *)userdata;
+    struct iovec iovs[64];
+
+    if (bufs_len > 64) {
+        bufs_len = 64;
+    }
+    for (size_t i = 0; i < bufs_len; i++) {
+        iovs[i].iov_base = (void *)bufs[i].buf;
+        iovs[i].iov_len = bufs[i].len;
+    }
+
+    ssize_t ret = writev(conn->fd, iovs, bufs_len);
+
+    if (ret < 0) {
+        int err = errno;
+        if (err == EAGAIN) {
+            // would block, register interest
+            conn->write_waker = hyper_context_waker_update(ctx, conn->write_waker);
             return HYPER_IO_PENDING;
         } else {
             // kaboom
@@ -118,13 +145,33 @@ struct upload_body {
     int fd;
     char *buf;
     size_t len;
+    // set while hyper still references `buf`
+    int in_flight;
+    hyper_waker *waker;
 };
 
+static void release_upload_chunk(void *userdata, const uint8_t *buf, size_t len) {
+    struct upload_body* upload = userdata;
+
+    upload->in_flight = 0;
+    if (upload->waker) {
+        hyper_waker_wake(upload->waker);
+        upload->waker = NULL;
+    }
+}
+
 static int poll_req_upload(void *userdata,
                            hyper_context *ctx,
                            hyper_buf **chunk) {
     struct upload_body* upload = userdata;
 
+    if (upload->in_flight) {
+        // hyper hasn't written out the previous chunk yet, wait for the
+        // release callback before reusing the buffer.
+        upload->waker = hyper_context_waker_update(ctx, upload->waker);
+        return HYPER_POLL_PENDING;
+    }
+
     ssize_t res = read(upload->fd, upload->buf, upload->len);
     if (res < 0) {
         printf("error reading upload file: %d", errno);
@@ -134,7 +181,8 @@ static int poll_req_upload(void *userdata,
         *chunk = NULL;
         return HYPER_POLL_READY;
     } else {
-        *chunk = hyper_buf_copy(upload->buf, res);
+        upload->in_flight = 1;
+        *chunk = hyper_buf_borrowed((uint8_t *)upload->buf, res, release_upload_chunk, upload);
         return HYPER_POLL_READY;
     }
 }
@@ -148,12 +196,12 @@ static int print_each_header(void *userdata,
     return HYPER_ITER_CONTINUE;
 }
 
-static void print_informational(void *userdata, hyper_response *resp) {
+static void print_informational(void *userdata, const hyper_response *resp) {
     uint16_t http_status = hyper_response_status(resp);
 
     printf("\nInformational (1xx): %d\n", http_status);
 
-    hyper_headers *headers = hyper_response_headers(resp);
+    hyper_headers *headers = hyper_response_headers((hyper_response *) resp);
     hyper_headers_foreach(headers, print_each_header, NULL);
     printf("\n");
 }
@@ -200,6 +248,8 @@ int main(int argc, char *argv[]) {
 
     upload.len = 8192;
     upload.buf = malloc(upload.len);
+    upload.in_flight = 0;
+    upload.waker = NULL;
 
     fd_set fds_read;
     fd_set fds_write;
@@ -217,6 +267,7 @@ int main(int argc, char *argv[]) {
     hyper_io_set_userdata(io, (void *)conn);
     hyper_io_set_read(io, read_cb);
     hyper_io_set_write(io, write_cb);
+    hyper_io_set_write_vectored(io, write_vectored_cb);
 
     printf("http handshake ...\n");
 
@@ -273,8 +324,10 @@ int main(int argc, char *argv[]) {
 
                 hyper_headers *req_headers = hyper_request_headers(req);
                 hyper_headers_set(req_headers, STR_ARG("host"), STR_ARG(host));
-                hyper_headers_set(req_headers, STR_ARG("expect"), STR_ARG("100-continue"));
 
+                // Hold back the body until the server agrees to it, or for
+                // at most one second if it doesn't answer.
+                hyper_request_expect_continue(req, 1000);
                 hyper_request_on_informational(req, print_informational, NULL);
 
                 // Prepare the req body
@@ -352,6 +405,9 @@ int main(int argc, char *argv[]) {
                     // Cleaning up before exiting
                     hyper_executor_free(exec);
                     free_conn_data(conn);
+                    if (upload.waker) {
+                        hyper_waker_free(upload.waker);
+                    }
                     free(upload.buf);
 
                     return 0;
@@ -376,7 +432,17 @@ int main(int argc, char *argv[]) {
             FD_SET(conn->fd, &fds_write);
         }
 
-        int sel_ret = select(conn->fd + 1, &fds_read, &fds_write, &fds_excep, NULL);
+        // Wake up in time for the expect-continue timer.
+        struct timeval tv;
+        struct timeval *timeout = NULL;
+        int timeout_ms = hyper_executor_next_timeout(exec);
+        if (timeout_ms >= 0) {
+            tv.tv_sec = timeout_ms / 1000;
+            tv.tv_usec = (timeout_ms % 1000) * 1000;
+            timeout = &tv;
+        }
+
+        int sel_ret = select(conn->fd + 1, &fds_read, &fds_write, &fds_excep, timeout);
 
         if (sel_ret < 0) {
             printf("select() error\n");
@@ -57,10 +57,12 @@ default = [
     "client",
     "ffi",
     "http1",
+    "server",
 ]
 
 http1 = []
 client = []
+server = []
 ffi = ["libc", "tokio/rt"]
 EOF
 
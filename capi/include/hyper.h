@@ -39,6 +39,17 @@
  */
 #define HYPER_HTTP_VERSION_2 20
 
+/*
+ Return in a codec function to indicate it succeeded.
+ */
+#define HYPER_CODEC_OK 0
+
+/*
+ Return in a codec function to indicate the data is invalid, or the codec
+ otherwise failed.
+ */
+#define HYPER_CODEC_ERROR 1
+
 /*
  Sentinel value to return from a read or write callback that the operation
  is pending.
@@ -104,6 +115,14 @@ typedef enum hyper_code {
    The peer sent an HTTP message that could not be parsed.
    */
   HYPERE_INVALID_PEER_MESSAGE,
+  /*
+   The task was canceled with `hyper_canceler_cancel`.
+   */
+  HYPERE_CANCELED,
+  /*
+   The task did not complete before its deadline.
+   */
+  HYPERE_TIMED_OUT,
 } hyper_code;
 
 /*
@@ -130,6 +149,10 @@ typedef enum hyper_task_return_type {
    The value of this task is `hyper_buf *`.
    */
   HYPER_TASK_BUF,
+  /*
+   The value of this task is `hyper_headers *`.
+   */
+  HYPER_TASK_HEADERS,
 } hyper_task_return_type;
 
 /*
@@ -142,6 +165,11 @@ typedef struct hyper_body hyper_body;
  */
 typedef struct hyper_buf hyper_buf;
 
+/*
+ A handle to cancel a task, even once it has been pushed to an executor.
+ */
+typedef struct hyper_canceler hyper_canceler;
+
 /*
  An HTTP client connection handle.
 
@@ -156,6 +184,17 @@ typedef struct hyper_clientconn hyper_clientconn;
  */
 typedef struct hyper_clientconn_options hyper_clientconn_options;
 
+/*
+ A pool of idle HTTP client connections, keyed by scheme and authority.
+ */
+typedef struct hyper_clientconn_pool hyper_clientconn_pool;
+
+/*
+ A streaming transform of body data, such as a decompressor, implemented
+ by C callbacks.
+ */
+typedef struct hyper_codec hyper_codec;
+
 /*
  An async context for a task that contains the related waker.
  */
@@ -171,6 +210,11 @@ typedef struct hyper_error hyper_error;
  */
 typedef struct hyper_executor hyper_executor;
 
+/*
+ A header name, parsed once so it can be reused to add many headers.
+ */
+typedef struct hyper_header_name hyper_header_name;
+
 /*
  An HTTP header map.
 
@@ -183,16 +227,62 @@ typedef struct hyper_headers hyper_headers;
  */
 typedef struct hyper_io hyper_io;
 
+/*
+ A handle to report the completion of reads and writes submitted by a
+ completion-based `hyper_io`.
+ */
+typedef struct hyper_io_completion hyper_io_completion;
+
+/*
+ A memory budget that client connections account their buffers to.
+
+ It counts the HTTP/1 read and write buffers of the connections made with
+ it, and the headers of their responses that have not been freed yet.
+ */
+typedef struct hyper_memory hyper_memory;
+
+/*
+ An IO reactor that waits for readiness of file descriptors, and wakes the
+ tasks waiting on them.
+
+ This uses `epoll` on Linux and `kqueue` on BSD and macOS.
+ */
+typedef struct hyper_reactor hyper_reactor;
+
 /*
  An HTTP request.
  */
 typedef struct hyper_request hyper_request;
 
+/*
+ A template for building many requests that share their method, version
+ and headers.
+ */
+typedef struct hyper_request_template hyper_request_template;
+
 /*
  An HTTP response.
  */
 typedef struct hyper_response hyper_response;
 
+/*
+ A channel to send the response to a request received by a `hyper_service`.
+ */
+typedef struct hyper_response_channel hyper_response_channel;
+
+/*
+ An options builder to configure an HTTP server connection.
+ */
+typedef struct hyper_serverconn_options hyper_serverconn_options;
+
+/*
+ A service that answers the requests received on a server connection.
+
+ The callback is called with each request, and a `hyper_response_channel *`
+ that the response is sent on.
+ */
+typedef struct hyper_service hyper_service;
+
 /*
  An async task.
  */
@@ -203,10 +293,133 @@ typedef struct hyper_task hyper_task;
  */
 typedef struct hyper_waker hyper_waker;
 
+/*
+ A snapshot of the stats of a client connection.
+
+ The IO counters are of the calls hyper made to the read and write
+ callbacks of the connection's `hyper_io`. For a completion-based IO,
+ they are of the submitted reads and writes instead, which are pending if
+ they had not completed once the submit callback returned.
+ */
+typedef struct hyper_clientconn_stats {
+  /*
+   Nanoseconds from `hyper_clientconn_handshake` until the handshake
+   completed.
+   */
+  uint64_t handshake_ns;
+  /*
+   The number of requests sent with `hyper_clientconn_send`.
+   */
+  uint64_t requests;
+  /*
+   The number of responses received.
+   */
+  uint64_t responses;
+  /*
+   The number of calls to the read callback.
+   */
+  uint64_t read_calls;
+  /*
+   How many of those calls returned `HYPER_IO_PENDING`.
+   */
+  uint64_t read_pending;
+  /*
+   The number of bytes read.
+   */
+  uint64_t read_bytes;
+  /*
+   The number of calls to the write callbacks.
+   */
+  uint64_t write_calls;
+  /*
+   How many of those calls returned `HYPER_IO_PENDING`.
+   */
+  uint64_t write_pending;
+  /*
+   The number of bytes written.
+   */
+  uint64_t write_bytes;
+} hyper_clientconn_stats;
+
+/*
+ The location of one header in a block of raw headers.
+
+ For the headers of a response, the offsets are from the start of the
+ buffer returned by `hyper_response_headers_raw()`.
+ */
+typedef struct hyper_header_span {
+  /*
+   The offset of the header name.
+   */
+  size_t name_offset;
+  /*
+   The length of the header name.
+   */
+  size_t name_len;
+  /*
+   The offset of the header value.
+   */
+  size_t value_offset;
+  /*
+   The length of the header value.
+   */
+  size_t value_len;
+} hyper_header_span;
+
+/*
+ A borrowed slice of bytes passed to a vectored write callback.
+
+ This has the same fields as a POSIX `struct iovec`, but the order and
+ layout are not guaranteed to match it.
+ */
+typedef struct hyper_io_slice {
+  /*
+   A pointer to the bytes of this slice.
+   */
+  const uint8_t *buf;
+  /*
+   The number of bytes in this slice.
+   */
+  size_t len;
+} hyper_io_slice;
+
+/*
+ A snapshot of the memory held by a connection or a budget, in bytes.
+ */
+typedef struct hyper_memory_usage {
+  /*
+   The capacity of the HTTP/1 read buffers.
+   */
+  size_t read_buf;
+  /*
+   The bytes waiting in the HTTP/1 write buffers, and the capacity of
+   the buffers message heads are written into.
+   */
+  size_t write_buf;
+  /*
+   The names and values of the headers of received responses that have
+   not been freed yet.
+   */
+  size_t headers;
+  /*
+   How many times a buffer was kept from growing because the budget's
+   limit was reached.
+   */
+  uint64_t limited;
+} hyper_memory_usage;
+
 typedef int (*hyper_body_foreach_callback)(void*, const struct hyper_buf*);
 
 typedef int (*hyper_body_data_callback)(void*, struct hyper_context*, struct hyper_buf**);
 
+typedef int (*hyper_body_trailers_callback)(void*, struct hyper_context*, struct hyper_headers**);
+
+typedef void (*hyper_buf_release_callback)(void*, const uint8_t*, size_t);
+
+typedef int (*hyper_codec_callback)(void*, const uint8_t*, size_t, size_t*, uint8_t*, size_t, size_t*, int);
+
+typedef void (*hyper_codec_drop_callback)(void*);
+
 typedef void (*hyper_request_on_informational_callback)(void*, const struct hyper_response*);
 
 typedef int (*hyper_headers_foreach_callback)(void*, const uint8_t*, size_t, const uint8_t*, size_t);
@@ -215,6 +428,16 @@ typedef size_t (*hyper_io_read_callback)(void*, struct hyper_context*, uint8_t*,
 
 typedef size_t (*hyper_io_write_callback)(void*, struct hyper_context*, const uint8_t*, size_t);
 
+typedef size_t (*hyper_io_write_vectored_callback)(void*, struct hyper_context*, const struct hyper_io_slice*, size_t);
+
+typedef void (*hyper_io_submit_read_callback)(void*, uint8_t*, size_t);
+
+typedef void (*hyper_io_submit_write_callback)(void*, const uint8_t*, size_t);
+
+typedef void (*hyper_service_callback)(void*, struct hyper_request*, struct hyper_response_channel*);
+
+typedef void (*hyper_executor_wake_callback)(void*);
+
 #ifdef __cplusplus
 extern "C" {
 #endif // __cplusplus
@@ -250,6 +473,60 @@ void hyper_body_free(struct hyper_body *body);
  */
 struct hyper_task *hyper_body_data(struct hyper_body *body);
 
+/*
+ Return a task that will poll the body for its trailers.
+
+ This should be called once the body has finished streaming data, such
+ as after `hyper_body_data` or `hyper_body_read_into` reported the end
+ of the body. A checksum computed over the data can then be checked
+ against a trailer, without buffering the body.
+
+ The task value may have different types depending on the outcome:
+
+ - `HYPER_TASK_HEADERS`: Success, and the body had trailers. The
+   `hyper_headers *` is owned by the caller, and must be freed with
+   `hyper_headers_free`. On HTTP/2, its values are not copied out of
+   the frame they were received in.
+ - `HYPER_TASK_ERROR`: An error retrieving the trailers.
+ - `HYPER_TASK_EMPTY`: The body had no trailers.
+
+ On HTTP/1, only a body sent with chunked framing can have trailers.
+ Up to 100 trailer fields, taking up to 16 KiB, are accepted. More than
+ that fails the body with an error, as invalid trailers do.
+
+ This does not consume the `hyper_body *`. However, it MUST NOT be used
+ or freed until the related task completes.
+ */
+struct hyper_task *hyper_body_trailers(struct hyper_body *body);
+
+/*
+ Return a task that will copy body data directly into a caller-provided
+ buffer.
+
+ The task copies as many bytes as are currently available, up to
+ `buf_len`, into `buf`. It only waits for more data if nothing has been
+ copied yet. When the task completes, the number of bytes copied is
+ written to `out_len`.
+
+ The task value may have different types depending on the outcome:
+
+ - `HYPER_TASK_EMPTY`: Success. If `*out_len` is `0`, the body has
+   finished streaming data.
+ - `HYPER_TASK_ERROR`: An error retrieving the data.
+
+ Data from a chunk that doesn't fit in `buf` is kept by the body, and
+ returned by the next read. If the body is instead set on a request or
+ response, that data is sent first.
+
+ This does not consume the `hyper_body *`, so it may be used to again.
+ However, it MUST NOT be used or freed until the related task completes.
+ The `buf` and `out_len` pointers must also stay valid until then.
+ */
+struct hyper_task *hyper_body_read_into(struct hyper_body *body,
+                                        uint8_t *buf,
+                                        size_t buf_len,
+                                        size_t *out_len);
+
 /*
  Return a task that will poll the body and execute the callback with each
  body chunk that is received.
@@ -294,6 +571,42 @@ void hyper_body_set_userdata(struct hyper_body *body, void *userdata);
  */
 void hyper_body_set_data_func(struct hyper_body *body, hyper_body_data_callback func);
 
+/*
+ Set the trailers callback for this body.
+
+ The callback is called once the data callback has reported the end of
+ the body, to get the trailers to send after it. It is passed the value
+ from `hyper_body_set_userdata`, so it can use state built up while
+ sending the data, such as a checksum.
+
+ To send trailers, the `hyper_headers **` argument should be set to a
+ `hyper_headers *` from `hyper_headers_new`, which hyper takes ownership
+ of, and `HYPER_POLL_READY` should be returned. Leaving it `NULL` sends
+ no trailers. Like the data callback, this can also return
+ `HYPER_POLL_PENDING` after saving a waker, or `HYPER_POLL_ERROR` to
+ abort the body.
+
+ Trailers are only sent on HTTP/2 connections. HTTP/1 connections do
+ not call the callback.
+ */
+void hyper_body_set_trailers_func(struct hyper_body *body, hyper_body_trailers_callback func);
+
+/*
+ Set this body to send `len` bytes of a file, starting at `offset`.
+
+ hyper reads the file itself, in chunks, into the buffers it writes to
+ the IO transport. This saves copying the data through a C buffer and
+ `hyper_buf_copy`. Since the length is known, a request with this body
+ gets a `Content-Length` instead of being chunked.
+
+ The `fd` must be a regular file, and stay open until the body is done,
+ as hyper doesn't close it. It is read with `pread`, so its file offset
+ is not changed. If the file ends early, the body fails.
+
+ The file is used instead of any data callback set on this body.
+ */
+enum hyper_code hyper_body_set_fd(struct hyper_body *body, int fd, uint64_t offset, uint64_t len);
+
 /*
  Create a new `hyper_buf *` by copying the provided bytes.
 
@@ -302,6 +615,25 @@ void hyper_body_set_data_func(struct hyper_body *body, hyper_body_data_callback
  */
 struct hyper_buf *hyper_buf_copy(const uint8_t *buf, size_t len);
 
+/*
+ Create a new `hyper_buf *` that references the provided bytes without
+ copying them.
+
+ The memory pointed to by `buf` must stay valid and unchanged until
+ hyper is done with it. When the last reference to the buffer is
+ dropped, hyper calls the `release` callback with the `userdata`, `buf`
+ and `len` arguments passed here, at which point the caller may free or
+ reuse the memory.
+
+ The `release` callback may be called from inside any hyper function
+ that drives a task, such as `hyper_executor_poll`, or during
+ `hyper_buf_free`.
+ */
+struct hyper_buf *hyper_buf_borrowed(const uint8_t *buf,
+                                     size_t len,
+                                     hyper_buf_release_callback release,
+                                     void *userdata);
+
 /*
  Get a pointer to the bytes in this buffer.
 
@@ -340,11 +672,40 @@ struct hyper_task *hyper_clientconn_handshake(struct hyper_io *io,
 
  Returns a task that needs to be polled until it is ready. When ready, the
  task yields a `hyper_response *`.
+
+ If pipelining was enabled with `hyper_clientconn_options_http1_pipeline`,
+ more requests can be sent before earlier responses are ready. They are
+ written in order as the pipeline has room, and their responses are
+ received in that same order.
  */
 struct hyper_task *hyper_clientconn_send(struct hyper_clientconn *conn, struct hyper_request *req);
 
+/*
+ Copy the stats of a client connection into `stats`.
+
+ The counters keep going up as the connection is used, so this can be
+ called again for a newer snapshot. Returns `HYPERE_INVALID_ARG` if the
+ connection was not made with `hyper_clientconn_options_stats` enabled.
+ */
+enum hyper_code hyper_clientconn_get_stats(const struct hyper_clientconn *conn,
+                                           struct hyper_clientconn_stats *stats);
+
+/*
+ Copy the memory held by a client connection into `usage`.
+
+ This includes the headers of its responses that have not been freed
+ yet. The `limited` count is only kept for the whole budget, so it is
+ always `0` here. Returns `HYPERE_INVALID_ARG` if the connection was not
+ made with `hyper_clientconn_options_memory`.
+ */
+enum hyper_code hyper_clientconn_get_memory_usage(const struct hyper_clientconn *conn,
+                                                  struct hyper_memory_usage *usage);
+
 /*
  Free a `hyper_clientconn *`.
+
+ If the connection was made with `hyper_clientconn_options_pool`, it is
+ returned to that pool once it is ready for another request.
  */
 void hyper_clientconn_free(struct hyper_clientconn *conn);
 
@@ -374,155 +735,630 @@ void hyper_clientconn_options_exec(struct hyper_clientconn_options *opts,
 enum hyper_code hyper_clientconn_options_http2(struct hyper_clientconn_options *opts, int enabled);
 
 /*
- Set the whether to include a copy of the raw headers in responses
- received on this connection.
+ Set the initial HTTP2 stream-level flow control window, in bytes.
 
- Pass `0` to disable, `1` to enable.
+ This disables the adaptive window set with
+ `hyper_clientconn_options_http2_adaptive_window`.
 
- If enabled, see `hyper_response_headers_raw()` for usage.
+ The `size` may be at most `2^31 - 1`.
  */
-enum hyper_code hyper_clientconn_options_headers_raw(struct hyper_clientconn_options *opts,
-                                                     int enabled);
+enum hyper_code hyper_clientconn_options_http2_initial_stream_window_size(struct hyper_clientconn_options *opts,
+                                                                          uint32_t size);
 
 /*
- Frees a `hyper_error`.
- */
-void hyper_error_free(struct hyper_error *err);
+ Set the initial HTTP2 connection-level flow control window, in bytes.
 
-/*
- Get an equivalent `hyper_code` from this error.
+ This disables the adaptive window set with
+ `hyper_clientconn_options_http2_adaptive_window`.
+
+ The `size` may be at most `2^31 - 1`.
  */
-enum hyper_code hyper_error_code(const struct hyper_error *err);
+enum hyper_code hyper_clientconn_options_http2_initial_connection_window_size(struct hyper_clientconn_options *opts,
+                                                                              uint32_t size);
 
 /*
- Print the details of this error to a buffer.
+ Set whether to use an adaptive HTTP2 flow control window, which grows
+ with the measured bandwidth-delay product of the connection.
 
- The `dst_len` value must be the maximum length that the buffer can
- store.
+ Pass `0` to disable, `1` to enable.
 
- The return value is number of bytes that were written to `dst`.
+ Enabling this overrides the initial window sizes set before.
  */
-size_t hyper_error_print(const struct hyper_error *err, uint8_t *dst, size_t dst_len);
+enum hyper_code hyper_clientconn_options_http2_adaptive_window(struct hyper_clientconn_options *opts,
+                                                               int enabled);
 
 /*
- Construct a new HTTP request.
- */
-struct hyper_request *hyper_request_new(void);
+ Set the maximum HTTP2 frame size to accept, in bytes.
 
-/*
- Free an HTTP request if not going to send it on a client.
+ The `size` must be between `16384` and `16777215`.
  */
-void hyper_request_free(struct hyper_request *req);
+enum hyper_code hyper_clientconn_options_http2_max_frame_size(struct hyper_clientconn_options *opts,
+                                                              uint32_t size);
 
 /*
- Set the HTTP Method of the request.
+ Set the maximum number of locally reset HTTP2 streams that are
+ remembered at once.
  */
-enum hyper_code hyper_request_set_method(struct hyper_request *req,
-                                         const uint8_t *method,
-                                         size_t method_len);
+enum hyper_code hyper_clientconn_options_http2_max_concurrent_reset_streams(struct hyper_clientconn_options *opts,
+                                                                            size_t max);
 
 /*
- Set the URI of the request.
+ Set the whether to include a copy of the raw headers in responses
+ received on this connection.
+
+ Pass `0` to disable, `1` to enable.
+
+ If enabled, see `hyper_response_headers_raw()` for usage. The headers
+ can then be read without allocating through
+ `hyper_response_headers_raw_spans()`.
  */
-enum hyper_code hyper_request_set_uri(struct hyper_request *req,
-                                      const uint8_t *uri,
-                                      size_t uri_len);
+enum hyper_code hyper_clientconn_options_headers_raw(struct hyper_clientconn_options *opts,
+                                                     int enabled);
 
 /*
- Set the preferred HTTP version of the request.
+ Set how many HTTP/1 requests may be written on a connection before
+ their responses have been received.
 
- The version value should be one of the `HYPER_HTTP_VERSION_` constants.
+ Responses are still delivered in the order the requests were sent.
+ Only idempotent requests, such as `GET`, are pipelined behind, and a
+ pipelined request may fail if the server closes the connection early.
 
- Note that this won't change the major HTTP version of the connection,
- since that is determined at the handshake step.
+ The default is `1`, which disables pipelining. Passing `0` is an error.
  */
-enum hyper_code hyper_request_set_version(struct hyper_request *req, int version);
+enum hyper_code hyper_clientconn_options_http1_pipeline(struct hyper_clientconn_options *opts,
+                                                        size_t depth);
 
 /*
- Gets a reference to the HTTP headers of this request
+ Set HTTP/1 reads to always use a buffer of exactly `size` bytes.
 
- This is not an owned reference, so it should not be accessed after the
- `hyper_request` has been consumed.
+ This disables the adaptive read buffer, and replaces any max set
+ with `hyper_clientconn_options_http1_max_buf_size`. Passing `0` is an
+ error.
  */
-struct hyper_headers *hyper_request_headers(struct hyper_request *req);
+enum hyper_code hyper_clientconn_options_http1_read_buf_exact_size(struct hyper_clientconn_options *opts,
+                                                                   size_t size);
 
 /*
- Set the body of the request.
+ Set the max size of the HTTP/1 read and write buffers, in bytes.
 
- The default is an empty body.
+ The read buffer grows as reads fill it, up to this size, and a
+ response head that does not fit in it is an error. Once this much is
+ waiting to be written, the request body is not polled for more.
 
- This takes ownership of the `hyper_body *`, you must not use it or
- free it after setting it on the request.
+ This re-enables the adaptive read buffer if an exact size was set. The
+ default is about 400kb, and passing less than 8192 is an error.
  */
-enum hyper_code hyper_request_set_body(struct hyper_request *req, struct hyper_body *body);
+enum hyper_code hyper_clientconn_options_http1_max_buf_size(struct hyper_clientconn_options *opts,
+                                                            size_t max);
 
 /*
- Set an informational (1xx) response callback.
+ Set the size of the first HTTP/1 read buffer, in bytes.
 
- The callback is called each time hyper receives an informational (1xx)
- response for this request.
+ The adaptive read buffer then grows or shrinks from this size, so a
+ connection expected to download large bodies can start with fewer
+ reads per megabyte. It never starts above the max buffer size, and
+ has no effect if an exact size was set.
 
- The third argument is an opaque user data pointer, which is passed to
- the callback each time.
+ The default is 8192, and passing less than that is an error.
+ */
+enum hyper_code hyper_clientconn_options_http1_read_buf_init_size(struct hyper_clientconn_options *opts,
+                                                                  size_t size);
 
- The callback is passed the `void *` data pointer, and a
- `hyper_response *` which can be inspected as any other response. The
- body of the response will always be empty.
+/*
+ Set whether HTTP/1 body buffers are kept separate and written with
+ vectored writes, instead of being copied into one flat buffer.
 
- NOTE: The `const hyper_response *` is just borrowed data, and will not
- be valid after the callback finishes. You must copy any data you wish
- to persist.
+ Pass `1` to queue buffers, which saves a copy of each body chunk but
+ calls the write callback once per buffer unless the IO has a vectored
+ write function. Pass `0` to always flatten them. By default, buffers
+ are queued if `hyper_io_set_write_vectored` was used.
  */
-enum hyper_code hyper_request_on_informational(struct hyper_request *req,
-                                               hyper_request_on_informational_callback callback,
-                                               void *data);
+enum hyper_code hyper_clientconn_options_http1_writev(struct hyper_clientconn_options *opts,
+                                                      int enabled);
 
 /*
- Free an HTTP response after using it.
+ Set the low and high watermarks of the HTTP/1 write buffer, in bytes.
+
+ A request body's data callback is polled until `high` bytes are
+ waiting to be written, and is then not polled again until the
+ connection has written them down to `low` bytes. Being polled again is
+ the signal that the connection can take more data, so a callback that
+ produces data from elsewhere never has more than about `high` bytes
+ buffered per connection.
+
+ By default, the body is polled whenever less than the max buffer size
+ is waiting. Passing a `low` that is not below `high` is an error.
  */
-void hyper_response_free(struct hyper_response *resp);
+enum hyper_code hyper_clientconn_options_http1_write_watermarks(struct hyper_clientconn_options *opts,
+                                                                size_t low,
+                                                                size_t high);
 
 /*
- Get the HTTP-Status code of this response.
+ Set whether connections made with these options keep stats.
 
- It will always be within the range of 100-599.
+ The stats are cheap counters and timestamps, read with
+ `hyper_clientconn_get_stats` and `hyper_response_head_latency_ns`.
+
+ Pass `0` to disable, `1` to enable. Default is disabled.
  */
-uint16_t hyper_response_status(const struct hyper_response *resp);
+enum hyper_code hyper_clientconn_options_stats(struct hyper_clientconn_options *opts, int enabled);
 
 /*
- Get a pointer to the reason-phrase of this response.
+ Set the memory budget that connections made with these options
+ account their buffers to, and stay within.
 
- This buffer is not null-terminated.
-
- This buffer is owned by the response, and should not be used after
- the response has been freed.
+ Many connections can share one budget, which then limits the memory
+ they hold in total. The usage of a single connection is read with
+ `hyper_clientconn_get_memory_usage`. Only HTTP/1 buffers are limited;
+ the flow control windows of HTTP2 already bound what it buffers.
 
- Use `hyper_response_reason_phrase_len()` to get the length of this
- buffer.
+ This does not consume the `memory`.
  */
-const uint8_t *hyper_response_reason_phrase(const struct hyper_response *resp);
+enum hyper_code hyper_clientconn_options_memory(struct hyper_clientconn_options *opts,
+                                                const struct hyper_memory *memory);
 
 /*
- Get the length of the reason-phrase of this response.
+ Set whether HTTP/1 connections free their read and write buffers
+ while idle.
 
- Use `hyper_response_reason_phrase()` to get the buffer pointer.
+ An idle connection otherwise keeps its buffers for the next request.
+ Freeing them makes many idle connections, such as those kept in a
+ pool, much cheaper, at the cost of allocating again once one is used.
+
+ Pass `0` to disable, `1` to enable. Default is disabled.
  */
-size_t hyper_response_reason_phrase_len(const struct hyper_response *resp);
+enum hyper_code hyper_clientconn_options_http1_release_idle_buffers(struct hyper_clientconn_options *opts,
+                                                                    int enabled);
 
 /*
- Get a reference to the full raw headers of this response.
+ Set the pool that connections made with these options belong to.
 
- You must have enabled `hyper_clientconn_options_headers_raw()`, or this
- will return NULL.
+ The `uri` must contain a scheme and authority, such as
+ `http://example.com`, which is the key the connection is pooled under.
+ Any path in it is ignored, so a request URI may be passed.
 
- The returned `hyper_buf *` is just a reference, owned by the response.
- You need to make a copy if you wish to use it after freeing the
- response.
+ Once the `hyper_clientconn *` from the handshake is freed with
+ `hyper_clientconn_free`, it is returned to the pool to be checked out
+ again, instead of being closed.
 
- The buffer is not null-terminated, see the `hyper_buf` functions for
- getting the bytes and length.
+ This does not consume the `pool`.
  */
-const struct hyper_buf *hyper_response_headers_raw(const struct hyper_response *resp);
+enum hyper_code hyper_clientconn_options_pool(struct hyper_clientconn_options *opts,
+                                              const struct hyper_clientconn_pool *pool,
+                                              const uint8_t *uri,
+                                              size_t uri_len);
+
+/*
+ Creates a new pool of idle client connections.
+
+ Up to `max_idle_per_host` idle connections are kept for each scheme
+ and authority. Connections that have been idle for longer than
+ `idle_timeout_ms` milliseconds are not handed out again, and `0`
+ means idle connections never expire.
+
+ The `exec` is used to wait for freed connections to be ready before
+ they are returned to the pool. This does not consume the `exec`.
+
+ Returns `NULL` if `max_idle_per_host` is `0`.
+ */
+struct hyper_clientconn_pool *hyper_clientconn_pool_new(const struct hyper_executor *exec,
+                                                        size_t max_idle_per_host,
+                                                        uint64_t idle_timeout_ms);
+
+/*
+ Free a `hyper_clientconn_pool *`.
+
+ Idle connections in the pool are closed. Connections that are
+ currently checked out keep working, but are not returned to the pool.
+ */
+void hyper_clientconn_pool_free(struct hyper_clientconn_pool *pool);
+
+/*
+ Take an idle connection for the `uri`'s scheme and authority out of
+ the pool, if there is one.
+
+ Returns `NULL` right away if no idle connection is available, in which
+ case a new connection can be made, or a task that waits for one can be
+ created with `hyper_clientconn_pool_checkout`.
+ */
+struct hyper_clientconn *hyper_clientconn_pool_take(struct hyper_clientconn_pool *pool,
+                                                    const uint8_t *uri,
+                                                    size_t uri_len);
+
+/*
+ Return a task that checks out a connection for the `uri`'s scheme and
+ authority from the pool.
+
+ If no connection is idle, the task waits until one is returned to the
+ pool. When ready, the task yields a `hyper_clientconn *`.
+ */
+struct hyper_task *hyper_clientconn_pool_checkout(struct hyper_clientconn_pool *pool,
+                                                  const uint8_t *uri,
+                                                  size_t uri_len);
+
+/*
+ Create a codec that transforms body data with `func`.
+
+ The callback is called with the `userdata`, `in_len` bytes of input
+ at `in`, and room for `out_len` bytes of output at `out`. It should
+ consume as much input as it can, write what it produces to `out`,
+ and set `*in_consumed` and `*out_written` to how many bytes it
+ consumed and wrote. It is called again with the rest of the input,
+ or with more room, until all input is consumed.
+
+ Once the input has ended, the callback is called with `finish` set to
+ `1`, and no input, until it writes no more output.
+
+ The same callback works for decoders and encoders. An encoder may
+ hold on to input until it has enough to compress, and writes out
+ the rest when `finish` is set.
+
+ The callback should return `HYPER_CODEC_OK`, or `HYPER_CODEC_ERROR` if
+ the data is invalid, which fails the body.
+ */
+struct hyper_codec *hyper_codec_new(hyper_codec_callback func, void *userdata);
+
+/*
+ Set a function that is called with the codec's `userdata` when the
+ codec is freed.
+
+ A codec given to a body is freed along with it, whether or not it was
+ read to the end, so this is where its state can be released, or put
+ back in a pool to be reused by another body.
+ */
+void hyper_codec_set_drop(struct hyper_codec *codec, hyper_codec_drop_callback func);
+
+/*
+ Free a `hyper_codec *` that was not given to a body.
+ */
+void hyper_codec_free(struct hyper_codec *codec);
+
+/*
+ Create a body whose data is the data of `body`, run through `codec`.
+
+ This is typically used to decompress a response body, once its
+ `Content-Encoding` header says which codec it needs. To compress a
+ request body, see `hyper_request_set_body_encoded`. The new body
+ can be read with `hyper_body_foreach`, `hyper_body_data` or
+ `hyper_body_read_into`. Each chunk of output is written straight
+ into the buffer that is then handed out, with at most `buf_size`
+ bytes per chunk, and only one chunk of `body` is held at a time.
+
+ Both the `body` and the `codec` are consumed in this function call.
+ Returns `NULL` if `buf_size` is `0`.
+ */
+struct hyper_body *hyper_body_with_codec(struct hyper_body *body,
+                                         struct hyper_codec *codec,
+                                         size_t buf_size);
+
+/*
+ Frees a `hyper_error`.
+ */
+void hyper_error_free(struct hyper_error *err);
+
+/*
+ Get an equivalent `hyper_code` from this error.
+ */
+enum hyper_code hyper_error_code(const struct hyper_error *err);
+
+/*
+ Print the details of this error to a buffer.
+
+ The `dst_len` value must be the maximum length that the buffer can
+ store.
+
+ The return value is number of bytes that were written to `dst`.
+ */
+size_t hyper_error_print(const struct hyper_error *err, uint8_t *dst, size_t dst_len);
+
+/*
+ Construct a new HTTP request.
+ */
+struct hyper_request *hyper_request_new(void);
+
+/*
+ Free an HTTP request if not going to send it on a client.
+ */
+void hyper_request_free(struct hyper_request *req);
+
+/*
+ Set the HTTP Method of the request.
+ */
+enum hyper_code hyper_request_set_method(struct hyper_request *req,
+                                         const uint8_t *method,
+                                         size_t method_len);
+
+/*
+ Set the URI of the request.
+ */
+enum hyper_code hyper_request_set_uri(struct hyper_request *req,
+                                      const uint8_t *uri,
+                                      size_t uri_len);
+
+/*
+ Set the preferred HTTP version of the request.
+
+ The version value should be one of the `HYPER_HTTP_VERSION_` constants.
+
+ Note that this won't change the major HTTP version of the connection,
+ since that is determined at the handshake step.
+ */
+enum hyper_code hyper_request_set_version(struct hyper_request *req, int version);
+
+/*
+ Gets a reference to the HTTP headers of this request
+
+ This is not an owned reference, so it should not be accessed after the
+ `hyper_request` has been consumed.
+ */
+struct hyper_headers *hyper_request_headers(struct hyper_request *req);
+
+/*
+ Set the body of the request.
+
+ The default is an empty body.
+
+ This takes ownership of the `hyper_body *`, you must not use it or
+ free it after setting it on the request.
+ */
+enum hyper_code hyper_request_set_body(struct hyper_request *req, struct hyper_body *body);
+
+/*
+ Set the body of the request, run through a `codec` that compresses it.
+
+ The `Content-Encoding` header is set to `encoding`, such as `gzip`,
+ and any `Content-Length` header is removed, since the compressed
+ length is not known up front. The body is then sent with chunked
+ framing on HTTP/1.1. Chunks of compressed data are at most
+ `buf_size` bytes.
+
+ The codec keeps its state for the whole body. To reuse the state
+ of an encoder for the next request, reset it in the drop callback
+ of the codec, and pass it in the `userdata` of a new codec.
+
+ Both the `body` and the `codec` are consumed in this function call,
+ even if it fails.
+ */
+enum hyper_code hyper_request_set_body_encoded(struct hyper_request *req,
+                                               struct hyper_body *body,
+                                               struct hyper_codec *codec,
+                                               const uint8_t *encoding,
+                                               size_t encoding_len,
+                                               size_t buf_size);
+
+/*
+ Set an informational (1xx) response callback.
+
+ The callback is called each time hyper receives an informational (1xx)
+ response for this request.
+
+ The third argument is an opaque user data pointer, which is passed to
+ the callback each time.
+
+ The callback is passed the `void *` data pointer, and a
+ `hyper_response *` which can be inspected as any other response. The
+ body of the response will always be empty.
+
+ NOTE: The `const hyper_response *` is just borrowed data, and will not
+ be valid after the callback finishes. You must copy any data you wish
+ to persist. To keep the responses instead, see
+ `hyper_request_on_informational_task`.
+ */
+enum hyper_code hyper_request_on_informational(struct hyper_request *req,
+                                               hyper_request_on_informational_callback callback,
+                                               void *data);
+
+/*
+ Deliver each informational (1xx) response to this request, such as
+ `103 Early Hints`, as its own task on the executor.
+
+ Each response is pushed to `exec` as a task that has already
+ completed, with type `HYPER_TASK_RESPONSE` and `userdata` as its
+ `hyper_task_userdata`, so it is returned by
+ `hyper_executor_poll` like any other task. The `hyper_response *` is
+ owned by the caller, and its headers are moved into it rather than
+ copied. The body of the response is always empty.
+
+ This can be used together with `hyper_request_on_informational`. It
+ does not consume the `exec`.
+ */
+enum hyper_code hyper_request_on_informational_task(struct hyper_request *req,
+                                                    const struct hyper_executor *exec,
+                                                    void *userdata);
+
+/*
+ Send this request with `Expect: 100-continue`, and hold back its body
+ until the server answers with `100 Continue`.
+
+ If the server sends a final response first, such as to reject a large
+ upload, the body is never sent. It fails instead, which closes the
+ connection once the response has been received.
+
+ A server may ignore the `Expect` header, and wait for the body without
+ answering. So once `timeout_ms` milliseconds have passed since the
+ request was sent with `hyper_clientconn_send`, the body is sent
+ anyway. This timer runs on the executor of the connection: the one
+ given to `hyper_clientconn_options_exec`, or to
+ `hyper_clientconn_pool_new` for pooled connections. See
+ `hyper_executor_next_timeout`.
+
+ The body is held back on HTTP/1.1 connections only. On HTTP/2, it is
+ sent right away.
+ */
+enum hyper_code hyper_request_expect_continue(struct hyper_request *req, uint64_t timeout_ms);
+
+/*
+ Get a pointer to the HTTP Method of this request.
+
+ This buffer is not null-terminated.
+
+ This buffer is owned by the request, and should not be used after
+ the request has been freed.
+
+ Use `hyper_request_method_len()` to get the length of this buffer.
+ */
+const uint8_t *hyper_request_method(const struct hyper_request *req);
+
+/*
+ Get the length of the HTTP Method of this request.
+
+ Use `hyper_request_method()` to get the buffer pointer.
+ */
+size_t hyper_request_method_len(const struct hyper_request *req);
+
+/*
+ Get a pointer to the path and query of this request's URI, such as
+ `/index.html?lang=en`.
+
+ This buffer is not null-terminated.
+
+ This buffer is owned by the request, and should not be used after
+ the request has been freed.
+
+ Use `hyper_request_path_and_query_len()` to get the length of this
+ buffer.
+ */
+const uint8_t *hyper_request_path_and_query(const struct hyper_request *req);
+
+/*
+ Get the length of the path and query of this request's URI.
+
+ Use `hyper_request_path_and_query()` to get the buffer pointer.
+ */
+size_t hyper_request_path_and_query_len(const struct hyper_request *req);
+
+/*
+ Get the HTTP version of this request.
+
+ The returned value could be:
+
+ - `HYPER_HTTP_VERSION_1_0`
+ - `HYPER_HTTP_VERSION_1_1`
+ - `HYPER_HTTP_VERSION_2`
+ - `HYPER_HTTP_VERSION_NONE` if newer (or older).
+ */
+int hyper_request_version(const struct hyper_request *req);
+
+/*
+ Take ownership of the body of this request.
+
+ It is safe to free the request even after taking ownership of its body.
+ */
+struct hyper_body *hyper_request_body(struct hyper_request *req);
+
+/*
+ Create a template from the method, version and headers of a request.
+
+ These are validated once, when the request is built, so each request
+ made from the template is a cheap copy. The URI, body and any other
+ options of the request are not part of the template.
+
+ The headers are also serialized once, so sending a request made from
+ the template over HTTP/1 copies them in one go. Headers added to such
+ a request are written after them. Changing one of the template's
+ headers on a request means that request serializes its headers as
+ usual.
+
+ This does not consume the request, which can still be sent or freed.
+ */
+struct hyper_request_template *hyper_request_template_new(const struct hyper_request *req);
+
+/*
+ Free a `hyper_request_template *`.
+
+ Requests already made from the template are not affected.
+ */
+void hyper_request_template_free(struct hyper_request_template *tmpl);
+
+/*
+ Make a new request from a template, with the provided URI.
+
+ The request can be changed further like any other, such as to add
+ headers specific to it, or to set a body.
+
+ Returns NULL if the URI is not valid.
+ */
+struct hyper_request *hyper_request_template_request(const struct hyper_request_template *tmpl,
+                                                     const uint8_t *uri,
+                                                     size_t uri_len);
+
+/*
+ Construct a new HTTP response, such as to answer a request received
+ by a server connection.
+
+ The default status is `200`, with an empty body.
+ */
+struct hyper_response *hyper_response_new(void);
+
+/*
+ Free an HTTP response after using it.
+ */
+void hyper_response_free(struct hyper_response *resp);
+
+/*
+ Get the HTTP-Status code of this response.
+
+ It will always be within the range of 100-599.
+ */
+uint16_t hyper_response_status(const struct hyper_response *resp);
+
+/*
+ Set the HTTP-Status code of this response.
+
+ The `status` must be within the range of 100-999.
+ */
+enum hyper_code hyper_response_set_status(struct hyper_response *resp, uint16_t status);
+
+/*
+ Get a pointer to the reason-phrase of this response.
+
+ This buffer is not null-terminated.
+
+ This buffer is owned by the response, and should not be used after
+ the response has been freed.
+
+ Use `hyper_response_reason_phrase_len()` to get the length of this
+ buffer.
+ */
+const uint8_t *hyper_response_reason_phrase(const struct hyper_response *resp);
+
+/*
+ Get the length of the reason-phrase of this response.
+
+ Use `hyper_response_reason_phrase()` to get the buffer pointer.
+ */
+size_t hyper_response_reason_phrase_len(const struct hyper_response *resp);
+
+/*
+ Get a reference to the full raw headers of this response.
+
+ You must have enabled `hyper_clientconn_options_headers_raw()`, or this
+ will return NULL.
+
+ The returned `hyper_buf *` is just a reference, owned by the response.
+ You need to make a copy if you wish to use it after freeing the
+ response.
+
+ The buffer is not null-terminated, see the `hyper_buf` functions for
+ getting the bytes and length.
+ */
+const struct hyper_buf *hyper_response_headers_raw(const struct hyper_response *resp);
+
+/*
+ Get the location of each header in the raw headers of this response.
+
+ You must have enabled `hyper_clientconn_options_headers_raw()`, or this
+ will return NULL.
+
+ The headers are in the order they were received, with the names in
+ their original casing. The number of headers is written to `len`.
+
+ The returned array is owned by the response, and the offsets are into
+ the buffer returned by `hyper_response_headers_raw()`. Reading the
+ headers this way doesn't allocate.
+ */
+const struct hyper_header_span *hyper_response_headers_raw_spans(const struct hyper_response *resp,
+                                                                 size_t *len);
 
 /*
  Get the HTTP version used by this response.
@@ -536,6 +1372,16 @@ const struct hyper_buf *hyper_response_headers_raw(const struct hyper_response *
  */
 int hyper_response_version(const struct hyper_response *resp);
 
+/*
+ Get how many nanoseconds after `hyper_clientconn_send` the head of this
+ response was received.
+
+ This includes any time the request spent waiting for the connection,
+ or pipelined behind other requests. Returns `0` if the connection was
+ not made with `hyper_clientconn_options_stats` enabled.
+ */
+uint64_t hyper_response_head_latency_ns(const struct hyper_response *resp);
+
 /*
  Gets a reference to the HTTP headers of this response.
 
@@ -551,6 +1397,30 @@ struct hyper_headers *hyper_response_headers(struct hyper_response *resp);
  */
 struct hyper_body *hyper_response_body(struct hyper_response *resp);
 
+/*
+ Set the body of the response.
+
+ The default is an empty body.
+
+ This takes ownership of the `hyper_body *`, you must not use it or
+ free it after setting it on the response.
+ */
+enum hyper_code hyper_response_set_body(struct hyper_response *resp, struct hyper_body *body);
+
+/*
+ Create an empty header map that is not part of a request or response,
+ such as for the trailers of a body.
+ */
+struct hyper_headers *hyper_headers_new(void);
+
+/*
+ Free a `hyper_headers *` owned by the caller, such as one returned by
+ `hyper_headers_new` or a `hyper_body_trailers` task.
+
+ This must not be called with the headers of a request or response.
+ */
+void hyper_headers_free(struct hyper_headers *headers);
+
 /*
  Iterates the headers passing each name and value pair to the callback.
 
@@ -586,6 +1456,50 @@ enum hyper_code hyper_headers_add(struct hyper_headers *headers,
                                   const uint8_t *value,
                                   size_t value_len);
 
+/*
+ Adds many headers at once, from a block of bytes holding their names
+ and values.
+
+ Each `hyper_header_span` gives the location of a name and its value in
+ the `block`, such as the spans from `hyper_response_headers_raw_spans()`.
+ The block is copied once, and all the headers share that copy.
+
+ Every header is validated before any is added. If one is invalid, this
+ returns `HYPERE_INVALID_ARG` and the headers are left unchanged.
+
+ Like `hyper_headers_add()`, this appends to any existing values.
+ */
+enum hyper_code hyper_headers_add_block(struct hyper_headers *headers,
+                                        const uint8_t *block,
+                                        size_t block_len,
+                                        const struct hyper_header_span *spans,
+                                        size_t spans_len);
+
+/*
+ Adds the provided value to the list of a parsed header name.
+
+ This is the same as `hyper_headers_add()`, but skips parsing the name
+ again, which is worthwhile for names used on many requests.
+ */
+enum hyper_code hyper_headers_add_named(struct hyper_headers *headers,
+                                        const struct hyper_header_name *name,
+                                        const uint8_t *value,
+                                        size_t value_len);
+
+/*
+ Parse a header name, to add headers with it using
+ `hyper_headers_add_named()`.
+
+ The original casing of the name is kept. Returns NULL if the name is
+ not a valid header name.
+ */
+struct hyper_header_name *hyper_header_name_new(const uint8_t *name, size_t name_len);
+
+/*
+ Free a `hyper_header_name *`.
+ */
+void hyper_header_name_free(struct hyper_header_name *name);
+
 /*
  Create a new IO type used to represent a transport.
 
@@ -646,16 +1560,295 @@ void hyper_io_set_read(struct hyper_io *io, hyper_io_read_callback func);
  */
 void hyper_io_set_write(struct hyper_io *io, hyper_io_write_callback func);
 
+/*
+ Set the vectored write function for this IO transport.
+
+ The `bufs` pointer is an array of `bufs_len` slices, which should be
+ written to the transport in order, as a single `writev` or `sendmsg`
+ would. The total number of bytes written should be the return value,
+ which may be less than the sum of all the slices.
+
+ Setting a vectored write function tells hyper the transport supports
+ vectored writes, so it will keep headers and body buffers separate
+ instead of copying them into one buffer. The regular write function is
+ still used when hyper only has a single buffer to write.
+
+ This must be set before the IO is passed to `hyper_clientconn_handshake()`.
+
+ The waker and return value rules are the same as for the function set
+ with `hyper_io_set_write`.
+ */
+void hyper_io_set_write_vectored(struct hyper_io *io, hyper_io_write_vectored_callback func);
+
+/*
+ Make this IO transport completion-based, instead of readiness-based.
+
+ Instead of trying a read or write right away, hyper calls
+ `submit_read` with a buffer it owns to read into, or `submit_write`
+ with a buffer of bytes to write, and the callback only queues the
+ operation, such as by preparing an io_uring submission. Once it has
+ completed, report it on the returned `hyper_io_completion *` with
+ `hyper_io_completion_read_done` or `hyper_io_completion_write_done`,
+ which wakes the connection's task. Only one read and one write are
+ submitted at a time, and their buffers hold `buf_size` bytes.
+
+ The buffers stay valid until the operation is reported done, even if
+ the connection is closed in the meantime. The read and write functions
+ of this IO are not used anymore.
+
+ The returned handle must be freed with `hyper_io_completion_free`, and
+ this must be set before the IO is passed to hyper. Returns `NULL` if
+ `buf_size` is `0`.
+ */
+struct hyper_io_completion *hyper_io_set_completion(struct hyper_io *io,
+                                                    hyper_io_submit_read_callback submit_read,
+                                                    hyper_io_submit_write_callback submit_write,
+                                                    size_t buf_size);
+
+/*
+ Report that the submitted read completed.
+
+ The `result` is the number of bytes read into the buffer, `0` if the
+ transport reached EOF, or `HYPER_IO_ERROR` if the read failed.
+ */
+void hyper_io_completion_read_done(const struct hyper_io_completion *completion, size_t result);
+
+/*
+ Report that the submitted write completed.
+
+ The `result` is the number of bytes written, which may be less than
+ were submitted, in which case hyper submits the rest again, or
+ `HYPER_IO_ERROR` if the write failed.
+ */
+void hyper_io_completion_write_done(const struct hyper_io_completion *completion, size_t result);
+
+/*
+ Free a `hyper_io_completion *`.
+
+ This must not be called while a read or write is still submitted.
+ */
+void hyper_io_completion_free(struct hyper_io_completion *completion);
+
+/*
+ Create a memory budget, to be shared by client connections with
+ `hyper_clientconn_options_memory`.
+
+ Once the connections hold `limit` bytes in total, their buffers stop
+ growing. A request body is then only polled once what was buffered of
+ it has been written, and a read that needs a bigger buffer fails the
+ connection. Pass `0` to only count, without a limit.
+ */
+struct hyper_memory *hyper_memory_new(size_t limit);
+
+/*
+ Free a `hyper_memory *`.
+
+ Connections made with it keep accounting to it until they are closed.
+ */
+void hyper_memory_free(struct hyper_memory *memory);
+
+/*
+ Copy the memory held by all connections of this budget into `usage`.
+ */
+enum hyper_code hyper_memory_get_usage(const struct hyper_memory *memory,
+                                       struct hyper_memory_usage *usage);
+
+/*
+ Creates a new IO reactor.
+
+ Returns `NULL` if the reactor could not be created, such as when the
+ platform has neither `epoll` nor `kqueue`.
+ */
+struct hyper_reactor *hyper_reactor_new(void);
+
+/*
+ Frees a reactor.
+
+ Any wakers still registered are dropped without being woken. This does
+ not close any of the registered file descriptors.
+ */
+void hyper_reactor_free(struct hyper_reactor *reactor);
+
+/*
+ Register a file descriptor with the reactor.
+
+ The file descriptor should be in non-blocking mode. It is watched for
+ both read and write readiness until it is deregistered.
+ */
+enum hyper_code hyper_reactor_register_fd(struct hyper_reactor *reactor, int fd);
+
+/*
+ Deregister a file descriptor from the reactor.
+
+ This must be called before the file descriptor is closed. Any wakers
+ waiting on it are dropped without being woken.
+ */
+enum hyper_code hyper_reactor_deregister_fd(struct hyper_reactor *reactor, int fd);
+
+/*
+ Register interest in the file descriptor becoming readable.
+
+ This should be called from a `hyper_io` read callback when the read
+ would block, right before returning `HYPER_IO_PENDING`. The reactor
+ keeps the waker from `ctx`, and wakes it once the file descriptor is
+ readable again.
+ */
+enum hyper_code hyper_reactor_want_read(struct hyper_reactor *reactor,
+                                        int fd,
+                                        struct hyper_context *ctx);
+
+/*
+ Register interest in the file descriptor becoming writable.
+
+ This should be called from a `hyper_io` write callback when the write
+ would block, right before returning `HYPER_IO_PENDING`. The reactor
+ keeps the waker from `ctx`, and wakes it once the file descriptor is
+ writable again.
+ */
+enum hyper_code hyper_reactor_want_write(struct hyper_reactor *reactor,
+                                         int fd,
+                                         struct hyper_context *ctx);
+
+/*
+ Wait for readiness events, and wake the tasks waiting on them.
+
+ This blocks for up to `timeout_ms` milliseconds, or forever if it is
+ negative. It should be called once `hyper_executor_poll()` returns
+ `NULL`, and the executor polled again after it returns.
+
+ The return value is the number of wakers that were woken, or `-1` if
+ waiting failed.
+ */
+int hyper_reactor_run_once(struct hyper_reactor *reactor, int timeout_ms);
+
+/*
+ Serve an HTTP server connection over the provided IO transport, passing
+ each request received to the `service`.
+
+ Both the `io` and the `service` are consumed in this function call. The
+ `options` are not, so they can be used to serve many connections.
+
+ The returned `hyper_task *` must be polled with an executor until the
+ connection closes, at which point it yields an empty value, or a
+ `hyper_error *` if the connection failed.
+ */
+struct hyper_task *hyper_serverconn_serve(struct hyper_io *io,
+                                          struct hyper_service *service,
+                                          const struct hyper_serverconn_options *options);
+
+/*
+ Creates a new set of HTTP server connection options.
+
+ The `exec` runs the background tasks of HTTP2 connections. This does
+ not consume the `exec`.
+ */
+struct hyper_serverconn_options *hyper_serverconn_options_new(const struct hyper_executor *exec);
+
+/*
+ Free a `hyper_serverconn_options *`.
+ */
+void hyper_serverconn_options_free(struct hyper_serverconn_options *opts);
+
+/*
+ Set whether HTTP/1 connections should support keep-alive.
+
+ Pass `0` to disable, `1` to enable. Default is enabled.
+ */
+enum hyper_code hyper_serverconn_options_http1_keep_alive(struct hyper_serverconn_options *opts,
+                                                          int enabled);
+
+/*
+ Set the whether to serve only HTTP2.
+
+ Pass `0` to disable, `1` to enable.
+ */
+enum hyper_code hyper_serverconn_options_http2(struct hyper_serverconn_options *opts, int enabled);
+
+/*
+ Create a service that calls `func` with each request received.
+
+ The callback takes ownership of the `hyper_request *`, and must send a
+ response on the `hyper_response_channel *`, either right away or later
+ from another callback.
+ */
+struct hyper_service *hyper_service_new(hyper_service_callback func);
+
+/*
+ Set the user data pointer passed to the service callback.
+ */
+void hyper_service_set_userdata(struct hyper_service *service, void *userdata);
+
+/*
+ Free a `hyper_service *` that was not given to a connection.
+ */
+void hyper_service_free(struct hyper_service *service);
+
+/*
+ Send the response to a request received by a `hyper_service`.
+
+ Both the `channel` and the `response` are consumed in this function
+ call. If the connection has closed in the meantime, the response is
+ freed.
+ */
+void hyper_response_channel_send(struct hyper_response_channel *channel,
+                                 struct hyper_response *response);
+
+/*
+ Free a `hyper_response_channel *` without sending a response.
+
+ The request fails, which closes an HTTP/1 connection, or resets the
+ stream of an HTTP2 one.
+ */
+void hyper_response_channel_free(struct hyper_response_channel *channel);
+
 /*
  Creates a new task executor.
  */
 const struct hyper_executor *hyper_executor_new(void);
 
+/*
+ Creates a new task executor that can be polled from several threads at
+ the same time.
+
+ The `threads` argument should be the number of threads that will call
+ `hyper_executor_poll()`. Tasks are spread over that many independent
+ queues. Each polling thread prefers its own queue, and takes over
+ other queues that no thread is currently polling, so work keeps
+ moving even if some threads are busy.
+
+ A completed task is always returned to the thread whose
+ `hyper_executor_poll()` call finished it.
+
+ Returns `NULL` if `threads` is `0`.
+ */
+const struct hyper_executor *hyper_executor_new_multi(size_t threads);
+
 /*
  Frees an executor and any incomplete tasks still part of it.
  */
 void hyper_executor_free(const struct hyper_executor *exec);
 
+/*
+ Set a callback that is called when the executor has work to do again.
+
+ The callback is called with `userdata` when a task is pushed, or a
+ pending task is woken, and the executor hasn't been polled since the
+ last time. A loop can sleep in `epoll_wait` or similar until then, such
+ as by having the callback write to an `eventfd`. Once
+ `hyper_executor_poll` returns `NULL`, the callback is called again
+ before any more work is ready.
+
+ The callback may be called from any thread that pushes or wakes tasks,
+ so it should only signal the polling thread, and not call back into
+ the executor.
+
+ This can only be set once. Returns `HYPERE_INVALID_ARG` if it was
+ already set.
+ */
+enum hyper_code hyper_executor_set_wake_callback(const struct hyper_executor *exec,
+                                                 hyper_executor_wake_callback func,
+                                                 void *userdata);
+
 /*
  Push a task onto the executor.
 
@@ -664,6 +1857,20 @@ void hyper_executor_free(const struct hyper_executor *exec);
  */
 enum hyper_code hyper_executor_push(const struct hyper_executor *exec, struct hyper_task *task);
 
+/*
+ Get how many milliseconds are left until the earliest deadline of the
+ tasks in this executor, or of a request on one of its connections
+ that waits for `100 Continue`.
+
+ A loop should not wait on IO for longer than this, such as by passing
+ it to `hyper_reactor_run_once()`, before polling the executor again.
+ Polling is what completes the tasks whose deadline has passed.
+
+ Returns `-1` if no running task has a deadline, and `0` if one has
+ already passed.
+ */
+int hyper_executor_next_timeout(const struct hyper_executor *exec);
+
 /*
  Polls the executor, trying to make progress on any tasks that have notified
  that they are ready again.
@@ -674,6 +1881,22 @@ enum hyper_code hyper_executor_push(const struct hyper_executor *exec, struct hy
  */
 struct hyper_task *hyper_executor_poll(const struct hyper_executor *exec);
 
+/*
+ Polls the executor like `hyper_executor_poll`, returning up to `cap`
+ completed tasks at once.
+
+ The completed tasks are written to the `out` array, which must have
+ room for at least `cap` pointers. The return value is the number of
+ tasks written, which is `0` if there are no ready tasks.
+
+ This drives the tasks while holding the executor's internal lock only
+ once, so it is cheaper than calling `hyper_executor_poll` repeatedly
+ when many tasks complete together.
+ */
+size_t hyper_executor_poll_many(const struct hyper_executor *exec,
+                                struct hyper_task **out,
+                                size_t cap);
+
 /*
  Free a task.
  */
@@ -702,26 +1925,98 @@ enum hyper_task_return_type hyper_task_type(struct hyper_task *task);
  */
 void hyper_task_set_userdata(struct hyper_task *task, void *userdata);
 
+/*
+ Set a deadline for this task, `timeout_ms` milliseconds after it is
+ pushed to an executor.
+
+ If the task has not completed by then, it is stopped, dropping
+ whatever it was doing, and returned by `hyper_executor_poll` with a
+ `hyper_error *` whose code is `HYPERE_TIMED_OUT`. See
+ `hyper_executor_next_timeout` for how long a loop may wait before
+ polling again.
+
+ A timeout too large to be a deadline, such as `UINT64_MAX`, never
+ expires. This must be called before the task is pushed.
+ */
+enum hyper_code hyper_task_set_timeout(struct hyper_task *task, uint64_t timeout_ms);
+
+/*
+ Get a handle that can cancel this task, even after it has been pushed
+ to an executor.
+
+ The `hyper_canceler *` must be freed with `hyper_canceler_free`, or
+ consumed by `hyper_canceler_cancel`. It can outlive the task.
+ */
+struct hyper_canceler *hyper_task_canceler(struct hyper_task *task);
+
 /*
  Retrieve the userdata that has been set via `hyper_task_set_userdata`.
  */
 void *hyper_task_userdata(struct hyper_task *task);
 
+/*
+ Cancel the task of this canceler.
+
+ A running task is stopped, dropping whatever it was doing, and
+ returned by `hyper_executor_poll` with a `hyper_error *` whose code is
+ `HYPERE_CANCELED`. If the task has already completed, this does
+ nothing.
+
+ A `hyper_clientconn_send` task whose request has not been written
+ yet leaves the connection ready for the next request. Once writing
+ has started, an HTTP/1 connection is closed, since it cannot be
+ reused, and an HTTP/2 stream is reset.
+
+ This consumes the canceler.
+ */
+void hyper_canceler_cancel(struct hyper_canceler *canceler);
+
+/*
+ Free a `hyper_canceler *` without canceling its task.
+ */
+void hyper_canceler_free(struct hyper_canceler *canceler);
+
 /*
  Copies a waker out of the task context.
  */
 struct hyper_waker *hyper_context_waker(struct hyper_context *cx);
 
+/*
+ Store the waker of the task context in `waker`, and return it.
+
+ If `waker` is `NULL`, this returns a new waker, like
+ `hyper_context_waker`. Otherwise the `waker` is reused: it is kept as
+ is if it already wakes this task, or updated in place if not. IO
+ callbacks can call this every time they return `HYPER_IO_PENDING`
+ without allocating a new waker each time.
+ */
+struct hyper_waker *hyper_context_waker_update(struct hyper_context *cx, struct hyper_waker *waker);
+
 /*
  Free a waker that hasn't been woken.
  */
 void hyper_waker_free(struct hyper_waker *waker);
 
 /*
- Free a waker that hasn't been woken.
+ Wake up the task associated with a waker.
+
+ This consumes the waker, it must not be used or freed afterwards.
  */
 void hyper_waker_wake(struct hyper_waker *waker);
 
+/*
+ Wake up the task associated with a waker, without consuming it.
+
+ The waker can be woken again later, and must still be freed.
+ */
+void hyper_waker_wake_by_ref(const struct hyper_waker *waker);
+
+/*
+ Returns `1` if the `waker` would wake the same task as the waker of the
+ task context, or `0` if not.
+ */
+int hyper_waker_will_wake(const struct hyper_waker *waker, struct hyper_context *cx);
+
 #ifdef __cplusplus
 } // extern "C"
 #endif // __cplusplus
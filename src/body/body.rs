@@ -427,7 +427,7 @@ impl HttpBody for Body {
             #[cfg(all(feature = "http2", any(feature = "client", feature = "server")))]
             Kind::H2 { content_length, .. } => opt_len!(content_length),
             #[cfg(feature = "ffi")]
-            Kind::Ffi(..) => SizeHint::default(),
+            Kind::Ffi(ref body) => body.size_hint(),
         }
     }
 }
@@ -578,6 +578,16 @@ impl Sender {
         tx.send(trailers).map_err(|_| crate::Error::new_closed())
     }
 
+    /// Try to send trailers on the trailers channel, without waiting.
+    #[cfg(feature = "http1")]
+    pub(crate) fn try_send_trailers(&mut self, trailers: HeaderMap) -> crate::Result<()> {
+        let tx = match self.trailers_tx.take() {
+            Some(tx) => tx,
+            None => return Err(crate::Error::new_closed()),
+        };
+        tx.send(trailers).map_err(|_| crate::Error::new_closed())
+    }
+
     /// Try to send data on this channel.
     ///
     /// # Errors
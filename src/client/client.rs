@@ -751,7 +751,7 @@ enum ClientConnectError {
 
 /// A marker to identify what version a pooled connection is.
 #[derive(Clone, Copy, Debug, PartialEq, Eq, Hash)]
-pub(super) enum Ver {
+pub(crate) enum Ver {
     Auto,
     Http2,
 }
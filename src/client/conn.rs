@@ -149,6 +149,18 @@ pub struct Builder {
     h1_max_buf_size: Option<usize>,
     #[cfg(feature = "ffi")]
     h1_headers_raw: bool,
+    #[cfg(feature = "ffi")]
+    h1_pipeline_depth: usize,
+    #[cfg(feature = "ffi")]
+    h1_read_buf_init_size: Option<usize>,
+    #[cfg(feature = "ffi")]
+    h1_writev: Option<bool>,
+    #[cfg(feature = "ffi")]
+    h1_write_watermarks: Option<(usize, usize)>,
+    #[cfg(feature = "ffi")]
+    h1_memory: Option<Arc<crate::ffi::ConnMemory>>,
+    #[cfg(feature = "ffi")]
+    h1_release_idle_buffers: bool,
     #[cfg(feature = "http2")]
     h2_builder: proto::h2::client::Config,
     version: Proto,
@@ -225,7 +237,7 @@ impl<B> SendRequest<B> {
         .await
     }
 
-    pub(super) fn is_ready(&self) -> bool {
+    pub(crate) fn is_ready(&self) -> bool {
         self.dispatch.is_ready()
     }
 
@@ -299,6 +311,25 @@ where
         ResponseFuture { inner }
     }
 
+    /// Queues a `Request` on the associated connection, even if it isn't
+    /// ready for another one yet.
+    ///
+    /// A pipelining connection picks queued requests up in order, as soon
+    /// as it has room for them.
+    #[cfg(feature = "ffi")]
+    pub(crate) fn send_request_queued(&mut self, req: Request<B>) -> ResponseFuture {
+        let inner = match self.dispatch.send_queued(req) {
+            Ok(rx) => ResponseFutureState::Waiting(rx),
+            Err(_req) => {
+                debug!("connection was closed");
+                let err = crate::Error::new_canceled().with("connection was closed");
+                ResponseFutureState::Error(Some(err))
+            }
+        };
+
+        ResponseFuture { inner }
+    }
+
     pub(super) fn send_request_retryable(
         &mut self,
         req: Request<B>,
@@ -532,6 +563,18 @@ impl Builder {
             h1_max_buf_size: None,
             #[cfg(feature = "ffi")]
             h1_headers_raw: false,
+            #[cfg(feature = "ffi")]
+            h1_pipeline_depth: 1,
+            #[cfg(feature = "ffi")]
+            h1_read_buf_init_size: None,
+            #[cfg(feature = "ffi")]
+            h1_writev: None,
+            #[cfg(feature = "ffi")]
+            h1_write_watermarks: None,
+            #[cfg(feature = "ffi")]
+            h1_memory: None,
+            #[cfg(feature = "ffi")]
+            h1_release_idle_buffers: false,
             #[cfg(feature = "http2")]
             h2_builder: Default::default(),
             #[cfg(feature = "http1")]
@@ -574,14 +617,14 @@ impl Builder {
         self
     }
 
-    pub(super) fn h1_read_buf_exact_size(&mut self, sz: Option<usize>) -> &mut Builder {
+    pub(crate) fn h1_read_buf_exact_size(&mut self, sz: Option<usize>) -> &mut Builder {
         self.h1_read_buf_exact_size = sz;
         self.h1_max_buf_size = None;
         self
     }
 
     #[cfg(feature = "http1")]
-    pub(super) fn h1_max_buf_size(&mut self, max: usize) -> &mut Self {
+    pub(crate) fn h1_max_buf_size(&mut self, max: usize) -> &mut Self {
         assert!(
             max >= proto::h1::MINIMUM_MAX_BUFFER_SIZE,
             "the max_buf_size cannot be smaller than the minimum that h1 specifies."
@@ -598,6 +641,72 @@ impl Builder {
         self
     }
 
+    /// Sets how many HTTP/1 requests may be written before their responses
+    /// have been read.
+    ///
+    /// Responses are still delivered in the order the requests were sent.
+    /// Only idempotent requests are pipelined behind.
+    ///
+    /// Default is 1, which disables pipelining.
+    #[cfg(feature = "ffi")]
+    pub(crate) fn http1_pipeline_depth(&mut self, depth: usize) -> &mut Self {
+        self.h1_pipeline_depth = depth;
+        self
+    }
+
+    /// Sets the size of the first HTTP/1 read, which adaptive reads then
+    /// grow or shrink from.
+    ///
+    /// Has no effect on exact size reads. Default is 8kb.
+    #[cfg(feature = "ffi")]
+    pub(crate) fn http1_read_buf_init_size(&mut self, sz: usize) -> &mut Self {
+        self.h1_read_buf_init_size = Some(sz);
+        self
+    }
+
+    /// Sets whether HTTP/1 body buffers are queued to be written with
+    /// vectored writes, instead of being copied into a single buffer.
+    ///
+    /// Default is to queue them if the IO supports vectored writes.
+    #[cfg(feature = "ffi")]
+    pub(crate) fn http1_writev(&mut self, enabled: bool) -> &mut Self {
+        self.h1_writev = Some(enabled);
+        self
+    }
+
+    /// Sets the low and high watermarks of the HTTP/1 write buffer.
+    ///
+    /// Once `high` bytes are buffered, the body is not polled again until
+    /// the buffer is flushed down to `low` bytes.
+    ///
+    /// Default is unset, which polls the body whenever the buffer is below
+    /// its max size.
+    #[cfg(feature = "ffi")]
+    pub(crate) fn http1_write_watermarks(&mut self, low: usize, high: usize) -> &mut Self {
+        self.h1_write_watermarks = Some((low, high));
+        self
+    }
+
+    /// Sets where the HTTP/1 read and write buffers are accounted, and
+    /// whose budget they are kept within.
+    ///
+    /// Default is unset, which doesn't account them.
+    #[cfg(feature = "ffi")]
+    pub(crate) fn http1_memory(&mut self, memory: Arc<crate::ffi::ConnMemory>) -> &mut Self {
+        self.h1_memory = Some(memory);
+        self
+    }
+
+    /// Sets whether the HTTP/1 buffers are freed while the connection is
+    /// idle, instead of being kept for the next request.
+    ///
+    /// Default is false.
+    #[cfg(feature = "ffi")]
+    pub(crate) fn http1_release_idle_buffers(&mut self, enabled: bool) -> &mut Self {
+        self.h1_release_idle_buffers = enabled;
+        self
+    }
+
     /// Sets whether HTTP2 is required.
     ///
     /// Default is false.
@@ -793,7 +902,29 @@ impl Builder {
                     if let Some(max) = opts.h1_max_buf_size {
                         conn.set_max_buf_size(max);
                     }
-                    let cd = proto::h1::dispatch::Client::new(rx);
+                    #[cfg(feature = "ffi")]
+                    conn.set_pipeline_depth(opts.h1_pipeline_depth);
+                    #[cfg(feature = "ffi")]
+                    {
+                        if let Some(sz) = opts.h1_read_buf_init_size {
+                            conn.set_read_buf_init_size(sz);
+                        }
+                        if let Some(enabled) = opts.h1_writev {
+                            conn.set_writev(enabled);
+                        }
+                        if let Some((low, high)) = opts.h1_write_watermarks {
+                            conn.set_write_watermarks(low, high);
+                        }
+                        if let Some(memory) = opts.h1_memory {
+                            conn.set_memory(memory);
+                        }
+                        conn.set_release_idle_buffers(opts.h1_release_idle_buffers);
+                    }
+
+                    #[allow(unused_mut)]
+                    let mut cd = proto::h1::dispatch::Client::new(rx);
+                    #[cfg(feature = "ffi")]
+                    cd.set_pipeline_depth(opts.h1_pipeline_depth);
                     let dispatch = proto::h1::Dispatcher::new(cd, conn);
                     ProtoClient::H1 { h1: dispatch }
                 }
@@ -102,6 +102,20 @@ impl<T, U> Sender<T, U> {
             .map_err(|mut e| (e.0).0.take().expect("envelope not dropped").0)
     }
 
+    /// Sends without waiting for the Receiver to ask for more.
+    ///
+    /// The inner channel is unbounded, so the Receiver takes these in
+    /// order whenever it is ready.
+    #[cfg(feature = "ffi")]
+    pub(crate) fn send_queued(&mut self, val: T) -> Result<Promise<U>, T> {
+        self.buffered_once = true;
+        let (tx, rx) = oneshot::channel();
+        self.inner
+            .send(Envelope(Some((val, Callback::NoRetry(tx)))))
+            .map(move |_| rx)
+            .map_err(|mut e| (e.0).0.take().expect("envelope not dropped").0)
+    }
+
     #[cfg(feature = "http2")]
     pub(crate) fn unbound(self) -> UnboundedSender<T, U> {
         UnboundedSender {
@@ -63,6 +63,6 @@ cfg_feature! {
     mod client;
     pub mod conn;
     pub(super) mod dispatch;
-    mod pool;
+    pub(crate) mod pool;
     pub mod service;
 }
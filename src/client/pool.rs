@@ -11,12 +11,12 @@ use futures_channel::oneshot;
 #[cfg(feature = "runtime")]
 use tokio::time::{Duration, Instant, Interval};
 
-use super::client::Ver;
+pub(crate) use super::client::Ver;
 use crate::common::{exec::Exec, task, Future, Pin, Poll, Unpin};
 
 // FIXME: allow() required due to `impl Trait` leaking types to this lint
 #[allow(missing_debug_implementations)]
-pub(super) struct Pool<T> {
+pub(crate) struct Pool<T> {
     // If the pool is disabled, this is None.
     inner: Option<Arc<Mutex<PoolInner<T>>>>,
 }
@@ -26,7 +26,7 @@ pub(super) struct Pool<T> {
 // This is a trait to allow the `client::pool::tests` to work for `i32`.
 //
 // See https://github.com/hyperium/hyper/issues/1429
-pub(super) trait Poolable: Unpin + Send + Sized + 'static {
+pub(crate) trait Poolable: Unpin + Send + Sized + 'static {
     fn is_open(&self) -> bool;
     /// Reserve this connection.
     ///
@@ -42,7 +42,7 @@ pub(super) trait Poolable: Unpin + Send + Sized + 'static {
 /// used for multiple requests.
 // FIXME: allow() required due to `impl Trait` leaking types to this lint
 #[allow(missing_debug_implementations)]
-pub(super) enum Reservation<T> {
+pub(crate) enum Reservation<T> {
     /// This connection could be used multiple times, the first one will be
     /// reinserted into the `idle` pool, and the second will be given to
     /// the `Checkout`.
@@ -54,7 +54,7 @@ pub(super) enum Reservation<T> {
 }
 
 /// Simple type alias in case the key type needs to be adjusted.
-pub(super) type Key = (http::uri::Scheme, http::uri::Authority); //Arc<String>;
+pub(crate) type Key = (http::uri::Scheme, http::uri::Authority); //Arc<String>;
 
 struct PoolInner<T> {
     // A flag that a connection is being established, and the connection
@@ -89,9 +89,9 @@ struct PoolInner<T> {
 struct WeakOpt<T>(Option<Weak<T>>);
 
 #[derive(Clone, Copy, Debug)]
-pub(super) struct Config {
-    pub(super) idle_timeout: Option<Duration>,
-    pub(super) max_idle_per_host: usize,
+pub(crate) struct Config {
+    pub(crate) idle_timeout: Option<Duration>,
+    pub(crate) max_idle_per_host: usize,
 }
 
 impl Config {
@@ -101,7 +101,7 @@ impl Config {
 }
 
 impl<T> Pool<T> {
-    pub(super) fn new(config: Config, __exec: &Exec) -> Pool<T> {
+    pub(crate) fn new(config: Config, __exec: &Exec) -> Pool<T> {
         let inner = if config.is_enabled() {
             Some(Arc::new(Mutex::new(PoolInner {
                 connecting: HashSet::new(),
@@ -125,8 +125,11 @@ impl<T> Pool<T> {
         self.inner.is_some()
     }
 
-    #[cfg(test)]
-    pub(super) fn no_timer(&self) {
+    /// Prevent an actual interval from being created for this pool, such as
+    /// when it isn't used from within a tokio runtime. Expired idle
+    /// connections are then only removed when checking out.
+    #[cfg(any(test, feature = "ffi"))]
+    pub(crate) fn no_timer(&self) {
         // Prevent an actual interval from being created for this pool...
         #[cfg(feature = "runtime")]
         {
@@ -141,7 +144,7 @@ impl<T> Pool<T> {
 impl<T: Poolable> Pool<T> {
     /// Returns a `Checkout` which is a future that resolves if an idle
     /// connection becomes available.
-    pub(super) fn checkout(&self, key: Key) -> Checkout<T> {
+    pub(crate) fn checkout(&self, key: Key) -> Checkout<T> {
         Checkout {
             key,
             pool: self.clone(),
@@ -151,7 +154,7 @@ impl<T: Poolable> Pool<T> {
 
     /// Ensure that there is only ever 1 connecting task for HTTP/2
     /// connections. This does nothing for HTTP/1.
-    pub(super) fn connecting(&self, key: &Key, ver: Ver) -> Option<Connecting<T>> {
+    pub(crate) fn connecting(&self, key: &Key, ver: Ver) -> Option<Connecting<T>> {
         if ver == Ver::Http2 {
             if let Some(ref enabled) = self.inner {
                 let mut inner = enabled.lock().unwrap();
@@ -201,7 +204,7 @@ impl<T: Poolable> Pool<T> {
     }
     */
 
-    pub(super) fn pooled(
+    pub(crate) fn pooled(
         &self,
         #[cfg_attr(not(feature = "http2"), allow(unused_mut))] mut connecting: Connecting<T>,
         value: T,
@@ -482,7 +485,7 @@ impl<T> Clone for Pool<T> {
 
 /// A wrapped poolable value that tries to reinsert to the Pool on Drop.
 // Note: The bounds `T: Poolable` is needed for the Drop impl.
-pub(super) struct Pooled<T: Poolable> {
+pub(crate) struct Pooled<T: Poolable> {
     value: Option<T>,
     is_reused: bool,
     key: Key,
@@ -555,7 +558,7 @@ struct Idle<T> {
 
 // FIXME: allow() required due to `impl Trait` leaking types to this lint
 #[allow(missing_debug_implementations)]
-pub(super) struct Checkout<T> {
+pub(crate) struct Checkout<T> {
     key: Key,
     pool: Pool<T>,
     waiter: Option<oneshot::Receiver<T>>,
@@ -684,7 +687,7 @@ impl<T> Drop for Checkout<T> {
 
 // FIXME: allow() required due to `impl Trait` leaking types to this lint
 #[allow(missing_debug_implementations)]
-pub(super) struct Connecting<T: Poolable> {
+pub(crate) struct Connecting<T: Poolable> {
     key: Key,
     pool: WeakOpt<Mutex<PoolInner<T>>>,
 }
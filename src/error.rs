@@ -141,6 +141,11 @@ pub(super) enum User {
 #[derive(Debug)]
 pub(super) struct TimedOut;
 
+// Sentinel type to indicate the error was caused by an FFI canceler.
+#[cfg(feature = "ffi")]
+#[derive(Debug)]
+pub(super) struct CanceledByUser;
+
 impl Error {
     /// Returns true if this was an HTTP parse error.
     pub fn is_parse(&self) -> bool {
@@ -567,6 +572,18 @@ impl fmt::Display for TimedOut {
 
 impl StdError for TimedOut {}
 
+// ===== impl CanceledByUser ====
+
+#[cfg(feature = "ffi")]
+impl fmt::Display for CanceledByUser {
+    fn fmt(&self, f: &mut fmt::Formatter<'_>) -> fmt::Result {
+        f.write_str("canceled by the user")
+    }
+}
+
+#[cfg(feature = "ffi")]
+impl StdError for CanceledByUser {}
+
 #[cfg(test)]
 mod tests {
     use super::*;
@@ -1,8 +1,13 @@
 //! HTTP extensions
 
+#[cfg(all(feature = "http1", feature = "ffi"))]
+use std::sync::Arc;
+
 use bytes::Bytes;
 #[cfg(feature = "http1")]
 use http::header::{HeaderName, IntoHeaderName, ValueIter};
+#[cfg(all(feature = "http1", feature = "ffi"))]
+use http::header::{CONNECTION, CONTENT_LENGTH, TRANSFER_ENCODING};
 use http::HeaderMap;
 
 /// A map from header names to their original casing as received in an HTTP message.
@@ -62,3 +67,70 @@ impl HeaderCaseMap {
         self.0.append(name, orig);
     }
 }
+
+/// Headers serialized ahead of time, to be copied as they are into every
+/// HTTP/1 message that has them, such as the requests made from a template.
+///
+/// When the rest of the message's headers are written, only those with
+/// a name held in the block are skipped. Whoever attaches this to a
+/// message must drop it if any header with one of those names changes.
+#[cfg(all(feature = "http1", feature = "ffi"))]
+#[derive(Clone, Debug)]
+pub(crate) struct EncodedHeaders {
+    block: Bytes,
+    names: Arc<HeaderMap<()>>,
+}
+
+#[cfg(all(feature = "http1", feature = "ffi"))]
+impl EncodedHeaders {
+    /// Serialize the headers that have an original casing for each value.
+    ///
+    /// The headers hyper may change while encoding a message are left out,
+    /// as are any without an original casing, so they are still written
+    /// with the connection's case options. Returns `None` if that leaves
+    /// nothing to serialize.
+    pub(crate) fn new(headers: &HeaderMap, orig_case: &HeaderCaseMap) -> Option<EncodedHeaders> {
+        let mut block = Vec::new();
+        let mut names = HeaderMap::default();
+
+        for name in headers.keys() {
+            if name == CONTENT_LENGTH || name == TRANSFER_ENCODING || name == CONNECTION {
+                continue;
+            }
+            let values = headers.get_all(name);
+            if orig_case.get_all_internal(name).count() < values.iter().count() {
+                continue;
+            }
+
+            for (value, orig_name) in values.iter().zip(orig_case.get_all_internal(name)) {
+                block.extend_from_slice(orig_name);
+                // Same as the encoder, for headers sent as `X-Empty:\r\n`.
+                if value.is_empty() {
+                    block.extend_from_slice(b":\r\n");
+                } else {
+                    block.extend_from_slice(b": ");
+                    block.extend_from_slice(value.as_bytes());
+                    block.extend_from_slice(b"\r\n");
+                }
+            }
+            names.insert(name.clone(), ());
+        }
+
+        if names.is_empty() {
+            return None;
+        }
+        Some(EncodedHeaders {
+            block: block.into(),
+            names: Arc::new(names),
+        })
+    }
+
+    pub(crate) fn block(&self) -> &[u8] {
+        &self.block
+    }
+
+    /// Whether the block holds the headers with this name.
+    pub(crate) fn contains(&self, name: &HeaderName) -> bool {
+        self.names.contains_key(name)
+    }
+}
@@ -1,26 +1,65 @@
 use std::ffi::c_void;
 use std::mem::ManuallyDrop;
+use std::pin::Pin;
 use std::ptr;
+use std::sync::Arc;
 use std::task::{Context, Poll};
 
 use http::HeaderMap;
 use libc::{c_int, size_t};
 
+use super::codec::CodecStage;
+use super::error::hyper_code;
+use super::http_types::{hyper_headers, ContinueGate};
+use super::recycle;
 use super::task::{hyper_context, hyper_task, hyper_task_return_type, AsTaskType};
 use super::{UserDataPointer, HYPER_ITER_CONTINUE};
-use crate::body::{Body, Bytes, HttpBody as _};
+use crate::body::{Body, Buf as _, Bytes, HttpBody as _, SizeHint};
 
 /// A streaming HTTP body.
-pub struct hyper_body(pub(super) Body);
+pub struct hyper_body {
+    pub(super) body: Body,
+    /// The unread part of a chunk partially copied by `hyper_body_read_into`.
+    remaining: Bytes,
+}
 
 /// A buffer of bytes that is sent or received on a `hyper_body`.
 pub struct hyper_buf(pub(crate) Bytes);
 
 pub(crate) struct UserBody {
     data_func: hyper_body_data_callback,
+    trailers_func: Option<hyper_body_trailers_callback>,
     userdata: *mut c_void,
+    file: Option<FileRegion>,
+    codec: Option<Box<CodecStage>>,
+    gated: Option<Box<GatedBody>>,
+    prefixed: Option<Box<PrefixedBody>>,
+}
+
+/// A body that is held back until its `ContinueGate` opens.
+struct GatedBody {
+    gate: Arc<ContinueGate>,
+    inner: Body,
+}
+
+/// A body whose first bytes were already taken from it, and are sent
+/// first.
+struct PrefixedBody {
+    prefix: Bytes,
+    inner: Body,
+}
+
+/// A region of a file sent as a body, set with `hyper_body_set_fd`.
+#[cfg_attr(not(unix), allow(dead_code))]
+struct FileRegion {
+    fd: c_int,
+    offset: u64,
+    remaining: u64,
 }
 
+/// The most bytes read from a file for each chunk of its body.
+const FILE_CHUNK_SIZE: usize = 64 * 1024;
+
 // ===== Body =====
 
 type hyper_body_foreach_callback = extern "C" fn(*mut c_void, *const hyper_buf) -> c_int;
@@ -28,12 +67,17 @@ type hyper_body_foreach_callback = extern "C" fn(*mut c_void, *const hyper_buf)
 type hyper_body_data_callback =
     extern "C" fn(*mut c_void, *mut hyper_context<'_>, *mut *mut hyper_buf) -> c_int;
 
+type hyper_body_trailers_callback =
+    extern "C" fn(*mut c_void, *mut hyper_context<'_>, *mut *mut hyper_headers) -> c_int;
+
+type hyper_buf_release_callback = extern "C" fn(*mut c_void, *const u8, size_t);
+
 ffi_fn! {
     /// Create a new "empty" body.
     ///
     /// If not configured, this body acts as an empty payload.
     fn hyper_body_new() -> *mut hyper_body {
-        Box::into_raw(Box::new(hyper_body(Body::empty())))
+        Box::into_raw(recycle::boxed(hyper_body::new(Body::empty())))
     } ?= ptr::null_mut()
 }
 
@@ -44,7 +88,7 @@ ffi_fn! {
             return;
         }
 
-        drop(unsafe { Box::from_raw(body) });
+        recycle::free(unsafe { Box::from_raw(body) });
     }
 }
 
@@ -64,7 +108,92 @@ ffi_fn! {
         let mut body = ManuallyDrop::new(unsafe { Box::from_raw(body) });
 
         Box::into_raw(hyper_task::boxed(async move {
-            body.0.data().await.map(|res| res.map(hyper_buf))
+            if !body.remaining.is_empty() {
+                return Some(Ok(hyper_buf(std::mem::take(&mut body.remaining))));
+            }
+            body.body.data().await.map(|res| res.map(hyper_buf))
+        }))
+    } ?= ptr::null_mut()
+}
+
+ffi_fn! {
+    /// Return a task that will poll the body for its trailers.
+    ///
+    /// This should be called once the body has finished streaming data, such
+    /// as after `hyper_body_data` or `hyper_body_read_into` reported the end
+    /// of the body. A checksum computed over the data can then be checked
+    /// against a trailer, without buffering the body.
+    ///
+    /// The task value may have different types depending on the outcome:
+    ///
+    /// - `HYPER_TASK_HEADERS`: Success, and the body had trailers. The
+    ///   `hyper_headers *` is owned by the caller, and must be freed with
+    ///   `hyper_headers_free`. On HTTP/2, its values are not copied out of
+    ///   the frame they were received in.
+    /// - `HYPER_TASK_ERROR`: An error retrieving the trailers.
+    /// - `HYPER_TASK_EMPTY`: The body had no trailers.
+    ///
+    /// On HTTP/1, only a body sent with chunked framing can have trailers.
+    /// Up to 100 trailer fields, taking up to 16 KiB, are accepted. More than
+    /// that fails the body with an error, as invalid trailers do.
+    ///
+    /// This does not consume the `hyper_body *`. However, it MUST NOT be used
+    /// or freed until the related task completes.
+    fn hyper_body_trailers(body: *mut hyper_body) -> *mut hyper_task {
+        if body.is_null() {
+            return ptr::null_mut();
+        }
+
+        // This doesn't take ownership of the Body, so don't allow destructor
+        let mut body = ManuallyDrop::new(unsafe { Box::from_raw(body) });
+
+        Box::into_raw(hyper_task::boxed(async move {
+            body.body
+                .trailers()
+                .await
+                .map(|trailers| trailers.map(hyper_headers::from_map))
+        }))
+    } ?= ptr::null_mut()
+}
+
+ffi_fn! {
+    /// Return a task that will copy body data directly into a caller-provided
+    /// buffer.
+    ///
+    /// The task copies as many bytes as are currently available, up to
+    /// `buf_len`, into `buf`. It only waits for more data if nothing has been
+    /// copied yet. When the task completes, the number of bytes copied is
+    /// written to `out_len`.
+    ///
+    /// The task value may have different types depending on the outcome:
+    ///
+    /// - `HYPER_TASK_EMPTY`: Success. If `*out_len` is `0`, the body has
+    ///   finished streaming data.
+    /// - `HYPER_TASK_ERROR`: An error retrieving the data.
+    ///
+    /// Data from a chunk that doesn't fit in `buf` is kept by the body, and
+    /// returned by the next read. If the body is instead set on a request or
+    /// response, that data is sent first.
+    ///
+    /// This does not consume the `hyper_body *`, so it may be used to again.
+    /// However, it MUST NOT be used or freed until the related task completes.
+    /// The `buf` and `out_len` pointers must also stay valid until then.
+    fn hyper_body_read_into(body: *mut hyper_body, buf: *mut u8, buf_len: size_t, out_len: *mut size_t) -> *mut hyper_task {
+        if body.is_null() || buf.is_null() || buf_len == 0 || out_len.is_null() {
+            return ptr::null_mut();
+        }
+
+        // This doesn't take ownership of the Body, so don't allow destructor
+        let mut body = ManuallyDrop::new(unsafe { Box::from_raw(body) });
+        let buf = UserDataPointer(buf as *mut c_void);
+        let out_len = UserDataPointer(out_len as *mut c_void);
+
+        Box::into_raw(hyper_task::boxed(async move {
+            let dst = unsafe { std::slice::from_raw_parts_mut(buf.0 as *mut u8, buf_len) };
+            let mut filled = 0;
+            let res = futures_util::future::poll_fn(|cx| body.poll_read_into(cx, &mut *dst, &mut filled)).await;
+            unsafe { *(out_len.0 as *mut size_t) = filled };
+            res
         }))
     } ?= ptr::null_mut()
 }
@@ -89,7 +218,13 @@ ffi_fn! {
         let userdata = UserDataPointer(userdata);
 
         Box::into_raw(hyper_task::boxed(async move {
-            while let Some(item) = body.0.data().await {
+            if !body.remaining.is_empty() {
+                let chunk = std::mem::take(&mut body.remaining);
+                if HYPER_ITER_CONTINUE != func(userdata.0, &hyper_buf(chunk)) {
+                    return Err(crate::Error::new_user_aborted_by_callback());
+                }
+            }
+            while let Some(item) = body.body.data().await {
                 let chunk = item?;
                 if HYPER_ITER_CONTINUE != func(userdata.0, &hyper_buf(chunk)) {
                     return Err(crate::Error::new_user_aborted_by_callback());
@@ -104,7 +239,7 @@ ffi_fn! {
     /// Set userdata on this body, which will be passed to callback functions.
     fn hyper_body_set_userdata(body: *mut hyper_body, userdata: *mut c_void) {
         let b = unsafe { &mut *body };
-        b.0.as_ffi_mut().userdata = userdata;
+        b.body.as_ffi_mut().userdata = userdata;
     }
 }
 
@@ -130,7 +265,128 @@ ffi_fn! {
     /// the body.
     fn hyper_body_set_data_func(body: *mut hyper_body, func: hyper_body_data_callback) {
         let b = unsafe { &mut *body };
-        b.0.as_ffi_mut().data_func = func;
+        b.body.as_ffi_mut().data_func = func;
+    }
+}
+
+ffi_fn! {
+    /// Set the trailers callback for this body.
+    ///
+    /// The callback is called once the data callback has reported the end of
+    /// the body, to get the trailers to send after it. It is passed the value
+    /// from `hyper_body_set_userdata`, so it can use state built up while
+    /// sending the data, such as a checksum.
+    ///
+    /// To send trailers, the `hyper_headers **` argument should be set to a
+    /// `hyper_headers *` from `hyper_headers_new`, which hyper takes ownership
+    /// of, and `HYPER_POLL_READY` should be returned. Leaving it `NULL` sends
+    /// no trailers. Like the data callback, this can also return
+    /// `HYPER_POLL_PENDING` after saving a waker, or `HYPER_POLL_ERROR` to
+    /// abort the body.
+    ///
+    /// Trailers are only sent on HTTP/2 connections. HTTP/1 connections do
+    /// not call the callback.
+    fn hyper_body_set_trailers_func(body: *mut hyper_body, func: hyper_body_trailers_callback) {
+        let b = unsafe { &mut *body };
+        b.body.as_ffi_mut().trailers_func = Some(func);
+    }
+}
+
+ffi_fn! {
+    /// Set this body to send `len` bytes of a file, starting at `offset`.
+    ///
+    /// hyper reads the file itself, in chunks, into the buffers it writes to
+    /// the IO transport. This saves copying the data through a C buffer and
+    /// `hyper_buf_copy`. Since the length is known, a request with this body
+    /// gets a `Content-Length` instead of being chunked.
+    ///
+    /// The `fd` must be a regular file, and stay open until the body is done,
+    /// as hyper doesn't close it. It is read with `pread`, so its file offset
+    /// is not changed. If the file ends early, the body fails.
+    ///
+    /// The file is used instead of any data callback set on this body.
+    fn hyper_body_set_fd(body: *mut hyper_body, fd: c_int, offset: u64, len: u64) -> hyper_code {
+        if body.is_null() || fd < 0 {
+            return hyper_code::HYPERE_INVALID_ARG;
+        }
+        match offset.checked_add(len) {
+            Some(end) if end <= i64::MAX as u64 => (),
+            _ => return hyper_code::HYPERE_INVALID_ARG,
+        }
+
+        #[cfg(unix)]
+        {
+            let b = unsafe { &mut *body };
+            b.body.as_ffi_mut().file = Some(FileRegion {
+                fd,
+                offset,
+                remaining: len,
+            });
+            hyper_code::HYPERE_OK
+        }
+
+        #[cfg(not(unix))]
+        {
+            hyper_code::HYPERE_FEATURE_NOT_ENABLED
+        }
+    }
+}
+
+// ===== impl hyper_body =====
+
+impl hyper_body {
+    pub(super) fn new(body: Body) -> hyper_body {
+        hyper_body {
+            body,
+            remaining: Bytes::new(),
+        }
+    }
+
+    /// Split into the body, and any data already taken from it that hasn't
+    /// been read yet.
+    pub(super) fn into_parts(self) -> (Body, Bytes) {
+        (self.body, self.remaining)
+    }
+
+    /// Turn into a `Body` that still starts with any data that was taken
+    /// from it but not read yet.
+    pub(super) fn into_body(self) -> Body {
+        if self.remaining.is_empty() {
+            return self.body;
+        }
+        let mut body = Body::empty();
+        body.as_ffi_mut().set_prefix(self.remaining, self.body);
+        body
+    }
+
+    fn poll_read_into(
+        &mut self,
+        cx: &mut Context<'_>,
+        dst: &mut [u8],
+        filled: &mut usize,
+    ) -> Poll<crate::Result<()>> {
+        loop {
+            if !self.remaining.is_empty() {
+                let n = std::cmp::min(self.remaining.len(), dst.len() - *filled);
+                dst[*filled..*filled + n].copy_from_slice(&self.remaining[..n]);
+                self.remaining.advance(n);
+                *filled += n;
+            }
+
+            if *filled == dst.len() {
+                return Poll::Ready(Ok(()));
+            }
+
+            match Pin::new(&mut self.body).poll_data(cx) {
+                Poll::Ready(Some(Ok(chunk))) => self.remaining = chunk,
+                Poll::Ready(Some(Err(err))) => return Poll::Ready(Err(err)),
+                Poll::Ready(None) => return Poll::Ready(Ok(())),
+                // Hand back what was copied so far instead of waiting to
+                // fill the whole buffer.
+                Poll::Pending if *filled > 0 => return Poll::Ready(Ok(())),
+                Poll::Pending => return Poll::Pending,
+            }
+        }
     }
 }
 
@@ -140,18 +396,54 @@ impl UserBody {
     pub(crate) fn new() -> UserBody {
         UserBody {
             data_func: data_noop,
+            trailers_func: None,
             userdata: std::ptr::null_mut(),
+            file: None,
+            codec: None,
+            gated: None,
+            prefixed: None,
         }
     }
 
+    pub(super) fn set_codec(&mut self, stage: CodecStage) {
+        self.codec = Some(Box::new(stage));
+    }
+
+    pub(super) fn set_continue_gate(&mut self, gate: Arc<ContinueGate>, inner: Body) {
+        self.gated = Some(Box::new(GatedBody { gate, inner }));
+    }
+
+    fn set_prefix(&mut self, prefix: Bytes, inner: Body) {
+        self.prefixed = Some(Box::new(PrefixedBody { prefix, inner }));
+    }
+
     pub(crate) fn poll_data(&mut self, cx: &mut Context<'_>) -> Poll<Option<crate::Result<Bytes>>> {
+        if let Some(ref mut file) = self.file {
+            return Poll::Ready(file.read_chunk().transpose());
+        }
+        if let Some(ref mut codec) = self.codec {
+            return codec.poll_data(cx);
+        }
+        if let Some(ref mut gated) = self.gated {
+            if let Err(err) = ready!(gated.gate.poll_open(cx)) {
+                return Poll::Ready(Some(Err(err)));
+            }
+            return Pin::new(&mut gated.inner).poll_data(cx);
+        }
+        if let Some(ref mut prefixed) = self.prefixed {
+            if !prefixed.prefix.is_empty() {
+                return Poll::Ready(Some(Ok(std::mem::take(&mut prefixed.prefix))));
+            }
+            return Pin::new(&mut prefixed.inner).poll_data(cx);
+        }
+
         let mut out = std::ptr::null_mut();
         match (self.data_func)(self.userdata, hyper_context::wrap(cx), &mut out) {
             super::task::HYPER_POLL_READY => {
                 if out.is_null() {
                     Poll::Ready(None)
                 } else {
-                    let buf = unsafe { Box::from_raw(out) };
+                    let buf = recycle::unbox(unsafe { Box::from_raw(out) });
                     Poll::Ready(Some(Ok(buf.0)))
                 }
             }
@@ -168,9 +460,106 @@ impl UserBody {
 
     pub(crate) fn poll_trailers(
         &mut self,
-        _cx: &mut Context<'_>,
+        cx: &mut Context<'_>,
     ) -> Poll<crate::Result<Option<HeaderMap>>> {
-        Poll::Ready(Ok(None))
+        if let Some(ref mut codec) = self.codec {
+            return codec.poll_trailers(cx);
+        }
+        if let Some(ref mut gated) = self.gated {
+            return Pin::new(&mut gated.inner).poll_trailers(cx);
+        }
+        if let Some(ref mut prefixed) = self.prefixed {
+            return Pin::new(&mut prefixed.inner).poll_trailers(cx);
+        }
+        let trailers_func = match self.trailers_func {
+            Some(func) if self.file.is_none() => func,
+            _ => return Poll::Ready(Ok(None)),
+        };
+
+        let mut out = std::ptr::null_mut();
+        match trailers_func(self.userdata, hyper_context::wrap(cx), &mut out) {
+            super::task::HYPER_POLL_READY => {
+                if out.is_null() {
+                    Poll::Ready(Ok(None))
+                } else {
+                    let headers = unsafe { Box::from_raw(out) };
+                    Poll::Ready(Ok(Some(headers.headers)))
+                }
+            }
+            super::task::HYPER_POLL_PENDING => Poll::Pending,
+            super::task::HYPER_POLL_ERROR => {
+                Poll::Ready(Err(crate::Error::new_body_write_aborted()))
+            }
+            unexpected => Poll::Ready(Err(crate::Error::new_body_write(format!(
+                "unexpected hyper_body_trailers_func return code {}",
+                unexpected
+            )))),
+        }
+    }
+
+    pub(crate) fn size_hint(&self) -> SizeHint {
+        if let Some(ref gated) = self.gated {
+            return gated.inner.size_hint();
+        }
+        if let Some(ref prefixed) = self.prefixed {
+            let len = prefixed.prefix.len() as u64;
+            let inner = prefixed.inner.size_hint();
+            let mut hint = SizeHint::new();
+            hint.set_lower(inner.lower().saturating_add(len));
+            if let Some(upper) = inner.upper() {
+                hint.set_upper(upper.saturating_add(len));
+            }
+            return hint;
+        }
+        match self.file {
+            Some(ref file) => SizeHint::with_exact(file.remaining),
+            None => SizeHint::default(),
+        }
+    }
+}
+
+impl FileRegion {
+    #[cfg(unix)]
+    fn read_chunk(&mut self) -> crate::Result<Option<Bytes>> {
+        if self.remaining == 0 {
+            return Ok(None);
+        }
+
+        let len = std::cmp::min(self.remaining, FILE_CHUNK_SIZE as u64) as usize;
+        let mut buf = Vec::<u8>::with_capacity(len);
+        let n = loop {
+            let n = unsafe {
+                libc::pread(
+                    self.fd,
+                    buf.as_mut_ptr() as *mut c_void,
+                    len,
+                    self.offset as libc::off_t,
+                )
+            };
+            if n >= 0 {
+                break n as usize;
+            }
+
+            let err = std::io::Error::last_os_error();
+            if err.kind() != std::io::ErrorKind::Interrupted {
+                return Err(crate::Error::new_body_write(err));
+            }
+        };
+        if n == 0 {
+            return Err(crate::Error::new_body_write(
+                "file ended before the end of the body",
+            ));
+        }
+
+        unsafe { buf.set_len(n) };
+        self.offset += n as u64;
+        self.remaining -= n as u64;
+        Ok(Some(Bytes::from(buf)))
+    }
+
+    #[cfg(not(unix))]
+    fn read_chunk(&mut self) -> crate::Result<Option<Bytes>> {
+        unreachable!("hyper_body_set_fd is unix only")
     }
 }
 
@@ -197,7 +586,35 @@ ffi_fn! {
         let slice = unsafe {
             std::slice::from_raw_parts(buf, len)
         };
-        Box::into_raw(Box::new(hyper_buf(Bytes::copy_from_slice(slice))))
+        Box::into_raw(recycle::boxed(hyper_buf(Bytes::copy_from_slice(slice))))
+    } ?= ptr::null_mut()
+}
+
+ffi_fn! {
+    /// Create a new `hyper_buf *` that references the provided bytes without
+    /// copying them.
+    ///
+    /// The memory pointed to by `buf` must stay valid and unchanged until
+    /// hyper is done with it. When the last reference to the buffer is
+    /// dropped, hyper calls the `release` callback with the `userdata`, `buf`
+    /// and `len` arguments passed here, at which point the caller may free or
+    /// reuse the memory.
+    ///
+    /// The `release` callback may be called from inside any hyper function
+    /// that drives a task, such as `hyper_executor_poll`, or during
+    /// `hyper_buf_free`.
+    fn hyper_buf_borrowed(buf: *const u8, len: size_t, release: hyper_buf_release_callback, userdata: *mut c_void) -> *mut hyper_buf {
+        if buf.is_null() && len != 0 {
+            return ptr::null_mut();
+        }
+
+        let foreign = ForeignBuf {
+            ptr: buf,
+            len,
+            release,
+            userdata: UserDataPointer(userdata),
+        };
+        Box::into_raw(recycle::boxed(hyper_buf(Bytes::from_owner(foreign))))
     } ?= ptr::null_mut()
 }
 
@@ -224,12 +641,187 @@ ffi_fn! {
 ffi_fn! {
     /// Free this buffer.
     fn hyper_buf_free(buf: *mut hyper_buf) {
-        drop(unsafe { Box::from_raw(buf) });
+        recycle::free(unsafe { Box::from_raw(buf) });
     }
 }
 
+/// Memory owned by the C caller, released through its callback on drop.
+struct ForeignBuf {
+    ptr: *const u8,
+    len: size_t,
+    release: hyper_buf_release_callback,
+    userdata: UserDataPointer,
+}
+
+impl AsRef<[u8]> for ForeignBuf {
+    fn as_ref(&self) -> &[u8] {
+        if self.len == 0 {
+            return &[];
+        }
+        unsafe { std::slice::from_raw_parts(self.ptr, self.len) }
+    }
+}
+
+impl Drop for ForeignBuf {
+    fn drop(&mut self) {
+        (self.release)(self.userdata.0, self.ptr, self.len);
+    }
+}
+
+// The caller promised the memory stays valid until `release` is called, and
+// hyper never mutates it.
+unsafe impl Send for ForeignBuf {}
+
 unsafe impl AsTaskType for hyper_buf {
     fn as_task_type(&self) -> hyper_task_return_type {
         hyper_task_return_type::HYPER_TASK_BUF
     }
 }
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_buf_borrowed_release() {
+        let data = b"hello world";
+        let mut released = 0usize;
+
+        let buf = hyper_buf_borrowed(
+            data.as_ptr(),
+            data.len(),
+            release,
+            &mut released as *mut _ as *mut c_void,
+        );
+        assert_eq!(unsafe { &*buf }.0, &data[..]);
+        assert_eq!(unsafe { &*buf }.0.as_ptr(), data.as_ptr(), "not copied");
+
+        let clone = unsafe { &*buf }.0.clone();
+        hyper_buf_free(buf);
+        assert_eq!(released, 0, "clone still alive");
+
+        drop(clone);
+        assert_eq!(released, data.len());
+
+        extern "C" fn release(userdata: *mut c_void, _buf: *const u8, len: size_t) {
+            unsafe { *(userdata as *mut usize) += len };
+        }
+    }
+
+    #[test]
+    fn test_body_read_into_keeps_remaining() {
+        let mut body = hyper_body::new(Body::from("hello world"));
+        let mut cx = Context::from_waker(futures_util::task::noop_waker_ref());
+
+        let mut dst = [0u8; 4];
+        let mut out = Vec::new();
+        loop {
+            let mut filled = 0;
+            match body.poll_read_into(&mut cx, &mut dst, &mut filled) {
+                Poll::Ready(Ok(())) if filled == 0 => break,
+                Poll::Ready(Ok(())) => out.extend_from_slice(&dst[..filled]),
+                other => panic!("unexpected poll: {:?}", other.map(|_| filled)),
+            }
+        }
+
+        assert_eq!(out, b"hello world");
+    }
+
+    #[test]
+    fn test_body_into_body_keeps_remaining() {
+        let mut body = hyper_body::new(Body::from("hello world"));
+        let mut cx = Context::from_waker(futures_util::task::noop_waker_ref());
+
+        let mut dst = [0u8; 4];
+        let mut filled = 0;
+        match body.poll_read_into(&mut cx, &mut dst, &mut filled) {
+            Poll::Ready(Ok(())) => assert_eq!(&dst[..filled], b"hell"),
+            other => panic!("unexpected poll: {:?}", other.map(|_| filled)),
+        }
+
+        // As when the rest is sent on with `hyper_request_set_body`.
+        let mut body = body.into_body();
+        assert_eq!(body.size_hint().exact(), Some(7));
+        let mut out = Vec::new();
+        while let Poll::Ready(Some(chunk)) = Pin::new(&mut body).poll_data(&mut cx) {
+            out.extend_from_slice(&chunk.unwrap());
+        }
+        assert_eq!(out, b"o world");
+    }
+
+    #[cfg(unix)]
+    #[test]
+    fn test_body_set_fd_reads_region() {
+        use std::io::Write;
+        use std::os::unix::io::AsRawFd;
+
+        let path = std::env::temp_dir().join(format!("hyper-ffi-body-{}", std::process::id()));
+        let mut file = std::fs::File::create(&path).unwrap();
+        file.write_all(b"xxhello worldxx").unwrap();
+        let file = std::fs::File::open(&path).unwrap();
+        std::fs::remove_file(&path).unwrap();
+
+        let body = hyper_body_new();
+        assert!(matches!(
+            hyper_body_set_fd(body, file.as_raw_fd(), 2, 11),
+            hyper_code::HYPERE_OK
+        ));
+        let mut body = unsafe { Box::from_raw(body) };
+        assert_eq!(body.body.size_hint().exact(), Some(11));
+
+        let mut cx = Context::from_waker(futures_util::task::noop_waker_ref());
+        let mut out = Vec::new();
+        while let Poll::Ready(Some(chunk)) = Pin::new(&mut body.body).poll_data(&mut cx) {
+            out.extend_from_slice(&chunk.unwrap());
+        }
+        assert_eq!(out, b"hello world");
+
+        // The file ending before the body does is an error.
+        let body = hyper_body_new();
+        hyper_body_set_fd(body, file.as_raw_fd(), 10, 10);
+        let mut body = unsafe { Box::from_raw(body) };
+        let mut cx = Context::from_waker(futures_util::task::noop_waker_ref());
+        let first = Pin::new(&mut body.body).poll_data(&mut cx);
+        assert!(matches!(first, Poll::Ready(Some(Ok(_)))));
+        let second = Pin::new(&mut body.body).poll_data(&mut cx);
+        assert!(matches!(second, Poll::Ready(Some(Err(_)))));
+    }
+
+    #[test]
+    fn test_body_trailers_func() {
+        use crate::ffi::{hyper_headers_new, hyper_headers_set, HYPER_POLL_READY};
+
+        extern "C" fn no_data(
+            _: *mut c_void,
+            _: *mut hyper_context<'_>,
+            chunk: *mut *mut hyper_buf,
+        ) -> c_int {
+            unsafe { *chunk = ptr::null_mut() };
+            HYPER_POLL_READY
+        }
+
+        extern "C" fn checksum(
+            _: *mut c_void,
+            _: *mut hyper_context<'_>,
+            trailers: *mut *mut hyper_headers,
+        ) -> c_int {
+            let headers = hyper_headers_new();
+            hyper_headers_set(headers, b"x-checksum".as_ptr(), 10, b"abc".as_ptr(), 3);
+            unsafe { *trailers = headers };
+            HYPER_POLL_READY
+        }
+
+        let body = hyper_body_new();
+        hyper_body_set_data_func(body, no_data);
+        hyper_body_set_trailers_func(body, checksum);
+        let mut body = unsafe { Box::from_raw(body) };
+
+        let mut cx = Context::from_waker(futures_util::task::noop_waker_ref());
+        let data = Pin::new(&mut body.body).poll_data(&mut cx);
+        assert!(matches!(data, Poll::Ready(None)));
+        match Pin::new(&mut body.body).poll_trailers(&mut cx) {
+            Poll::Ready(Ok(Some(trailers))) => assert_eq!(trailers["x-checksum"], "abc"),
+            other => panic!("unexpected poll: {:?}", other),
+        }
+    }
+}
@@ -1,13 +1,21 @@
+use std::sync::atomic::{AtomicU64, Ordering};
 use std::sync::Arc;
+use std::time::{Duration, Instant};
 
-use libc::c_int;
+use futures_util::future::FutureExt as _;
+use libc::{c_int, size_t};
 
 use crate::client::conn;
+use crate::client::pool::{self, Pool, Poolable, Pooled, Reservation};
+use crate::common::exec::Exec;
 use crate::rt::Executor as _;
+use crate::Uri;
 
 use super::error::hyper_code;
-use super::http_types::{hyper_request, hyper_response};
-use super::io::hyper_io;
+use super::http_types::{hyper_request, hyper_response, HeadLatency};
+use super::io::{hyper_io, IoCounters};
+use super::memory::{hyper_memory, hyper_memory_usage, ConnMemory, HeadersCharge, MemoryBudget};
+use super::recycle;
 use super::task::{hyper_executor, hyper_task, hyper_task_return_type, AsTaskType, WeakExec};
 
 /// An options builder to configure an HTTP client connection.
@@ -15,6 +23,14 @@ pub struct hyper_clientconn_options {
     builder: conn::Builder,
     /// Use a `Weak` to prevent cycles.
     exec: WeakExec,
+    /// The pool the connection is returned to once freed, if any.
+    pool: Option<PoolTarget>,
+    /// Whether HTTP/1 requests may be pipelined.
+    pipelined: bool,
+    /// Whether connections keep `ConnStats`.
+    stats: bool,
+    /// The budget connections account their memory to, if any.
+    memory: Option<Arc<MemoryBudget>>,
 }
 
 /// An HTTP client connection handle.
@@ -23,7 +39,78 @@ pub struct hyper_clientconn_options {
 /// send multiple requests on a single connection, such as when HTTP/1
 /// keep-alive or HTTP/2 is used.
 pub struct hyper_clientconn {
+    tx: Tx,
+    /// Requests are queued instead of refused while the connection is busy.
+    pipelined: bool,
+    stats: Option<Arc<ConnStats>>,
+    memory: Option<Arc<ConnMemory>>,
+}
+
+/// A snapshot of the stats of a client connection.
+///
+/// The IO counters are of the calls hyper made to the read and write
+/// callbacks of the connection's `hyper_io`. For a completion-based IO,
+/// they are of the submitted reads and writes instead, which are pending if
+/// they had not completed once the submit callback returned.
+#[repr(C)]
+#[derive(Clone, Copy, Default)]
+pub struct hyper_clientconn_stats {
+    /// Nanoseconds from `hyper_clientconn_handshake` until the handshake
+    /// completed.
+    pub handshake_ns: u64,
+    /// The number of requests sent with `hyper_clientconn_send`.
+    pub requests: u64,
+    /// The number of responses received.
+    pub responses: u64,
+    /// The number of calls to the read callback.
+    pub read_calls: u64,
+    /// How many of those calls returned `HYPER_IO_PENDING`.
+    pub read_pending: u64,
+    /// The number of bytes read.
+    pub read_bytes: u64,
+    /// The number of calls to the write callbacks.
+    pub write_calls: u64,
+    /// How many of those calls returned `HYPER_IO_PENDING`.
+    pub write_pending: u64,
+    /// The number of bytes written.
+    pub write_bytes: u64,
+}
+
+/// The live counters behind a `hyper_clientconn_stats`.
+#[derive(Default)]
+pub(super) struct ConnStats {
+    handshake_ns: AtomicU64,
+    requests: AtomicU64,
+    responses: AtomicU64,
+    pub(super) read: IoCounters,
+    pub(super) write: IoCounters,
+}
+
+enum Tx {
+    /// The executor runs the timers of the requests sent on it.
+    Owned(conn::SendRequest<crate::Body>, WeakExec),
+    /// Handed back to the pool once freed and ready for another request.
+    Pooled(Pooled<PoolConn>, WeakExec),
+}
+
+/// A pool of idle HTTP client connections, keyed by scheme and authority.
+pub struct hyper_clientconn_pool {
+    pool: Pool<PoolConn>,
+    /// Use a `Weak` to prevent cycles.
+    exec: WeakExec,
+}
+
+struct PoolConn {
     tx: conn::SendRequest<crate::Body>,
+    pipelined: bool,
+    stats: Option<Arc<ConnStats>>,
+    memory: Option<Arc<ConnMemory>>,
+}
+
+struct PoolTarget {
+    pool: Pool<PoolConn>,
+    key: pool::Key,
+    exec: WeakExec,
 }
 
 // ===== impl hyper_clientconn =====
@@ -44,8 +131,20 @@ ffi_fn! {
             return std::ptr::null_mut();
         }
 
-        let options = unsafe { Box::from_raw(options) };
-        let io = unsafe { Box::from_raw(io) };
+        let mut options = unsafe { Box::from_raw(options) };
+        let mut io = unsafe { Box::from_raw(io) };
+        let stats = if options.stats {
+            let stats = Arc::new(ConnStats::default());
+            io.set_stats(stats.clone());
+            Some(stats)
+        } else {
+            None
+        };
+        let memory = options.memory.take().map(ConnMemory::new);
+        if let Some(ref memory) = memory {
+            options.builder.http1_memory(memory.clone());
+        }
+        let start = Instant::now();
 
         Box::into_raw(hyper_task::boxed(async move {
             options.builder.handshake::<_, crate::Body>(io)
@@ -54,7 +153,15 @@ ffi_fn! {
                     options.exec.execute(Box::pin(async move {
                         let _ = conn.await;
                     }));
-                    hyper_clientconn { tx }
+                    if let Some(ref stats) = stats {
+                        stats.handshake_ns.store(nanos(start.elapsed()), Ordering::Relaxed);
+                    }
+                    let pipelined = options.pipelined;
+                    let tx = match options.pool {
+                        Some(target) => target.pooled(tx, pipelined, stats.clone(), memory.clone()),
+                        None => Tx::Owned(tx, options.exec.clone()),
+                    };
+                    hyper_clientconn { tx, pipelined, stats, memory }
                 })
         }))
     } ?= std::ptr::null_mut()
@@ -65,6 +172,11 @@ ffi_fn! {
     ///
     /// Returns a task that needs to be polled until it is ready. When ready, the
     /// task yields a `hyper_response *`.
+    ///
+    /// If pipelining was enabled with `hyper_clientconn_options_http1_pipeline`,
+    /// more requests can be sent before earlier responses are ready. They are
+    /// written in order as the pipeline has room, and their responses are
+    /// received in that same order.
     fn hyper_clientconn_send(conn: *mut hyper_clientconn, req: *mut hyper_request) -> *mut hyper_task {
         if conn.is_null() {
             return std::ptr::null_mut();
@@ -73,25 +185,128 @@ ffi_fn! {
             return std::ptr::null_mut();
         }
 
-        let mut req = unsafe { Box::from_raw(req) };
+        let mut req = recycle::unbox(unsafe { Box::from_raw(req) });
 
         // Update request with original-case map of headers
         req.finalize_request();
 
-        let fut = unsafe { &mut *conn }.tx.send_request(req.0);
+        let conn = unsafe { &mut *conn };
+        req.start_continue_timer(conn.exec());
+        let timing = conn.stats.clone().map(|stats| {
+            stats.requests.fetch_add(1, Ordering::Relaxed);
+            (stats, Instant::now())
+        });
+        let memory = conn.memory.clone();
+        let pipelined = conn.pipelined;
+        let tx = conn.tx_mut();
+        let fut = if pipelined {
+            tx.send_request_queued(req.0)
+        } else {
+            tx.send_request(req.0)
+        };
 
         let fut = async move {
-            fut.await.map(hyper_response::wrap)
+            fut.await.map(|mut res| {
+                if let Some((stats, sent)) = timing {
+                    stats.responses.fetch_add(1, Ordering::Relaxed);
+                    res.extensions_mut().insert(HeadLatency(sent.elapsed()));
+                }
+                if let Some(memory) = memory {
+                    let charge = HeadersCharge::new(memory, res.headers());
+                    res.extensions_mut().insert(charge);
+                }
+                hyper_response::wrap(res)
+            })
         };
 
         Box::into_raw(hyper_task::boxed(fut))
     } ?= std::ptr::null_mut()
 }
 
+ffi_fn! {
+    /// Copy the stats of a client connection into `stats`.
+    ///
+    /// The counters keep going up as the connection is used, so this can be
+    /// called again for a newer snapshot. Returns `HYPERE_INVALID_ARG` if the
+    /// connection was not made with `hyper_clientconn_options_stats` enabled.
+    fn hyper_clientconn_get_stats(conn: *const hyper_clientconn, stats: *mut hyper_clientconn_stats) -> hyper_code {
+        if conn.is_null() || stats.is_null() {
+            return hyper_code::HYPERE_INVALID_ARG;
+        }
+        let conn = unsafe { &*conn };
+        match conn.stats {
+            Some(ref live) => {
+                unsafe { *stats = live.snapshot() };
+                hyper_code::HYPERE_OK
+            }
+            None => hyper_code::HYPERE_INVALID_ARG,
+        }
+    }
+}
+
+ffi_fn! {
+    /// Copy the memory held by a client connection into `usage`.
+    ///
+    /// This includes the headers of its responses that have not been freed
+    /// yet. The `limited` count is only kept for the whole budget, so it is
+    /// always `0` here. Returns `HYPERE_INVALID_ARG` if the connection was not
+    /// made with `hyper_clientconn_options_memory`.
+    fn hyper_clientconn_get_memory_usage(conn: *const hyper_clientconn, usage: *mut hyper_memory_usage) -> hyper_code {
+        if conn.is_null() || usage.is_null() {
+            return hyper_code::HYPERE_INVALID_ARG;
+        }
+        let conn = unsafe { &*conn };
+        match conn.memory {
+            Some(ref live) => {
+                unsafe { *usage = live.snapshot() };
+                hyper_code::HYPERE_OK
+            }
+            None => hyper_code::HYPERE_INVALID_ARG,
+        }
+    }
+}
+
 ffi_fn! {
     /// Free a `hyper_clientconn *`.
+    ///
+    /// If the connection was made with `hyper_clientconn_options_pool`, it is
+    /// returned to that pool once it is ready for another request.
     fn hyper_clientconn_free(conn: *mut hyper_clientconn) {
-        drop(unsafe { Box::from_raw(conn) });
+        unsafe { Box::from_raw(conn) }.release();
+    }
+}
+
+impl hyper_clientconn {
+    fn tx_mut(&mut self) -> &mut conn::SendRequest<crate::Body> {
+        match self.tx {
+            Tx::Owned(ref mut tx, _) => tx,
+            Tx::Pooled(ref mut pooled, _) => &mut pooled.tx,
+        }
+    }
+
+    fn exec(&self) -> &WeakExec {
+        match self.tx {
+            Tx::Owned(_, ref exec) => exec,
+            Tx::Pooled(_, ref exec) => exec,
+        }
+    }
+
+    fn release(self) {
+        if let Tx::Pooled(mut pooled, exec) = self.tx {
+            if pooled.tx.is_ready() {
+                drop(pooled);
+                return;
+            }
+
+            // An HTTP/1 connection can only be reused once the previous
+            // response has finished, so wait for that before dropping it
+            // back into the pool. If the connection closes instead, the
+            // `Pooled` notices and discards it.
+            exec.execute(Box::pin(async move {
+                let _ = futures_util::future::poll_fn(|cx| pooled.tx.poll_ready(cx)).await;
+                drop(pooled);
+            }));
+        }
     }
 }
 
@@ -101,8 +316,37 @@ unsafe impl AsTaskType for hyper_clientconn {
     }
 }
 
+impl ConnStats {
+    fn snapshot(&self) -> hyper_clientconn_stats {
+        hyper_clientconn_stats {
+            handshake_ns: self.handshake_ns.load(Ordering::Relaxed),
+            requests: self.requests.load(Ordering::Relaxed),
+            responses: self.responses.load(Ordering::Relaxed),
+            read_calls: self.read.calls.load(Ordering::Relaxed),
+            read_pending: self.read.pending.load(Ordering::Relaxed),
+            read_bytes: self.read.bytes.load(Ordering::Relaxed),
+            write_calls: self.write.calls.load(Ordering::Relaxed),
+            write_pending: self.write.pending.load(Ordering::Relaxed),
+            write_bytes: self.write.bytes.load(Ordering::Relaxed),
+        }
+    }
+}
+
+fn nanos(d: Duration) -> u64 {
+    d.as_nanos() as u64
+}
+
 // ===== impl hyper_clientconn_options =====
 
+/// Largest HTTP2 flow control window allowed by the spec.
+#[cfg(feature = "http2")]
+const MAX_HTTP2_WINDOW_SIZE: u32 = (1 << 31) - 1;
+/// Smallest and largest HTTP2 `SETTINGS_MAX_FRAME_SIZE` allowed by the spec.
+#[cfg(feature = "http2")]
+const MIN_HTTP2_FRAME_SIZE: u32 = 1 << 14;
+#[cfg(feature = "http2")]
+const MAX_HTTP2_FRAME_SIZE: u32 = (1 << 24) - 1;
+
 ffi_fn! {
     /// Creates a new set of HTTP clientconn options to be used in a handshake.
     fn hyper_clientconn_options_new() -> *mut hyper_clientconn_options {
@@ -112,6 +356,10 @@ ffi_fn! {
         Box::into_raw(Box::new(hyper_clientconn_options {
             builder,
             exec: WeakExec::new(),
+            pool: None,
+            pipelined: false,
+            stats: false,
+            memory: None,
         }))
     } ?= std::ptr::null_mut()
 }
@@ -160,16 +408,664 @@ ffi_fn! {
     }
 }
 
+ffi_fn! {
+    /// Set the initial HTTP2 stream-level flow control window, in bytes.
+    ///
+    /// This disables the adaptive window set with
+    /// `hyper_clientconn_options_http2_adaptive_window`.
+    ///
+    /// The `size` may be at most `2^31 - 1`.
+    fn hyper_clientconn_options_http2_initial_stream_window_size(opts: *mut hyper_clientconn_options, size: u32) -> hyper_code {
+        #[cfg(feature = "http2")]
+        {
+            if opts.is_null() || size > MAX_HTTP2_WINDOW_SIZE {
+                return hyper_code::HYPERE_INVALID_ARG;
+            }
+            let opts = unsafe { &mut *opts };
+            opts.builder.http2_initial_stream_window_size(size);
+            hyper_code::HYPERE_OK
+        }
+
+        #[cfg(not(feature = "http2"))]
+        {
+            drop(opts);
+            drop(size);
+            hyper_code::HYPERE_FEATURE_NOT_ENABLED
+        }
+    }
+}
+
+ffi_fn! {
+    /// Set the initial HTTP2 connection-level flow control window, in bytes.
+    ///
+    /// This disables the adaptive window set with
+    /// `hyper_clientconn_options_http2_adaptive_window`.
+    ///
+    /// The `size` may be at most `2^31 - 1`.
+    fn hyper_clientconn_options_http2_initial_connection_window_size(opts: *mut hyper_clientconn_options, size: u32) -> hyper_code {
+        #[cfg(feature = "http2")]
+        {
+            if opts.is_null() || size > MAX_HTTP2_WINDOW_SIZE {
+                return hyper_code::HYPERE_INVALID_ARG;
+            }
+            let opts = unsafe { &mut *opts };
+            opts.builder.http2_initial_connection_window_size(size);
+            hyper_code::HYPERE_OK
+        }
+
+        #[cfg(not(feature = "http2"))]
+        {
+            drop(opts);
+            drop(size);
+            hyper_code::HYPERE_FEATURE_NOT_ENABLED
+        }
+    }
+}
+
+ffi_fn! {
+    /// Set whether to use an adaptive HTTP2 flow control window, which grows
+    /// with the measured bandwidth-delay product of the connection.
+    ///
+    /// Pass `0` to disable, `1` to enable.
+    ///
+    /// Enabling this overrides the initial window sizes set before.
+    fn hyper_clientconn_options_http2_adaptive_window(opts: *mut hyper_clientconn_options, enabled: c_int) -> hyper_code {
+        #[cfg(feature = "http2")]
+        {
+            if opts.is_null() {
+                return hyper_code::HYPERE_INVALID_ARG;
+            }
+            let opts = unsafe { &mut *opts };
+            opts.builder.http2_adaptive_window(enabled != 0);
+            hyper_code::HYPERE_OK
+        }
+
+        #[cfg(not(feature = "http2"))]
+        {
+            drop(opts);
+            drop(enabled);
+            hyper_code::HYPERE_FEATURE_NOT_ENABLED
+        }
+    }
+}
+
+ffi_fn! {
+    /// Set the maximum HTTP2 frame size to accept, in bytes.
+    ///
+    /// The `size` must be between `16384` and `16777215`.
+    fn hyper_clientconn_options_http2_max_frame_size(opts: *mut hyper_clientconn_options, size: u32) -> hyper_code {
+        #[cfg(feature = "http2")]
+        {
+            if opts.is_null() || size < MIN_HTTP2_FRAME_SIZE || size > MAX_HTTP2_FRAME_SIZE {
+                return hyper_code::HYPERE_INVALID_ARG;
+            }
+            let opts = unsafe { &mut *opts };
+            opts.builder.http2_max_frame_size(size);
+            hyper_code::HYPERE_OK
+        }
+
+        #[cfg(not(feature = "http2"))]
+        {
+            drop(opts);
+            drop(size);
+            hyper_code::HYPERE_FEATURE_NOT_ENABLED
+        }
+    }
+}
+
+ffi_fn! {
+    /// Set the maximum number of locally reset HTTP2 streams that are
+    /// remembered at once.
+    fn hyper_clientconn_options_http2_max_concurrent_reset_streams(opts: *mut hyper_clientconn_options, max: size_t) -> hyper_code {
+        #[cfg(feature = "http2")]
+        {
+            if opts.is_null() {
+                return hyper_code::HYPERE_INVALID_ARG;
+            }
+            let opts = unsafe { &mut *opts };
+            opts.builder.http2_max_concurrent_reset_streams(max);
+            hyper_code::HYPERE_OK
+        }
+
+        #[cfg(not(feature = "http2"))]
+        {
+            drop(opts);
+            drop(max);
+            hyper_code::HYPERE_FEATURE_NOT_ENABLED
+        }
+    }
+}
+
 ffi_fn! {
     /// Set the whether to include a copy of the raw headers in responses
     /// received on this connection.
     ///
     /// Pass `0` to disable, `1` to enable.
     ///
-    /// If enabled, see `hyper_response_headers_raw()` for usage.
+    /// If enabled, see `hyper_response_headers_raw()` for usage. The headers
+    /// can then be read without allocating through
+    /// `hyper_response_headers_raw_spans()`.
     fn hyper_clientconn_options_headers_raw(opts: *mut hyper_clientconn_options, enabled: c_int) -> hyper_code {
         let opts = unsafe { &mut *opts };
         opts.builder.http1_headers_raw(enabled != 0);
         hyper_code::HYPERE_OK
     }
 }
+
+ffi_fn! {
+    /// Set how many HTTP/1 requests may be written on a connection before
+    /// their responses have been received.
+    ///
+    /// Responses are still delivered in the order the requests were sent.
+    /// Only idempotent requests, such as `GET`, are pipelined behind, and a
+    /// pipelined request may fail if the server closes the connection early.
+    ///
+    /// The default is `1`, which disables pipelining. Passing `0` is an error.
+    fn hyper_clientconn_options_http1_pipeline(opts: *mut hyper_clientconn_options, depth: size_t) -> hyper_code {
+        if opts.is_null() || depth == 0 {
+            return hyper_code::HYPERE_INVALID_ARG;
+        }
+        let opts = unsafe { &mut *opts };
+        opts.builder.http1_pipeline_depth(depth);
+        opts.pipelined = depth > 1;
+        hyper_code::HYPERE_OK
+    }
+}
+
+ffi_fn! {
+    /// Set HTTP/1 reads to always use a buffer of exactly `size` bytes.
+    ///
+    /// This disables the adaptive read buffer, and replaces any max set
+    /// with `hyper_clientconn_options_http1_max_buf_size`. Passing `0` is an
+    /// error.
+    fn hyper_clientconn_options_http1_read_buf_exact_size(opts: *mut hyper_clientconn_options, size: size_t) -> hyper_code {
+        if opts.is_null() || size == 0 {
+            return hyper_code::HYPERE_INVALID_ARG;
+        }
+        let opts = unsafe { &mut *opts };
+        opts.builder.h1_read_buf_exact_size(Some(size));
+        hyper_code::HYPERE_OK
+    }
+}
+
+ffi_fn! {
+    /// Set the max size of the HTTP/1 read and write buffers, in bytes.
+    ///
+    /// The read buffer grows as reads fill it, up to this size, and a
+    /// response head that does not fit in it is an error. Once this much is
+    /// waiting to be written, the request body is not polled for more.
+    ///
+    /// This re-enables the adaptive read buffer if an exact size was set. The
+    /// default is about 400kb, and passing less than 8192 is an error.
+    fn hyper_clientconn_options_http1_max_buf_size(opts: *mut hyper_clientconn_options, max: size_t) -> hyper_code {
+        if opts.is_null() || max < crate::proto::h1::MINIMUM_MAX_BUFFER_SIZE {
+            return hyper_code::HYPERE_INVALID_ARG;
+        }
+        let opts = unsafe { &mut *opts };
+        opts.builder.h1_max_buf_size(max);
+        hyper_code::HYPERE_OK
+    }
+}
+
+ffi_fn! {
+    /// Set the size of the first HTTP/1 read buffer, in bytes.
+    ///
+    /// The adaptive read buffer then grows or shrinks from this size, so a
+    /// connection expected to download large bodies can start with fewer
+    /// reads per megabyte. It never starts above the max buffer size, and
+    /// has no effect if an exact size was set.
+    ///
+    /// The default is 8192, and passing less than that is an error.
+    fn hyper_clientconn_options_http1_read_buf_init_size(opts: *mut hyper_clientconn_options, size: size_t) -> hyper_code {
+        if opts.is_null() || size < crate::proto::h1::MINIMUM_MAX_BUFFER_SIZE {
+            return hyper_code::HYPERE_INVALID_ARG;
+        }
+        let opts = unsafe { &mut *opts };
+        opts.builder.http1_read_buf_init_size(size);
+        hyper_code::HYPERE_OK
+    }
+}
+
+ffi_fn! {
+    /// Set whether HTTP/1 body buffers are kept separate and written with
+    /// vectored writes, instead of being copied into one flat buffer.
+    ///
+    /// Pass `1` to queue buffers, which saves a copy of each body chunk but
+    /// calls the write callback once per buffer unless the IO has a vectored
+    /// write function. Pass `0` to always flatten them. By default, buffers
+    /// are queued if `hyper_io_set_write_vectored` was used.
+    fn hyper_clientconn_options_http1_writev(opts: *mut hyper_clientconn_options, enabled: c_int) -> hyper_code {
+        if opts.is_null() {
+            return hyper_code::HYPERE_INVALID_ARG;
+        }
+        let opts = unsafe { &mut *opts };
+        opts.builder.http1_writev(enabled != 0);
+        hyper_code::HYPERE_OK
+    }
+}
+
+ffi_fn! {
+    /// Set the low and high watermarks of the HTTP/1 write buffer, in bytes.
+    ///
+    /// A request body's data callback is polled until `high` bytes are
+    /// waiting to be written, and is then not polled again until the
+    /// connection has written them down to `low` bytes. Being polled again is
+    /// the signal that the connection can take more data, so a callback that
+    /// produces data from elsewhere never has more than about `high` bytes
+    /// buffered per connection.
+    ///
+    /// By default, the body is polled whenever less than the max buffer size
+    /// is waiting. Passing a `low` that is not below `high` is an error.
+    fn hyper_clientconn_options_http1_write_watermarks(opts: *mut hyper_clientconn_options, low: size_t, high: size_t) -> hyper_code {
+        if opts.is_null() || low >= high {
+            return hyper_code::HYPERE_INVALID_ARG;
+        }
+        let opts = unsafe { &mut *opts };
+        opts.builder.http1_write_watermarks(low, high);
+        hyper_code::HYPERE_OK
+    }
+}
+
+ffi_fn! {
+    /// Set whether connections made with these options keep stats.
+    ///
+    /// The stats are cheap counters and timestamps, read with
+    /// `hyper_clientconn_get_stats` and `hyper_response_head_latency_ns`.
+    ///
+    /// Pass `0` to disable, `1` to enable. Default is disabled.
+    fn hyper_clientconn_options_stats(opts: *mut hyper_clientconn_options, enabled: c_int) -> hyper_code {
+        if opts.is_null() {
+            return hyper_code::HYPERE_INVALID_ARG;
+        }
+        let opts = unsafe { &mut *opts };
+        opts.stats = enabled != 0;
+        hyper_code::HYPERE_OK
+    }
+}
+
+ffi_fn! {
+    /// Set the memory budget that connections made with these options
+    /// account their buffers to, and stay within.
+    ///
+    /// Many connections can share one budget, which then limits the memory
+    /// they hold in total. The usage of a single connection is read with
+    /// `hyper_clientconn_get_memory_usage`. Only HTTP/1 buffers are limited;
+    /// the flow control windows of HTTP2 already bound what it buffers.
+    ///
+    /// This does not consume the `memory`.
+    fn hyper_clientconn_options_memory(opts: *mut hyper_clientconn_options, memory: *const hyper_memory) -> hyper_code {
+        if opts.is_null() || memory.is_null() {
+            return hyper_code::HYPERE_INVALID_ARG;
+        }
+        let opts = unsafe { &mut *opts };
+        opts.memory = Some(unsafe { &*memory }.budget());
+        hyper_code::HYPERE_OK
+    }
+}
+
+ffi_fn! {
+    /// Set whether HTTP/1 connections free their read and write buffers
+    /// while idle.
+    ///
+    /// An idle connection otherwise keeps its buffers for the next request.
+    /// Freeing them makes many idle connections, such as those kept in a
+    /// pool, much cheaper, at the cost of allocating again once one is used.
+    ///
+    /// Pass `0` to disable, `1` to enable. Default is disabled.
+    fn hyper_clientconn_options_http1_release_idle_buffers(opts: *mut hyper_clientconn_options, enabled: c_int) -> hyper_code {
+        if opts.is_null() {
+            return hyper_code::HYPERE_INVALID_ARG;
+        }
+        let opts = unsafe { &mut *opts };
+        opts.builder.http1_release_idle_buffers(enabled != 0);
+        hyper_code::HYPERE_OK
+    }
+}
+
+ffi_fn! {
+    /// Set the pool that connections made with these options belong to.
+    ///
+    /// The `uri` must contain a scheme and authority, such as
+    /// `http://example.com`, which is the key the connection is pooled under.
+    /// Any path in it is ignored, so a request URI may be passed.
+    ///
+    /// Once the `hyper_clientconn *` from the handshake is freed with
+    /// `hyper_clientconn_free`, it is returned to the pool to be checked out
+    /// again, instead of being closed.
+    ///
+    /// This does not consume the `pool`.
+    fn hyper_clientconn_options_pool(opts: *mut hyper_clientconn_options, pool: *const hyper_clientconn_pool, uri: *const u8, uri_len: size_t) -> hyper_code {
+        if opts.is_null() || pool.is_null() {
+            return hyper_code::HYPERE_INVALID_ARG;
+        }
+        let opts = unsafe { &mut *opts };
+        let pool = unsafe { &*pool };
+        let key = match unsafe { pool_key(uri, uri_len) } {
+            Some(key) => key,
+            None => return hyper_code::HYPERE_INVALID_ARG,
+        };
+
+        opts.pool = Some(PoolTarget {
+            pool: pool.pool.clone(),
+            key,
+            exec: pool.exec.clone(),
+        });
+        hyper_code::HYPERE_OK
+    }
+}
+
+// ===== impl hyper_clientconn_pool =====
+
+ffi_fn! {
+    /// Creates a new pool of idle client connections.
+    ///
+    /// Up to `max_idle_per_host` idle connections are kept for each scheme
+    /// and authority. Connections that have been idle for longer than
+    /// `idle_timeout_ms` milliseconds are not handed out again, and `0`
+    /// means idle connections never expire.
+    ///
+    /// The `exec` is used to wait for freed connections to be ready before
+    /// they are returned to the pool. This does not consume the `exec`.
+    ///
+    /// Returns `NULL` if `max_idle_per_host` is `0`.
+    fn hyper_clientconn_pool_new(exec: *const hyper_executor, max_idle_per_host: size_t, idle_timeout_ms: u64) -> *mut hyper_clientconn_pool {
+        if exec.is_null() || max_idle_per_host == 0 {
+            return std::ptr::null_mut();
+        }
+
+        let exec = unsafe { Arc::from_raw(exec) };
+        let weak_exec = hyper_executor::downgrade(&exec);
+        std::mem::forget(exec);
+
+        let config = pool::Config {
+            idle_timeout: if idle_timeout_ms == 0 {
+                None
+            } else {
+                Some(Duration::from_millis(idle_timeout_ms))
+            },
+            max_idle_per_host,
+        };
+        let pool = Pool::new(config, &Exec::Executor(Arc::new(weak_exec.clone())));
+        // There's no tokio runtime to drive an idle interval, expired
+        // connections are skipped lazily on checkout instead.
+        pool.no_timer();
+
+        Box::into_raw(Box::new(hyper_clientconn_pool {
+            pool,
+            exec: weak_exec,
+        }))
+    } ?= std::ptr::null_mut()
+}
+
+ffi_fn! {
+    /// Free a `hyper_clientconn_pool *`.
+    ///
+    /// Idle connections in the pool are closed. Connections that are
+    /// currently checked out keep working, but are not returned to the pool.
+    fn hyper_clientconn_pool_free(pool: *mut hyper_clientconn_pool) {
+        if pool.is_null() {
+            return;
+        }
+
+        drop(unsafe { Box::from_raw(pool) });
+    }
+}
+
+ffi_fn! {
+    /// Take an idle connection for the `uri`'s scheme and authority out of
+    /// the pool, if there is one.
+    ///
+    /// Returns `NULL` right away if no idle connection is available, in which
+    /// case a new connection can be made, or a task that waits for one can be
+    /// created with `hyper_clientconn_pool_checkout`.
+    fn hyper_clientconn_pool_take(pool: *mut hyper_clientconn_pool, uri: *const u8, uri_len: size_t) -> *mut hyper_clientconn {
+        if pool.is_null() {
+            return std::ptr::null_mut();
+        }
+        let pool = unsafe { &*pool };
+        let key = match unsafe { pool_key(uri, uri_len) } {
+            Some(key) => key,
+            None => return std::ptr::null_mut(),
+        };
+
+        match pool.pool.checkout(key).now_or_never() {
+            Some(Ok(pooled)) => Box::into_raw(Box::new(pool.wrap(pooled))),
+            _ => std::ptr::null_mut(),
+        }
+    } ?= std::ptr::null_mut()
+}
+
+ffi_fn! {
+    /// Return a task that checks out a connection for the `uri`'s scheme and
+    /// authority from the pool.
+    ///
+    /// If no connection is idle, the task waits until one is returned to the
+    /// pool. When ready, the task yields a `hyper_clientconn *`.
+    fn hyper_clientconn_pool_checkout(pool: *mut hyper_clientconn_pool, uri: *const u8, uri_len: size_t) -> *mut hyper_task {
+        if pool.is_null() {
+            return std::ptr::null_mut();
+        }
+        let pool = unsafe { &*pool };
+        let key = match unsafe { pool_key(uri, uri_len) } {
+            Some(key) => key,
+            None => return std::ptr::null_mut(),
+        };
+
+        let exec = pool.exec.clone();
+        let checkout = pool.pool.checkout(key);
+        Box::into_raw(hyper_task::boxed(async move {
+            checkout
+                .await
+                .map(|pooled| hyper_clientconn {
+                    pipelined: pooled.pipelined,
+                    stats: pooled.stats.clone(),
+                    memory: pooled.memory.clone(),
+                    tx: Tx::Pooled(pooled, exec),
+                })
+        }))
+    } ?= std::ptr::null_mut()
+}
+
+impl hyper_clientconn_pool {
+    fn wrap(&self, pooled: Pooled<PoolConn>) -> hyper_clientconn {
+        hyper_clientconn {
+            pipelined: pooled.pipelined,
+            stats: pooled.stats.clone(),
+            memory: pooled.memory.clone(),
+            tx: Tx::Pooled(pooled, self.exec.clone()),
+        }
+    }
+}
+
+impl PoolTarget {
+    fn pooled(
+        self,
+        tx: conn::SendRequest<crate::Body>,
+        pipelined: bool,
+        stats: Option<Arc<ConnStats>>,
+        memory: Option<Arc<ConnMemory>>,
+    ) -> Tx {
+        match self.pool.connecting(&self.key, pool::Ver::Auto) {
+            Some(connecting) => {
+                let conn = PoolConn {
+                    tx,
+                    pipelined,
+                    stats,
+                    memory,
+                };
+                Tx::Pooled(self.pool.pooled(connecting, conn), self.exec)
+            }
+            // Only HTTP/2 connections can be refused, and those aren't
+            // shared through the pool.
+            None => Tx::Owned(tx, self.exec),
+        }
+    }
+}
+
+unsafe fn pool_key(uri: *const u8, uri_len: size_t) -> Option<pool::Key> {
+    if uri.is_null() {
+        return None;
+    }
+    let bytes = std::slice::from_raw_parts(uri, uri_len);
+    let uri = Uri::from_maybe_shared(bytes).ok()?.into_parts();
+    Some((uri.scheme?, uri.authority?))
+}
+
+impl Poolable for PoolConn {
+    fn is_open(&self) -> bool {
+        self.tx.is_ready()
+    }
+
+    fn reserve(self) -> Reservation<Self> {
+        // The C API hands out each connection exclusively, even HTTP/2 ones.
+        Reservation::Unique(self)
+    }
+
+    fn can_share(&self) -> bool {
+        false
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::ffi::task::{
+        hyper_executor_free, hyper_executor_new, hyper_executor_poll, hyper_executor_push,
+        hyper_task_free, hyper_task_type, hyper_task_value,
+    };
+
+    const URI: &[u8] = b"http://example.com/";
+
+    fn pool_take(pool: *mut hyper_clientconn_pool) -> *mut hyper_clientconn {
+        hyper_clientconn_pool_take(pool, URI.as_ptr(), URI.len())
+    }
+
+    /// Hand-shake an HTTP/1 connection over `io`, as pooled by
+    /// `hyper_clientconn_options_pool`.
+    async fn pooled_conn(
+        pool: *mut hyper_clientconn_pool,
+        io: tokio_test::io::Mock,
+    ) -> (hyper_clientconn, tokio::task::JoinHandle<()>) {
+        let pool = unsafe { &*pool };
+        let (tx, conn) = conn::Builder::new()
+            .handshake::<_, crate::Body>(io)
+            .await
+            .expect("handshake");
+        let conn = tokio::spawn(async move {
+            let _ = conn.await;
+        });
+        let target = PoolTarget {
+            pool: pool.pool.clone(),
+            key: unsafe { pool_key(URI.as_ptr(), URI.len()) }.unwrap(),
+            exec: pool.exec.clone(),
+        };
+        let conn_tx = target.pooled(tx, false, None, None);
+        let clientconn = hyper_clientconn {
+            tx: conn_tx,
+            pipelined: false,
+            stats: None,
+            memory: None,
+        };
+        (clientconn, conn)
+    }
+
+    /// An idle connection that stays open for the length of a test.
+    fn idle_io() -> tokio_test::io::Mock {
+        tokio_test::io::Builder::new()
+            .wait(Duration::from_secs(60))
+            .build()
+    }
+
+    async fn ready(conn: &mut hyper_clientconn) {
+        futures_util::future::poll_fn(|cx| conn.tx_mut().poll_ready(cx))
+            .await
+            .expect("ready");
+    }
+
+    #[tokio::test]
+    async fn test_pool_returns_freed_conn() {
+        let exec = hyper_executor_new();
+        let pool = hyper_clientconn_pool_new(exec, 1, 0);
+        assert!(pool_take(pool).is_null());
+
+        let (mut conn, _task) = pooled_conn(pool, idle_io()).await;
+        ready(&mut conn).await;
+        hyper_clientconn_free(Box::into_raw(Box::new(conn)));
+
+        let conn = pool_take(pool);
+        assert!(!conn.is_null());
+        // Until it is freed again, the connection is not idle.
+        assert!(pool_take(pool).is_null());
+
+        hyper_clientconn_free(conn);
+        hyper_clientconn_pool_free(pool);
+        hyper_executor_free(exec);
+    }
+
+    #[tokio::test]
+    async fn test_pool_skips_closed_conn() {
+        let exec = hyper_executor_new();
+        let pool = hyper_clientconn_pool_new(exec, 1, 0);
+
+        // The server closes the connection right away.
+        let io = tokio_test::io::Builder::new().build();
+        let (conn, task) = pooled_conn(pool, io).await;
+        task.await.unwrap();
+        hyper_clientconn_free(Box::into_raw(Box::new(conn)));
+        // Let the freed connection finish waiting to be ready.
+        assert!(hyper_executor_poll(exec).is_null());
+
+        assert!(pool_take(pool).is_null());
+
+        hyper_clientconn_pool_free(pool);
+        hyper_executor_free(exec);
+    }
+
+    #[tokio::test]
+    async fn test_pool_expires_idle_conn() {
+        let exec = hyper_executor_new();
+        let pool = hyper_clientconn_pool_new(exec, 1, 1);
+
+        let (mut conn, _task) = pooled_conn(pool, idle_io()).await;
+        ready(&mut conn).await;
+        hyper_clientconn_free(Box::into_raw(Box::new(conn)));
+
+        // There's no idle interval, the connection expires on checkout.
+        tokio::time::sleep(Duration::from_millis(10)).await;
+        assert!(pool_take(pool).is_null());
+
+        hyper_clientconn_pool_free(pool);
+        hyper_executor_free(exec);
+    }
+
+    #[tokio::test]
+    async fn test_pool_checkout_waits_for_freed_conn() {
+        let exec = hyper_executor_new();
+        let pool = hyper_clientconn_pool_new(exec, 1, 0);
+
+        let (mut conn, _task) = pooled_conn(pool, idle_io()).await;
+        ready(&mut conn).await;
+
+        let checkout = hyper_clientconn_pool_checkout(pool, URI.as_ptr(), URI.len());
+        assert!(!checkout.is_null());
+        assert!(matches!(
+            hyper_executor_push(exec, checkout),
+            hyper_code::HYPERE_OK
+        ));
+        assert!(hyper_executor_poll(exec).is_null(), "nothing idle yet");
+
+        hyper_clientconn_free(Box::into_raw(Box::new(conn)));
+
+        let task = hyper_executor_poll(exec);
+        assert!(!task.is_null(), "woken by the freed connection");
+        assert!(matches!(
+            hyper_task_type(task),
+            hyper_task_return_type::HYPER_TASK_CLIENTCONN
+        ));
+        hyper_clientconn_free(hyper_task_value(task) as *mut hyper_clientconn);
+        hyper_task_free(task);
+
+        hyper_clientconn_pool_free(pool);
+        hyper_executor_free(exec);
+    }
+}
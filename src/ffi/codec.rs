@@ -0,0 +1,287 @@
+use std::ffi::c_void;
+use std::pin::Pin;
+use std::ptr;
+use std::task::{Context, Poll};
+
+use bytes::{Buf as _, BufMut as _, BytesMut};
+use http::HeaderMap;
+use libc::{c_int, size_t};
+
+use super::body::hyper_body;
+use super::recycle;
+use super::UserDataPointer;
+use crate::body::{Body, Bytes, HttpBody as _};
+
+/// Return in a codec function to indicate it succeeded.
+pub const HYPER_CODEC_OK: c_int = 0;
+/// Return in a codec function to indicate the data is invalid, or the codec
+/// otherwise failed.
+pub const HYPER_CODEC_ERROR: c_int = 1;
+
+/// A streaming transform of body data, such as a decompressor, implemented
+/// by C callbacks.
+pub struct hyper_codec {
+    func: hyper_codec_callback,
+    drop_func: Option<hyper_codec_drop_callback>,
+    userdata: UserDataPointer,
+}
+
+/// The body data stage that runs a `hyper_codec` over the data of another
+/// body.
+pub(crate) struct CodecStage {
+    inner: Body,
+    codec: hyper_codec,
+    /// The unconsumed part of the last chunk from `inner`.
+    input: Bytes,
+    /// Output is written in here, and split off as each chunk is returned,
+    /// so the allocation is shared by consecutive small chunks.
+    output: BytesMut,
+    buf_size: usize,
+    eof: bool,
+    done: bool,
+}
+
+type hyper_codec_callback = extern "C" fn(
+    *mut c_void,
+    *const u8,
+    size_t,
+    *mut size_t,
+    *mut u8,
+    size_t,
+    *mut size_t,
+    c_int,
+) -> c_int;
+
+type hyper_codec_drop_callback = extern "C" fn(*mut c_void);
+
+// ===== impl hyper_codec =====
+
+ffi_fn! {
+    /// Create a codec that transforms body data with `func`.
+    ///
+    /// The callback is called with the `userdata`, `in_len` bytes of input
+    /// at `in`, and room for `out_len` bytes of output at `out`. It should
+    /// consume as much input as it can, write what it produces to `out`,
+    /// and set `*in_consumed` and `*out_written` to how many bytes it
+    /// consumed and wrote. It is called again with the rest of the input,
+    /// or with more room, until all input is consumed.
+    ///
+    /// Once the input has ended, the callback is called with `finish` set to
+    /// `1`, and no input, until it writes no more output.
+    ///
+    /// The same callback works for decoders and encoders. An encoder may
+    /// hold on to input until it has enough to compress, and writes out
+    /// the rest when `finish` is set.
+    ///
+    /// The callback should return `HYPER_CODEC_OK`, or `HYPER_CODEC_ERROR` if
+    /// the data is invalid, which fails the body.
+    fn hyper_codec_new(func: hyper_codec_callback, userdata: *mut c_void) -> *mut hyper_codec {
+        Box::into_raw(Box::new(hyper_codec {
+            func,
+            drop_func: None,
+            userdata: UserDataPointer(userdata),
+        }))
+    } ?= ptr::null_mut()
+}
+
+ffi_fn! {
+    /// Set a function that is called with the codec's `userdata` when the
+    /// codec is freed.
+    ///
+    /// A codec given to a body is freed along with it, whether or not it was
+    /// read to the end, so this is where its state can be released, or put
+    /// back in a pool to be reused by another body.
+    fn hyper_codec_set_drop(codec: *mut hyper_codec, func: hyper_codec_drop_callback) {
+        let codec = unsafe { &mut *codec };
+        codec.drop_func = Some(func);
+    }
+}
+
+ffi_fn! {
+    /// Free a `hyper_codec *` that was not given to a body.
+    fn hyper_codec_free(codec: *mut hyper_codec) {
+        drop(unsafe { Box::from_raw(codec) });
+    }
+}
+
+ffi_fn! {
+    /// Create a body whose data is the data of `body`, run through `codec`.
+    ///
+    /// This is typically used to decompress a response body, once its
+    /// `Content-Encoding` header says which codec it needs. To compress a
+    /// request body, see `hyper_request_set_body_encoded`. The new body
+    /// can be read with `hyper_body_foreach`, `hyper_body_data` or
+    /// `hyper_body_read_into`. Each chunk of output is written straight
+    /// into the buffer that is then handed out, with at most `buf_size`
+    /// bytes per chunk, and only one chunk of `body` is held at a time.
+    ///
+    /// Both the `body` and the `codec` are consumed in this function call.
+    /// Returns `NULL` if `buf_size` is `0`.
+    fn hyper_body_with_codec(body: *mut hyper_body, codec: *mut hyper_codec, buf_size: size_t) -> *mut hyper_body {
+        if body.is_null() || codec.is_null() {
+            return ptr::null_mut();
+        }
+        let body = recycle::unbox(unsafe { Box::from_raw(body) });
+        let codec = unsafe { Box::from_raw(codec) };
+        if buf_size == 0 {
+            return ptr::null_mut();
+        }
+
+        let out = CodecStage::wrap(body, *codec, buf_size);
+        Box::into_raw(recycle::boxed(hyper_body::new(out)))
+    } ?= ptr::null_mut()
+}
+
+impl Drop for hyper_codec {
+    fn drop(&mut self) {
+        if let Some(drop_func) = self.drop_func {
+            drop_func(self.userdata.0);
+        }
+    }
+}
+
+// ===== impl CodecStage =====
+
+impl CodecStage {
+    /// Make a body whose data is the data of `body`, run through `codec`.
+    ///
+    /// Its length is not known up front, so it is sent with chunked framing
+    /// on HTTP/1.1.
+    pub(super) fn wrap(body: hyper_body, codec: hyper_codec, buf_size: usize) -> Body {
+        let (inner, input) = body.into_parts();
+        let stage = CodecStage {
+            inner,
+            codec,
+            input,
+            output: BytesMut::new(),
+            buf_size,
+            eof: false,
+            done: false,
+        };
+        let mut out = Body::empty();
+        out.as_ffi_mut().set_codec(stage);
+        out
+    }
+
+    pub(crate) fn poll_trailers(
+        &mut self,
+        cx: &mut Context<'_>,
+    ) -> Poll<crate::Result<Option<HeaderMap>>> {
+        Pin::new(&mut self.inner).poll_trailers(cx)
+    }
+
+    pub(crate) fn poll_data(&mut self, cx: &mut Context<'_>) -> Poll<Option<crate::Result<Bytes>>> {
+        loop {
+            if self.done {
+                return Poll::Ready(None);
+            }
+
+            if self.input.is_empty() && !self.eof {
+                match ready!(Pin::new(&mut self.inner).poll_data(cx)) {
+                    Some(Ok(chunk)) => self.input = chunk,
+                    Some(Err(err)) => return Poll::Ready(Some(Err(err))),
+                    None => self.eof = true,
+                }
+                continue;
+            }
+
+            let finish = self.input.is_empty();
+            self.output.reserve(self.buf_size);
+            let out = &mut self.output.chunk_mut()[..self.buf_size];
+
+            let mut consumed = 0;
+            let mut written = 0;
+            let ret = (self.codec.func)(
+                self.codec.userdata.0,
+                self.input.as_ptr(),
+                self.input.len(),
+                &mut consumed,
+                out.as_mut_ptr(),
+                self.buf_size,
+                &mut written,
+                finish as c_int,
+            );
+            if ret != HYPER_CODEC_OK {
+                self.done = true;
+                return Poll::Ready(Some(Err(crate::Error::new_body("codec failed"))));
+            }
+            if consumed > self.input.len() || written > self.buf_size {
+                self.done = true;
+                return Poll::Ready(Some(Err(crate::Error::new_body(
+                    "codec returned more bytes than it was given",
+                ))));
+            }
+
+            self.input.advance(consumed);
+            // We have to trust that the codec actually wrote that many bytes.
+            unsafe { self.output.advance_mut(written) };
+
+            if written > 0 {
+                return Poll::Ready(Some(Ok(self.output.split().freeze())));
+            } else if finish {
+                self.done = true;
+            } else if consumed == 0 {
+                self.done = true;
+                return Poll::Ready(Some(Err(crate::Error::new_body("codec made no progress"))));
+            }
+        }
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use futures_util::future::FutureExt as _;
+
+    /// Repeats every byte twice, and ends with a `!`.
+    extern "C" fn double(
+        userdata: *mut c_void,
+        input: *const u8,
+        in_len: size_t,
+        in_consumed: *mut size_t,
+        out: *mut u8,
+        out_len: size_t,
+        out_written: *mut size_t,
+        finish: c_int,
+    ) -> c_int {
+        let finished = unsafe { &mut *(userdata as *mut bool) };
+        let input = unsafe { std::slice::from_raw_parts(input, in_len) };
+        let out = unsafe { std::slice::from_raw_parts_mut(out, out_len) };
+
+        let mut n = 0;
+        if finish != 0 {
+            if !*finished {
+                out[0] = b'!';
+                n = 1;
+                *finished = true;
+            }
+        } else {
+            let fits = std::cmp::min(input.len(), out.len() / 2);
+            for (i, b) in input[..fits].iter().enumerate() {
+                out[i * 2] = *b;
+                out[i * 2 + 1] = *b;
+            }
+            unsafe { *in_consumed = fits };
+            n = fits * 2;
+        }
+        unsafe { *out_written = n };
+        HYPER_CODEC_OK
+    }
+
+    #[test]
+    fn test_body_with_codec() {
+        let mut finished = false;
+        let codec = hyper_codec_new(double, &mut finished as *mut bool as *mut c_void);
+        let body = Box::into_raw(Box::new(hyper_body::new(Body::from("abc"))));
+
+        let body = hyper_body_with_codec(body, codec, 4);
+        let mut body = unsafe { Box::from_raw(body) };
+
+        let mut chunks = Vec::new();
+        while let Some(chunk) = body.body.data().now_or_never().expect("ready") {
+            chunks.push(chunk.expect("chunk"));
+        }
+        // Output chunks are at most `buf_size` bytes.
+        assert_eq!(chunks, ["aabb", "cc", "!"]);
+    }
+}
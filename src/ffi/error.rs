@@ -1,5 +1,7 @@
 use libc::size_t;
 
+use super::recycle;
+
 /// A more detailed error object returned by some hyper functions.
 pub struct hyper_error(crate::Error);
 
@@ -24,15 +26,29 @@ pub enum hyper_code {
     HYPERE_FEATURE_NOT_ENABLED,
     /// The peer sent an HTTP message that could not be parsed.
     HYPERE_INVALID_PEER_MESSAGE,
+    /// The task was canceled with `hyper_canceler_cancel`.
+    HYPERE_CANCELED,
+    /// The task did not complete before its deadline.
+    HYPERE_TIMED_OUT,
 }
 
 // ===== impl hyper_error =====
 
 impl hyper_error {
     fn code(&self) -> hyper_code {
+        use crate::error::CanceledByUser;
         use crate::error::Kind as ErrorKind;
         use crate::error::User;
 
+        if self.0.is_timeout() {
+            return hyper_code::HYPERE_TIMED_OUT;
+        }
+        // Other cancellations, such as of requests still queued on a
+        // connection that closed, are connection errors.
+        if self.0.find_source::<CanceledByUser>().is_some() {
+            return hyper_code::HYPERE_CANCELED;
+        }
+
         match self.0.kind() {
             ErrorKind::Parse(_) => hyper_code::HYPERE_INVALID_PEER_MESSAGE,
             ErrorKind::IncompleteMessage => hyper_code::HYPERE_UNEXPECTED_EOF,
@@ -58,7 +74,7 @@ impl hyper_error {
 ffi_fn! {
     /// Frees a `hyper_error`.
     fn hyper_error_free(err: *mut hyper_error) {
-        drop(unsafe { Box::from_raw(err) });
+        recycle::free(unsafe { Box::from_raw(err) });
     }
 }
 
@@ -83,3 +99,17 @@ ffi_fn! {
         unsafe { &*err }.print_to(dst)
     }
 }
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_error_code_canceled_only_by_user() {
+        let closed = hyper_error(crate::Error::new_canceled().with("connection closed"));
+        assert!(matches!(closed.code(), hyper_code::HYPERE_ERROR));
+
+        let canceled = hyper_error(crate::Error::new_canceled().with(crate::error::CanceledByUser));
+        assert!(matches!(canceled.code(), hyper_code::HYPERE_CANCELED));
+    }
+}
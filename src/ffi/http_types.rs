@@ -1,12 +1,18 @@
 use bytes::Bytes;
 use libc::{c_int, size_t};
 use std::ffi::c_void;
+use std::sync::atomic::{AtomicU8, Ordering};
+use std::sync::{Arc, Mutex};
+use std::task::{Context, Poll, Waker};
+use std::time::Duration;
 
 use super::body::{hyper_body, hyper_buf};
+use super::codec::{hyper_codec, CodecStage};
 use super::error::hyper_code;
-use super::task::{hyper_task_return_type, AsTaskType};
+use super::recycle;
+use super::task::{hyper_executor, hyper_task_return_type, AsTaskType, Expire, WeakExec};
 use super::{UserDataPointer, HYPER_ITER_CONTINUE};
-use crate::ext::HeaderCaseMap;
+use crate::ext::{EncodedHeaders, HeaderCaseMap};
 use crate::header::{HeaderName, HeaderValue};
 use crate::{Body, HeaderMap, Method, Request, Response, Uri};
 
@@ -16,24 +22,89 @@ pub struct hyper_request(pub(super) Request<Body>);
 /// An HTTP response.
 pub struct hyper_response(pub(super) Response<Body>);
 
+/// A template for building many requests that share their method, version
+/// and headers.
+pub struct hyper_request_template {
+    method: Method,
+    version: http::Version,
+    headers: HeaderMap,
+    orig_casing: HeaderCaseMap,
+    encoded: Option<EncodedHeaders>,
+}
+
 /// An HTTP header map.
 ///
 /// These can be part of a request or response.
 pub struct hyper_headers {
     pub(super) headers: HeaderMap,
     orig_casing: HeaderCaseMap,
+    /// The serialized headers of the template this came from, kept until
+    /// a header it holds is changed.
+    encoded: Option<EncodedHeaders>,
+}
+
+/// A header name, parsed once so it can be reused to add many headers.
+pub struct hyper_header_name {
+    name: HeaderName,
+    orig: Bytes,
 }
 
 #[derive(Debug)]
 pub(crate) struct ReasonPhrase(pub(crate) Bytes);
 
-pub(crate) struct RawHeaders(pub(crate) hyper_buf);
+/// How long after `hyper_clientconn_send` a response head was received.
+pub(crate) struct HeadLatency(pub(crate) Duration);
 
+/// The location of one header in a block of raw headers.
+///
+/// For the headers of a response, the offsets are from the start of the
+/// buffer returned by `hyper_response_headers_raw()`.
+#[repr(C)]
+#[derive(Clone, Copy)]
+pub struct hyper_header_span {
+    /// The offset of the header name.
+    pub name_offset: size_t,
+    /// The length of the header name.
+    pub name_len: size_t,
+    /// The offset of the header value.
+    pub value_offset: size_t,
+    /// The length of the header value.
+    pub value_len: size_t,
+}
+
+pub(crate) struct RawHeaders {
+    pub(crate) buf: hyper_buf,
+    /// The headers as they were received, in order.
+    pub(crate) spans: Vec<hyper_header_span>,
+    /// Whether the `HeaderCaseMap`, which isn't kept alongside the spans,
+    /// has been rebuilt for the `hyper_headers` of the response.
+    casing_restored: bool,
+}
+
+/// What to do with the informational (1xx) responses to a request.
+#[derive(Default)]
 pub(crate) struct OnInformational {
-    func: hyper_request_on_informational_callback,
-    data: UserDataPointer,
+    callback: Option<(hyper_request_on_informational_callback, UserDataPointer)>,
+    tasks: Option<(WeakExec, UserDataPointer)>,
+    continue_gate: Option<Arc<ContinueGate>>,
+    /// Whether an HTTP/1 connection wrote the request, and so will see any
+    /// `100 Continue` for it.
+    armed: bool,
 }
 
+/// Holds back a request body until the server answers its
+/// `Expect: 100-continue`.
+pub(crate) struct ContinueGate {
+    state: AtomicU8,
+    waker: Mutex<Option<Waker>>,
+    /// How long to wait for an answer before sending the body anyway.
+    timeout: Duration,
+}
+
+const GATE_WAITING: u8 = 0;
+const GATE_OPEN: u8 = 1;
+const GATE_CLOSED: u8 = 2;
+
 type hyper_request_on_informational_callback = extern "C" fn(*mut c_void, *const hyper_response);
 
 // ===== impl hyper_request =====
@@ -41,14 +112,14 @@ type hyper_request_on_informational_callback = extern "C" fn(*mut c_void, *const
 ffi_fn! {
     /// Construct a new HTTP request.
     fn hyper_request_new() -> *mut hyper_request {
-        Box::into_raw(Box::new(hyper_request(Request::new(Body::empty()))))
+        Box::into_raw(recycle::boxed(hyper_request(Request::new(Body::empty()))))
     } ?= std::ptr::null_mut()
 }
 
 ffi_fn! {
     /// Free an HTTP request if not going to send it on a client.
     fn hyper_request_free(req: *mut hyper_request) {
-        drop(unsafe { Box::from_raw(req) });
+        recycle::free(unsafe { Box::from_raw(req) });
     }
 }
 
@@ -130,8 +201,54 @@ ffi_fn! {
     /// This takes ownership of the `hyper_body *`, you must not use it or
     /// free it after setting it on the request.
     fn hyper_request_set_body(req: *mut hyper_request, body: *mut hyper_body) -> hyper_code {
-        let body = unsafe { Box::from_raw(body) };
-        *unsafe { &mut *req }.0.body_mut() = body.0;
+        let body = recycle::unbox(unsafe { Box::from_raw(body) });
+        *unsafe { &mut *req }.0.body_mut() = body.into_body();
+        hyper_code::HYPERE_OK
+    }
+}
+
+ffi_fn! {
+    /// Set the body of the request, run through a `codec` that compresses it.
+    ///
+    /// The `Content-Encoding` header is set to `encoding`, such as `gzip`,
+    /// and any `Content-Length` header is removed, since the compressed
+    /// length is not known up front. The body is then sent with chunked
+    /// framing on HTTP/1.1. Chunks of compressed data are at most
+    /// `buf_size` bytes.
+    ///
+    /// The codec keeps its state for the whole body. To reuse the state
+    /// of an encoder for the next request, reset it in the drop callback
+    /// of the codec, and pass it in the `userdata` of a new codec.
+    ///
+    /// Both the `body` and the `codec` are consumed in this function call,
+    /// even if it fails.
+    fn hyper_request_set_body_encoded(req: *mut hyper_request, body: *mut hyper_body, codec: *mut hyper_codec, encoding: *const u8, encoding_len: size_t, buf_size: size_t) -> hyper_code {
+        if body.is_null() || codec.is_null() {
+            return hyper_code::HYPERE_INVALID_ARG;
+        }
+        let body = recycle::unbox(unsafe { Box::from_raw(body) });
+        let codec = unsafe { Box::from_raw(codec) };
+
+        if encoding.is_null() {
+            return hyper_code::HYPERE_INVALID_ARG;
+        }
+        let encoding = unsafe { std::slice::from_raw_parts(encoding, encoding_len) };
+        let encoding = match HeaderValue::from_bytes(encoding) {
+            Ok(encoding) => encoding,
+            Err(_) => return hyper_code::HYPERE_INVALID_ARG,
+        };
+        if req.is_null() || buf_size == 0 {
+            return hyper_code::HYPERE_INVALID_ARG;
+        }
+
+        let req = unsafe { &mut *req };
+        let headers = hyper_headers::get_or_default(req.0.extensions_mut());
+        headers.changing(&http::header::CONTENT_ENCODING);
+        headers.headers.remove(http::header::CONTENT_LENGTH);
+        headers.headers.insert(http::header::CONTENT_ENCODING, encoding);
+        headers.orig_casing.insert(http::header::CONTENT_ENCODING, Bytes::from_static(b"Content-Encoding"));
+
+        *req.0.body_mut() = CodecStage::wrap(body, *codec, buf_size);
         hyper_code::HYPERE_OK
     }
 }
@@ -151,32 +268,310 @@ ffi_fn! {
     ///
     /// NOTE: The `const hyper_response *` is just borrowed data, and will not
     /// be valid after the callback finishes. You must copy any data you wish
-    /// to persist.
+    /// to persist. To keep the responses instead, see
+    /// `hyper_request_on_informational_task`.
     fn hyper_request_on_informational(req: *mut hyper_request, callback: hyper_request_on_informational_callback, data: *mut c_void) -> hyper_code {
-        let ext = OnInformational {
-            func: callback,
-            data: UserDataPointer(data),
-        };
-        unsafe { &mut *req }.0.extensions_mut().insert(ext);
+        let on = OnInformational::get_or_default(&mut unsafe { &mut *req }.0);
+        on.callback = Some((callback, UserDataPointer(data)));
+        hyper_code::HYPERE_OK
+    }
+}
+
+ffi_fn! {
+    /// Deliver each informational (1xx) response to this request, such as
+    /// `103 Early Hints`, as its own task on the executor.
+    ///
+    /// Each response is pushed to `exec` as a task that has already
+    /// completed, with type `HYPER_TASK_RESPONSE` and `userdata` as its
+    /// `hyper_task_userdata`, so it is returned by
+    /// `hyper_executor_poll` like any other task. The `hyper_response *` is
+    /// owned by the caller, and its headers are moved into it rather than
+    /// copied. The body of the response is always empty.
+    ///
+    /// This can be used together with `hyper_request_on_informational`. It
+    /// does not consume the `exec`.
+    fn hyper_request_on_informational_task(req: *mut hyper_request, exec: *const hyper_executor, userdata: *mut c_void) -> hyper_code {
+        if req.is_null() || exec.is_null() {
+            return hyper_code::HYPERE_INVALID_ARG;
+        }
+
+        let exec = unsafe { Arc::from_raw(exec) };
+        let weak_exec = hyper_executor::downgrade(&exec);
+        std::mem::forget(exec);
+
+        let on = OnInformational::get_or_default(&mut unsafe { &mut *req }.0);
+        on.tasks = Some((weak_exec, UserDataPointer(userdata)));
         hyper_code::HYPERE_OK
     }
 }
 
+ffi_fn! {
+    /// Send this request with `Expect: 100-continue`, and hold back its body
+    /// until the server answers with `100 Continue`.
+    ///
+    /// If the server sends a final response first, such as to reject a large
+    /// upload, the body is never sent. It fails instead, which closes the
+    /// connection once the response has been received.
+    ///
+    /// A server may ignore the `Expect` header, and wait for the body without
+    /// answering. So once `timeout_ms` milliseconds have passed since the
+    /// request was sent with `hyper_clientconn_send`, the body is sent
+    /// anyway. This timer runs on the executor of the connection: the one
+    /// given to `hyper_clientconn_options_exec`, or to
+    /// `hyper_clientconn_pool_new` for pooled connections. See
+    /// `hyper_executor_next_timeout`.
+    ///
+    /// The body is held back on HTTP/1.1 connections only. On HTTP/2, it is
+    /// sent right away.
+    fn hyper_request_expect_continue(req: *mut hyper_request, timeout_ms: u64) -> hyper_code {
+        if req.is_null() {
+            return hyper_code::HYPERE_INVALID_ARG;
+        }
+
+        let req = unsafe { &mut *req };
+        let headers = hyper_headers::get_or_default(req.0.extensions_mut());
+        headers.changing(&http::header::EXPECT);
+        headers.headers.insert(http::header::EXPECT, HeaderValue::from_static("100-continue"));
+        headers.orig_casing.insert(http::header::EXPECT, Bytes::from_static(b"Expect"));
+
+        let on = OnInformational::get_or_default(&mut req.0);
+        on.continue_gate = Some(Arc::new(ContinueGate::new(Duration::from_millis(timeout_ms))));
+        hyper_code::HYPERE_OK
+    }
+}
+
+ffi_fn! {
+    /// Get a pointer to the HTTP Method of this request.
+    ///
+    /// This buffer is not null-terminated.
+    ///
+    /// This buffer is owned by the request, and should not be used after
+    /// the request has been freed.
+    ///
+    /// Use `hyper_request_method_len()` to get the length of this buffer.
+    fn hyper_request_method(req: *const hyper_request) -> *const u8 {
+        unsafe { &*req }.0.method().as_str().as_ptr()
+    } ?= std::ptr::null()
+}
+
+ffi_fn! {
+    /// Get the length of the HTTP Method of this request.
+    ///
+    /// Use `hyper_request_method()` to get the buffer pointer.
+    fn hyper_request_method_len(req: *const hyper_request) -> size_t {
+        unsafe { &*req }.0.method().as_str().len()
+    }
+}
+
+ffi_fn! {
+    /// Get a pointer to the path and query of this request's URI, such as
+    /// `/index.html?lang=en`.
+    ///
+    /// This buffer is not null-terminated.
+    ///
+    /// This buffer is owned by the request, and should not be used after
+    /// the request has been freed.
+    ///
+    /// Use `hyper_request_path_and_query_len()` to get the length of this
+    /// buffer.
+    fn hyper_request_path_and_query(req: *const hyper_request) -> *const u8 {
+        unsafe { &*req }.path_and_query().as_ptr()
+    } ?= std::ptr::null()
+}
+
+ffi_fn! {
+    /// Get the length of the path and query of this request's URI.
+    ///
+    /// Use `hyper_request_path_and_query()` to get the buffer pointer.
+    fn hyper_request_path_and_query_len(req: *const hyper_request) -> size_t {
+        unsafe { &*req }.path_and_query().len()
+    }
+}
+
+ffi_fn! {
+    /// Get the HTTP version of this request.
+    ///
+    /// The returned value could be:
+    ///
+    /// - `HYPER_HTTP_VERSION_1_0`
+    /// - `HYPER_HTTP_VERSION_1_1`
+    /// - `HYPER_HTTP_VERSION_2`
+    /// - `HYPER_HTTP_VERSION_NONE` if newer (or older).
+    fn hyper_request_version(req: *const hyper_request) -> c_int {
+        version_to_int(unsafe { &*req }.0.version())
+    }
+}
+
+ffi_fn! {
+    /// Take ownership of the body of this request.
+    ///
+    /// It is safe to free the request even after taking ownership of its body.
+    fn hyper_request_body(req: *mut hyper_request) -> *mut hyper_body {
+        let body = std::mem::take(unsafe { &mut *req }.0.body_mut());
+        Box::into_raw(recycle::boxed(hyper_body::new(body)))
+    } ?= std::ptr::null_mut()
+}
+
 impl hyper_request {
+    #[cfg(feature = "server")]
+    pub(super) fn wrap(mut req: Request<Body>) -> hyper_request {
+        let headers = std::mem::take(req.headers_mut());
+        let orig_casing = req
+            .extensions_mut()
+            .remove::<HeaderCaseMap>()
+            .unwrap_or_else(HeaderCaseMap::default);
+        req.extensions_mut().insert(hyper_headers {
+            headers,
+            orig_casing,
+            encoded: None,
+        });
+
+        hyper_request(req)
+    }
+
+    fn path_and_query(&self) -> &str {
+        self.0
+            .uri()
+            .path_and_query()
+            .map(|pq| pq.as_str())
+            .unwrap_or("")
+    }
+
     pub(super) fn finalize_request(&mut self) {
         if let Some(headers) = self.0.extensions_mut().remove::<hyper_headers>() {
             *self.0.headers_mut() = headers.headers;
             self.0.extensions_mut().insert(headers.orig_casing);
+            if let Some(encoded) = headers.encoded {
+                self.0.extensions_mut().insert(encoded);
+            }
+        }
+
+        let gate = self
+            .0
+            .extensions()
+            .get::<OnInformational>()
+            .and_then(|on| on.continue_gate.clone());
+        if let Some(gate) = gate {
+            let inner = std::mem::take(self.0.body_mut());
+            self.0
+                .body_mut()
+                .as_ffi_mut()
+                .set_continue_gate(gate, inner);
         }
     }
+
+    /// Start waiting for the `100 Continue` of a request with
+    /// `hyper_request_expect_continue`, on the connection's executor.
+    pub(super) fn start_continue_timer(&self, exec: &WeakExec) {
+        let gate = self
+            .0
+            .extensions()
+            .get::<OnInformational>()
+            .and_then(|on| on.continue_gate.clone());
+        if let Some(gate) = gate {
+            let timeout = gate.timeout;
+            let gate: Arc<dyn Expire> = gate;
+            exec.add_timer(timeout, Arc::downgrade(&gate));
+        }
+    }
+}
+
+// ===== impl hyper_request_template =====
+
+ffi_fn! {
+    /// Create a template from the method, version and headers of a request.
+    ///
+    /// These are validated once, when the request is built, so each request
+    /// made from the template is a cheap copy. The URI, body and any other
+    /// options of the request are not part of the template.
+    ///
+    /// The headers are also serialized once, so sending a request made from
+    /// the template over HTTP/1 copies them in one go. Headers added to such
+    /// a request are written after them. Changing one of the template's
+    /// headers on a request means that request serializes its headers as
+    /// usual.
+    ///
+    /// This does not consume the request, which can still be sent or freed.
+    fn hyper_request_template_new(req: *const hyper_request) -> *mut hyper_request_template {
+        if req.is_null() {
+            return std::ptr::null_mut();
+        }
+
+        let req = &unsafe { &*req }.0;
+        let (headers, orig_casing) = match req.extensions().get::<hyper_headers>() {
+            Some(headers) => (headers.headers.clone(), headers.orig_casing.clone()),
+            None => (req.headers().clone(), HeaderCaseMap::default()),
+        };
+        let encoded = EncodedHeaders::new(&headers, &orig_casing);
+
+        Box::into_raw(Box::new(hyper_request_template {
+            method: req.method().clone(),
+            version: req.version(),
+            headers,
+            orig_casing,
+            encoded,
+        }))
+    } ?= std::ptr::null_mut()
+}
+
+ffi_fn! {
+    /// Free a `hyper_request_template *`.
+    ///
+    /// Requests already made from the template are not affected.
+    fn hyper_request_template_free(tmpl: *mut hyper_request_template) {
+        drop(unsafe { Box::from_raw(tmpl) });
+    }
+}
+
+ffi_fn! {
+    /// Make a new request from a template, with the provided URI.
+    ///
+    /// The request can be changed further like any other, such as to add
+    /// headers specific to it, or to set a body.
+    ///
+    /// Returns NULL if the URI is not valid.
+    fn hyper_request_template_request(tmpl: *const hyper_request_template, uri: *const u8, uri_len: size_t) -> *mut hyper_request {
+        if tmpl.is_null() {
+            return std::ptr::null_mut();
+        }
+
+        let tmpl = unsafe { &*tmpl };
+        let bytes = unsafe { std::slice::from_raw_parts(uri, uri_len as usize) };
+        let uri = match Uri::from_maybe_shared(bytes) {
+            Ok(uri) => uri,
+            Err(_) => return std::ptr::null_mut(),
+        };
+
+        let mut req = Request::new(Body::empty());
+        *req.method_mut() = tmpl.method.clone();
+        *req.uri_mut() = uri;
+        *req.version_mut() = tmpl.version;
+        req.extensions_mut().insert(hyper_headers {
+            headers: tmpl.headers.clone(),
+            orig_casing: tmpl.orig_casing.clone(),
+            encoded: tmpl.encoded.clone(),
+        });
+
+        Box::into_raw(recycle::boxed(hyper_request(req)))
+    } ?= std::ptr::null_mut()
 }
 
 // ===== impl hyper_response =====
 
+ffi_fn! {
+    /// Construct a new HTTP response, such as to answer a request received
+    /// by a server connection.
+    ///
+    /// The default status is `200`, with an empty body.
+    fn hyper_response_new() -> *mut hyper_response {
+        Box::into_raw(recycle::boxed(hyper_response(Response::new(Body::empty()))))
+    } ?= std::ptr::null_mut()
+}
+
 ffi_fn! {
     /// Free an HTTP response after using it.
     fn hyper_response_free(resp: *mut hyper_response) {
-        drop(unsafe { Box::from_raw(resp) });
+        recycle::free(unsafe { Box::from_raw(resp) });
     }
 }
 
@@ -189,6 +584,23 @@ ffi_fn! {
     }
 }
 
+ffi_fn! {
+    /// Set the HTTP-Status code of this response.
+    ///
+    /// The `status` must be within the range of 100-999.
+    fn hyper_response_set_status(resp: *mut hyper_response, status: u16) -> hyper_code {
+        match http::StatusCode::from_u16(status) {
+            Ok(status) => {
+                *unsafe { &mut *resp }.0.status_mut() = status;
+                hyper_code::HYPERE_OK
+            },
+            Err(_) => {
+                hyper_code::HYPERE_INVALID_ARG
+            }
+        }
+    }
+}
+
 ffi_fn! {
     /// Get a pointer to the reason-phrase of this response.
     ///
@@ -227,12 +639,39 @@ ffi_fn! {
     /// getting the bytes and length.
     fn hyper_response_headers_raw(resp: *const hyper_response) -> *const hyper_buf {
         match unsafe { &*resp }.0.extensions().get::<RawHeaders>() {
-            Some(raw) => &raw.0,
+            Some(raw) => &raw.buf,
             None => std::ptr::null(),
         }
     } ?= std::ptr::null()
 }
 
+ffi_fn! {
+    /// Get the location of each header in the raw headers of this response.
+    ///
+    /// You must have enabled `hyper_clientconn_options_headers_raw()`, or this
+    /// will return NULL.
+    ///
+    /// The headers are in the order they were received, with the names in
+    /// their original casing. The number of headers is written to `len`.
+    ///
+    /// The returned array is owned by the response, and the offsets are into
+    /// the buffer returned by `hyper_response_headers_raw()`. Reading the
+    /// headers this way doesn't allocate.
+    fn hyper_response_headers_raw_spans(resp: *const hyper_response, len: *mut size_t) -> *const hyper_header_span {
+        let spans = match unsafe { &*resp }.0.extensions().get::<RawHeaders>() {
+            Some(raw) => &raw.spans[..],
+            None => &[][..],
+        };
+        if !len.is_null() {
+            unsafe { *len = spans.len() };
+        }
+        if spans.is_empty() {
+            return std::ptr::null();
+        }
+        spans.as_ptr()
+    } ?= std::ptr::null()
+}
+
 ffi_fn! {
     /// Get the HTTP version used by this response.
     ///
@@ -243,13 +682,21 @@ ffi_fn! {
     /// - `HYPER_HTTP_VERSION_2`
     /// - `HYPER_HTTP_VERSION_NONE` if newer (or older).
     fn hyper_response_version(resp: *const hyper_response) -> c_int {
-        use http::Version;
+        version_to_int(unsafe { &*resp }.0.version())
+    }
+}
 
-        match unsafe { &*resp }.0.version() {
-            Version::HTTP_10 => super::HYPER_HTTP_VERSION_1_0,
-            Version::HTTP_11 => super::HYPER_HTTP_VERSION_1_1,
-            Version::HTTP_2 => super::HYPER_HTTP_VERSION_2,
-            _ => super::HYPER_HTTP_VERSION_NONE,
+ffi_fn! {
+    /// Get how many nanoseconds after `hyper_clientconn_send` the head of this
+    /// response was received.
+    ///
+    /// This includes any time the request spent waiting for the connection,
+    /// or pipelined behind other requests. Returns `0` if the connection was
+    /// not made with `hyper_clientconn_options_stats` enabled.
+    fn hyper_response_head_latency_ns(resp: *const hyper_response) -> u64 {
+        match unsafe { &*resp }.0.extensions().get::<HeadLatency>() {
+            Some(latency) => latency.0.as_nanos() as u64,
+            None => 0,
         }
     }
 }
@@ -260,7 +707,9 @@ ffi_fn! {
     /// This is not an owned reference, so it should not be accessed after the
     /// `hyper_response` has been freed.
     fn hyper_response_headers(resp: *mut hyper_response) -> *mut hyper_headers {
-        hyper_headers::get_or_default(unsafe { &mut *resp }.0.extensions_mut())
+        let resp = unsafe { &mut *resp };
+        resp.restore_orig_casing();
+        hyper_headers::get_or_default(resp.0.extensions_mut())
     } ?= std::ptr::null_mut()
 }
 
@@ -270,10 +719,24 @@ ffi_fn! {
     /// It is safe to free the response even after taking ownership of its body.
     fn hyper_response_body(resp: *mut hyper_response) -> *mut hyper_body {
         let body = std::mem::take(unsafe { &mut *resp }.0.body_mut());
-        Box::into_raw(Box::new(hyper_body(body)))
+        Box::into_raw(recycle::boxed(hyper_body::new(body)))
     } ?= std::ptr::null_mut()
 }
 
+ffi_fn! {
+    /// Set the body of the response.
+    ///
+    /// The default is an empty body.
+    ///
+    /// This takes ownership of the `hyper_body *`, you must not use it or
+    /// free it after setting it on the response.
+    fn hyper_response_set_body(resp: *mut hyper_response, body: *mut hyper_body) -> hyper_code {
+        let body = recycle::unbox(unsafe { Box::from_raw(body) });
+        *unsafe { &mut *resp }.0.body_mut() = body.into_body();
+        hyper_code::HYPERE_OK
+    }
+}
+
 impl hyper_response {
     pub(super) fn wrap(mut resp: Response<Body>) -> hyper_response {
         let headers = std::mem::take(resp.headers_mut());
@@ -284,11 +747,33 @@ impl hyper_response {
         resp.extensions_mut().insert(hyper_headers {
             headers,
             orig_casing,
+            encoded: None,
         });
 
         hyper_response(resp)
     }
 
+    #[cfg(feature = "server")]
+    pub(super) fn finalize_response(&mut self) {
+        if let Some(headers) = self.0.extensions_mut().remove::<hyper_headers>() {
+            *self.0.headers_mut() = headers.headers;
+            self.0.extensions_mut().insert(headers.orig_casing);
+        }
+    }
+
+    /// Rebuild the original casing of the header names from the raw header
+    /// spans, the first time the headers are asked for.
+    fn restore_orig_casing(&mut self) {
+        let orig_casing = match self.0.extensions_mut().get_mut::<RawHeaders>() {
+            Some(raw) if !raw.casing_restored => {
+                raw.casing_restored = true;
+                raw.orig_casing()
+            }
+            _ => return,
+        };
+        hyper_headers::get_or_default(self.0.extensions_mut()).orig_casing = orig_casing;
+    }
+
     fn reason_phrase(&self) -> &[u8] {
         if let Some(reason) = self.0.extensions().get::<ReasonPhrase>() {
             return &reason.0;
@@ -302,12 +787,53 @@ impl hyper_response {
     }
 }
 
+impl RawHeaders {
+    pub(crate) fn new(buf: Bytes, spans: Vec<hyper_header_span>) -> RawHeaders {
+        RawHeaders {
+            buf: hyper_buf(buf),
+            spans,
+            casing_restored: false,
+        }
+    }
+
+    fn orig_casing(&self) -> HeaderCaseMap {
+        let mut orig_casing = HeaderCaseMap::default();
+        for span in &self.spans {
+            let orig = self
+                .buf
+                .0
+                .slice(span.name_offset..span.name_offset + span.name_len);
+            if let Ok(name) = HeaderName::from_bytes(&orig) {
+                orig_casing.append(&name, orig);
+            }
+        }
+        orig_casing
+    }
+}
+
 unsafe impl AsTaskType for hyper_response {
     fn as_task_type(&self) -> hyper_task_return_type {
         hyper_task_return_type::HYPER_TASK_RESPONSE
     }
 }
 
+unsafe impl AsTaskType for hyper_headers {
+    fn as_task_type(&self) -> hyper_task_return_type {
+        hyper_task_return_type::HYPER_TASK_HEADERS
+    }
+}
+
+fn version_to_int(version: http::Version) -> c_int {
+    use http::Version;
+
+    match version {
+        Version::HTTP_10 => super::HYPER_HTTP_VERSION_1_0,
+        Version::HTTP_11 => super::HYPER_HTTP_VERSION_1_1,
+        Version::HTTP_2 => super::HYPER_HTTP_VERSION_2,
+        _ => super::HYPER_HTTP_VERSION_NONE,
+    }
+}
+
 // ===== impl Headers =====
 
 type hyper_headers_foreach_callback =
@@ -321,6 +847,39 @@ impl hyper_headers {
 
         ext.get_mut::<hyper_headers>().unwrap()
     }
+
+    pub(super) fn from_map(headers: HeaderMap) -> hyper_headers {
+        hyper_headers {
+            headers,
+            ..hyper_headers::default()
+        }
+    }
+
+    /// Drop the serialized template headers if they hold this name, before
+    /// headers with it are changed.
+    fn changing(&mut self, name: &HeaderName) {
+        if self.encoded.as_ref().map_or(false, |e| e.contains(name)) {
+            self.encoded = None;
+        }
+    }
+}
+
+ffi_fn! {
+    /// Create an empty header map that is not part of a request or response,
+    /// such as for the trailers of a body.
+    fn hyper_headers_new() -> *mut hyper_headers {
+        Box::into_raw(Box::new(hyper_headers::default()))
+    } ?= std::ptr::null_mut()
+}
+
+ffi_fn! {
+    /// Free a `hyper_headers *` owned by the caller, such as one returned by
+    /// `hyper_headers_new` or a `hyper_body_trailers` task.
+    ///
+    /// This must not be called with the headers of a request or response.
+    fn hyper_headers_free(headers: *mut hyper_headers) {
+        drop(unsafe { Box::from_raw(headers) });
+    }
 }
 
 ffi_fn! {
@@ -369,6 +928,7 @@ ffi_fn! {
         let headers = unsafe { &mut *headers };
         match unsafe { raw_name_value(name, name_len, value, value_len) } {
             Ok((name, value, orig_name)) => {
+                headers.changing(&name);
                 headers.headers.insert(&name, value);
                 headers.orig_casing.insert(name, orig_name);
                 hyper_code::HYPERE_OK
@@ -388,6 +948,7 @@ ffi_fn! {
 
         match unsafe { raw_name_value(name, name_len, value, value_len) } {
             Ok((name, value, orig_name)) => {
+                headers.changing(&name);
                 headers.headers.append(&name, value);
                 headers.orig_casing.append(name, orig_name);
                 hyper_code::HYPERE_OK
@@ -397,11 +958,79 @@ ffi_fn! {
     }
 }
 
+ffi_fn! {
+    /// Adds many headers at once, from a block of bytes holding their names
+    /// and values.
+    ///
+    /// Each `hyper_header_span` gives the location of a name and its value in
+    /// the `block`, such as the spans from `hyper_response_headers_raw_spans()`.
+    /// The block is copied once, and all the headers share that copy.
+    ///
+    /// Every header is validated before any is added. If one is invalid, this
+    /// returns `HYPERE_INVALID_ARG` and the headers are left unchanged.
+    ///
+    /// Like `hyper_headers_add()`, this appends to any existing values.
+    fn hyper_headers_add_block(headers: *mut hyper_headers, block: *const u8, block_len: size_t, spans: *const hyper_header_span, spans_len: size_t) -> hyper_code {
+        if headers.is_null() || (block.is_null() && block_len != 0) || (spans.is_null() && spans_len != 0) {
+            return hyper_code::HYPERE_INVALID_ARG;
+        }
+        if spans_len == 0 {
+            return hyper_code::HYPERE_OK;
+        }
+
+        let headers = unsafe { &mut *headers };
+        let block = Bytes::copy_from_slice(unsafe { std::slice::from_raw_parts(block, block_len) });
+        let spans = unsafe { std::slice::from_raw_parts(spans, spans_len) };
+
+        let mut parsed = Vec::with_capacity(spans.len());
+        for span in spans {
+            match span_name_value(&block, span) {
+                Some(header) => parsed.push(header),
+                None => return hyper_code::HYPERE_INVALID_ARG,
+            }
+        }
+
+        headers.headers.reserve(parsed.len());
+        for (name, value, orig_name) in parsed {
+            headers.changing(&name);
+            headers.headers.append(&name, value);
+            headers.orig_casing.append(name, orig_name);
+        }
+        hyper_code::HYPERE_OK
+    }
+}
+
+ffi_fn! {
+    /// Adds the provided value to the list of a parsed header name.
+    ///
+    /// This is the same as `hyper_headers_add()`, but skips parsing the name
+    /// again, which is worthwhile for names used on many requests.
+    fn hyper_headers_add_named(headers: *mut hyper_headers, name: *const hyper_header_name, value: *const u8, value_len: size_t) -> hyper_code {
+        if headers.is_null() || name.is_null() {
+            return hyper_code::HYPERE_INVALID_ARG;
+        }
+
+        let headers = unsafe { &mut *headers };
+        let name = unsafe { &*name };
+        let value = unsafe { std::slice::from_raw_parts(value, value_len) };
+        match HeaderValue::from_bytes(value) {
+            Ok(value) => {
+                headers.changing(&name.name);
+                headers.headers.append(&name.name, value);
+                headers.orig_casing.append(&name.name, name.orig.clone());
+                hyper_code::HYPERE_OK
+            }
+            Err(_) => hyper_code::HYPERE_INVALID_ARG,
+        }
+    }
+}
+
 impl Default for hyper_headers {
     fn default() -> Self {
         Self {
             headers: Default::default(),
             orig_casing: HeaderCaseMap::default(),
+            encoded: None,
         }
     }
 }
@@ -427,12 +1056,142 @@ unsafe fn raw_name_value(
     Ok((name, value, orig_name))
 }
 
+fn span_name_value(
+    block: &Bytes,
+    span: &hyper_header_span,
+) -> Option<(HeaderName, HeaderValue, Bytes)> {
+    let orig_name = span_bytes(block, span.name_offset, span.name_len)?;
+    let name = HeaderName::from_bytes(&orig_name).ok()?;
+    let value = span_bytes(block, span.value_offset, span.value_len)?;
+    let value = HeaderValue::from_maybe_shared(value).ok()?;
+
+    Some((name, value, orig_name))
+}
+
+fn span_bytes(block: &Bytes, offset: usize, len: usize) -> Option<Bytes> {
+    let end = offset.checked_add(len)?;
+    if end > block.len() {
+        return None;
+    }
+    Some(block.slice(offset..end))
+}
+
+// ===== impl hyper_header_name =====
+
+ffi_fn! {
+    /// Parse a header name, to add headers with it using
+    /// `hyper_headers_add_named()`.
+    ///
+    /// The original casing of the name is kept. Returns NULL if the name is
+    /// not a valid header name.
+    fn hyper_header_name_new(name: *const u8, name_len: size_t) -> *mut hyper_header_name {
+        let orig = Bytes::copy_from_slice(unsafe { std::slice::from_raw_parts(name, name_len) });
+        match HeaderName::from_bytes(&orig) {
+            Ok(name) => Box::into_raw(Box::new(hyper_header_name { name, orig })),
+            Err(_) => std::ptr::null_mut(),
+        }
+    } ?= std::ptr::null_mut()
+}
+
+ffi_fn! {
+    /// Free a `hyper_header_name *`.
+    fn hyper_header_name_free(name: *mut hyper_header_name) {
+        drop(unsafe { Box::from_raw(name) });
+    }
+}
+
 // ===== impl OnInformational =====
 
 impl OnInformational {
+    fn get_or_default(req: &mut Request<Body>) -> &mut OnInformational {
+        if let None = req.extensions().get::<OnInformational>() {
+            req.extensions_mut().insert(OnInformational::default());
+        }
+
+        req.extensions_mut().get_mut::<OnInformational>().unwrap()
+    }
+
+    /// Mark that an HTTP/1 connection has written the request.
+    pub(crate) fn armed(mut self) -> OnInformational {
+        self.armed = true;
+        self
+    }
+
     pub(crate) fn call(&mut self, resp: Response<Body>) {
-        let mut resp = hyper_response(resp);
-        (self.func)(self.data.0, &mut resp);
+        if resp.status() == http::StatusCode::CONTINUE {
+            if let Some(ref gate) = self.continue_gate {
+                gate.set(GATE_OPEN);
+            }
+        }
+
+        let mut resp = hyper_response::wrap(resp);
+        if let Some((ref func, ref data)) = self.callback {
+            func(data.0, &mut resp);
+        }
+        if let Some((ref exec, ref userdata)) = self.tasks {
+            exec.push_ready(resp, UserDataPointer(userdata.0));
+        }
+    }
+}
+
+impl Drop for OnInformational {
+    fn drop(&mut self) {
+        // Dropped by an HTTP/1 connection once the final response arrived,
+        // or before ever reaching one, such as by HTTP/2.
+        if let Some(ref gate) = self.continue_gate {
+            gate.set(if self.armed { GATE_CLOSED } else { GATE_OPEN });
+        }
+    }
+}
+
+// ===== impl ContinueGate =====
+
+impl ContinueGate {
+    fn new(timeout: Duration) -> ContinueGate {
+        ContinueGate {
+            state: AtomicU8::new(GATE_WAITING),
+            waker: Mutex::new(None),
+            timeout,
+        }
+    }
+
+    /// Open or close the gate, if it is still waiting.
+    fn set(&self, state: u8) {
+        let set = self
+            .state
+            .compare_exchange(GATE_WAITING, state, Ordering::AcqRel, Ordering::Acquire)
+            .is_ok();
+        if set {
+            if let Some(waker) = self.waker.lock().unwrap().take() {
+                waker.wake();
+            }
+        }
+    }
+
+    pub(crate) fn poll_open(&self, cx: &mut Context<'_>) -> Poll<crate::Result<()>> {
+        if self.state.load(Ordering::Acquire) == GATE_WAITING {
+            *self.waker.lock().unwrap() = Some(cx.waker().clone());
+        }
+        // Checked again after storing the waker, in case the gate was set
+        // in the meantime.
+        match self.state.load(Ordering::Acquire) {
+            GATE_WAITING => Poll::Pending,
+            GATE_OPEN => Poll::Ready(Ok(())),
+            _ => Poll::Ready(Err(crate::Error::new_body_write(
+                "final response received before 100 Continue",
+            ))),
+        }
+    }
+}
+
+impl Expire for ContinueGate {
+    fn is_pending(&self) -> bool {
+        self.state.load(Ordering::Acquire) == GATE_WAITING
+    }
+
+    /// No answer came in time, so the body is sent anyway.
+    fn expire(&self) {
+        self.set(GATE_OPEN);
     }
 }
 
@@ -488,4 +1247,444 @@ mod tests {
             HYPER_ITER_CONTINUE
         }
     }
+
+    #[test]
+    fn test_response_headers_casing_restored_from_raw_spans() {
+        let raw = Bytes::from_static(b"HTTP/1.1 200 OK\r\nX-Foo: bar\r\n\r\n");
+        let span = hyper_header_span {
+            name_offset: 17,
+            name_len: 5,
+            value_offset: 24,
+            value_len: 3,
+        };
+
+        let mut resp = Response::new(Body::empty());
+        resp.headers_mut()
+            .insert("x-foo", HeaderValue::from_static("bar"));
+        resp.extensions_mut()
+            .insert(RawHeaders::new(raw, vec![span]));
+        let mut resp = hyper_response::wrap(resp);
+
+        let mut len = 0;
+        let spans = hyper_response_headers_raw_spans(&resp, &mut len);
+        assert_eq!(len, 1);
+        assert_eq!(unsafe { (*spans).value_offset }, 24);
+
+        let headers = hyper_response_headers(&mut resp);
+        let mut names = Vec::<u8>::new();
+        hyper_headers_foreach(headers, name, &mut names as *mut _ as *mut c_void);
+        assert_eq!(names, b"X-Foo");
+
+        extern "C" fn name(
+            vec: *mut c_void,
+            name: *const u8,
+            name_len: usize,
+            _: *const u8,
+            _: usize,
+        ) -> c_int {
+            unsafe {
+                let vec = &mut *(vec as *mut Vec<u8>);
+                vec.extend(std::slice::from_raw_parts(name, name_len));
+            }
+            HYPER_ITER_CONTINUE
+        }
+    }
+
+    #[test]
+    fn test_headers_add_block() {
+        let mut headers = hyper_headers::default();
+
+        let block = b"X-Foo: barAccept";
+        let mut spans = [
+            hyper_header_span {
+                name_offset: 0,
+                name_len: 5,
+                value_offset: 7,
+                value_len: 3,
+            },
+            hyper_header_span {
+                name_offset: 10,
+                name_len: 6,
+                value_offset: 7,
+                value_len: 3,
+            },
+        ];
+        assert!(matches!(
+            hyper_headers_add_block(
+                &mut headers,
+                block.as_ptr(),
+                block.len(),
+                spans.as_ptr(),
+                spans.len()
+            ),
+            hyper_code::HYPERE_OK
+        ));
+        assert_eq!(headers.headers["x-foo"], "bar");
+        assert_eq!(headers.headers["accept"], "bar");
+        assert_eq!(
+            headers
+                .orig_casing
+                .get_all(&HeaderName::from_static("accept"))
+                .next()
+                .unwrap()
+                .as_ref(),
+            b"Accept"
+        );
+
+        // A span out of the block is rejected, without adding the others.
+        spans[1].value_len = 10;
+        assert!(matches!(
+            hyper_headers_add_block(
+                &mut headers,
+                block.as_ptr(),
+                block.len(),
+                spans.as_ptr(),
+                spans.len()
+            ),
+            hyper_code::HYPERE_INVALID_ARG
+        ));
+        assert_eq!(headers.headers.len(), 2);
+    }
+
+    #[test]
+    fn test_request_template() {
+        let proto = hyper_request_new();
+        hyper_request_set_method(proto, b"POST".as_ptr(), 4);
+        let headers = hyper_request_headers(proto);
+        hyper_headers_set(headers, b"X-Api-Key".as_ptr(), 9, b"secret".as_ptr(), 6);
+        let tmpl = hyper_request_template_new(proto);
+        hyper_request_free(proto);
+
+        let req = hyper_request_template_request(tmpl, b"/a".as_ptr(), 2);
+        assert!(!req.is_null());
+        {
+            // Headers set on one request don't leak into the template.
+            let headers = hyper_request_headers(req);
+            hyper_headers_set(headers, b"X-Extra".as_ptr(), 7, b"1".as_ptr(), 1);
+        }
+        let mut req = recycle::unbox(unsafe { Box::from_raw(req) });
+        req.finalize_request();
+        assert_eq!(req.0.method(), Method::POST);
+        assert_eq!(req.0.uri(), "/a");
+        assert_eq!(req.0.headers()["x-api-key"], "secret");
+        assert_eq!(req.0.headers().len(), 2);
+
+        let req = hyper_request_template_request(tmpl, b"/b".as_ptr(), 2);
+        let mut req = recycle::unbox(unsafe { Box::from_raw(req) });
+        req.finalize_request();
+        assert_eq!(req.0.uri(), "/b");
+        assert_eq!(req.0.headers().len(), 1);
+        assert_eq!(
+            req.0
+                .extensions()
+                .get::<HeaderCaseMap>()
+                .unwrap()
+                .get_all(&HeaderName::from_static("x-api-key"))
+                .next()
+                .unwrap()
+                .as_ref(),
+            b"X-Api-Key"
+        );
+
+        assert!(hyper_request_template_request(tmpl, b"\0".as_ptr(), 1).is_null());
+        hyper_request_template_free(tmpl);
+    }
+
+    #[test]
+    fn test_request_template_encoded_headers() {
+        let proto = hyper_request_new();
+        let headers = hyper_request_headers(proto);
+        hyper_headers_set(headers, b"X-Api-Key".as_ptr(), 9, b"secret".as_ptr(), 6);
+        let tmpl = hyper_request_template_new(proto);
+        hyper_request_free(proto);
+
+        // Adding other headers keeps the serialized template headers.
+        let req = hyper_request_template_request(tmpl, b"/a".as_ptr(), 2);
+        let headers = hyper_request_headers(req);
+        hyper_headers_add(headers, b"X-Extra".as_ptr(), 7, b"1".as_ptr(), 1);
+        let mut req = recycle::unbox(unsafe { Box::from_raw(req) });
+        req.finalize_request();
+        let encoded = req.0.extensions().get::<EncodedHeaders>().expect("encoded");
+        assert_eq!(encoded.block(), b"X-Api-Key: secret\r\n");
+
+        // Changing a template header drops them.
+        let req = hyper_request_template_request(tmpl, b"/b".as_ptr(), 2);
+        let headers = hyper_request_headers(req);
+        hyper_headers_add(headers, b"x-api-key".as_ptr(), 9, b"other".as_ptr(), 5);
+        let mut req = recycle::unbox(unsafe { Box::from_raw(req) });
+        req.finalize_request();
+        assert!(req.0.extensions().get::<EncodedHeaders>().is_none());
+
+        hyper_request_template_free(tmpl);
+    }
+
+    #[test]
+    fn test_headers_add_named() {
+        let mut headers = hyper_headers::default();
+
+        let name = hyper_header_name_new(b"X-Trace".as_ptr(), 7);
+        assert!(!name.is_null());
+        for value in &[&b"a"[..], b"b"] {
+            assert!(matches!(
+                hyper_headers_add_named(&mut headers, name, value.as_ptr(), value.len()),
+                hyper_code::HYPERE_OK
+            ));
+        }
+        hyper_header_name_free(name);
+
+        let values = headers
+            .headers
+            .get_all("x-trace")
+            .iter()
+            .collect::<Vec<_>>();
+        assert_eq!(values, ["a", "b"]);
+
+        assert!(hyper_header_name_new(b"bad name".as_ptr(), 8).is_null());
+    }
+
+    #[test]
+    fn test_request_set_body_encoded() {
+        use crate::body::HttpBody as _;
+        use crate::ffi::codec::{hyper_codec_new, HYPER_CODEC_OK};
+        use futures_util::future::FutureExt as _;
+
+        /// Upper-cases ASCII, to tell encoded output apart.
+        extern "C" fn upper(
+            _: *mut c_void,
+            input: *const u8,
+            in_len: size_t,
+            in_consumed: *mut size_t,
+            out: *mut u8,
+            out_len: size_t,
+            out_written: *mut size_t,
+            _: c_int,
+        ) -> c_int {
+            let n = std::cmp::min(in_len, out_len);
+            let input = unsafe { std::slice::from_raw_parts(input, n) };
+            let out = unsafe { std::slice::from_raw_parts_mut(out, n) };
+            for (o, i) in out.iter_mut().zip(input) {
+                *o = i.to_ascii_uppercase();
+            }
+            unsafe {
+                *in_consumed = n;
+                *out_written = n;
+            }
+            HYPER_CODEC_OK
+        }
+
+        // A missing encoding is rejected, still consuming the body and codec.
+        let req = hyper_request_new();
+        let body = Box::into_raw(Box::new(hyper_body::new(Body::from("hello"))));
+        let codec = hyper_codec_new(upper, std::ptr::null_mut());
+        assert!(matches!(
+            hyper_request_set_body_encoded(req, body, codec, std::ptr::null(), 8, 64),
+            hyper_code::HYPERE_INVALID_ARG
+        ));
+        hyper_request_free(req);
+
+        let req = hyper_request_new();
+        let headers = hyper_request_headers(req);
+        hyper_headers_set(headers, b"Content-Length".as_ptr(), 14, b"5".as_ptr(), 1);
+
+        let body = Box::into_raw(Box::new(hyper_body::new(Body::from("hello"))));
+        let codec = hyper_codec_new(upper, std::ptr::null_mut());
+        assert!(matches!(
+            hyper_request_set_body_encoded(req, body, codec, b"identity".as_ptr(), 8, 64),
+            hyper_code::HYPERE_OK
+        ));
+
+        let mut req = unsafe { Box::from_raw(req) };
+        req.finalize_request();
+        assert_eq!(req.0.headers()["content-encoding"], "identity");
+        assert!(req.0.headers().get("content-length").is_none());
+        // The encoded length isn't known, so HTTP/1.1 uses chunked framing.
+        assert_eq!(req.0.body().size_hint().exact(), None);
+
+        let mut out = Vec::new();
+        while let Some(chunk) = req.0.body_mut().data().now_or_never().expect("ready") {
+            out.extend_from_slice(&chunk.expect("chunk"));
+        }
+        assert_eq!(out, b"HELLO");
+    }
+
+    #[test]
+    fn test_request_expect_continue_gates_body() {
+        use crate::body::HttpBody as _;
+        use futures_util::future::FutureExt as _;
+
+        fn gated_request() -> hyper_request {
+            let req = hyper_request_new();
+            let body = Box::into_raw(Box::new(hyper_body::new(Body::from("hello"))));
+            hyper_request_set_body(req, body);
+            assert!(matches!(
+                hyper_request_expect_continue(req, 60_000),
+                hyper_code::HYPERE_OK
+            ));
+            let mut req = unsafe { *Box::from_raw(req) };
+            req.finalize_request();
+            req
+        }
+
+        let mut req = gated_request();
+        assert_eq!(req.0.headers()["expect"], "100-continue");
+        // The length of the held back body is still sent.
+        assert_eq!(req.0.body().size_hint().exact(), Some(5));
+
+        // As an HTTP/1 connection does once the request is written.
+        let mut on = req
+            .0
+            .extensions_mut()
+            .remove::<OnInformational>()
+            .unwrap()
+            .armed();
+        assert!(req.0.body_mut().data().now_or_never().is_none());
+
+        on.call(Response::builder().status(100).body(Body::empty()).unwrap());
+        let chunk = req.0.body_mut().data().now_or_never().expect("ready");
+        assert_eq!(chunk.expect("chunk").expect("data"), "hello");
+
+        // A final response before `100 Continue` fails the body instead.
+        let mut req = gated_request();
+        let on = req.0.extensions_mut().remove::<OnInformational>().unwrap();
+        drop(on.armed());
+        let chunk = req.0.body_mut().data().now_or_never().expect("ready");
+        assert!(chunk.expect("chunk").is_err());
+    }
+
+    #[test]
+    fn test_request_expect_continue_times_out() {
+        use crate::body::HttpBody as _;
+        use crate::ffi::task::{
+            hyper_executor_free, hyper_executor_new, hyper_executor_next_timeout,
+            hyper_executor_poll,
+        };
+        use futures_util::future::FutureExt as _;
+
+        let req = hyper_request_new();
+        let body = Box::into_raw(Box::new(hyper_body::new(Body::from("hello"))));
+        hyper_request_set_body(req, body);
+        assert!(matches!(
+            hyper_request_expect_continue(req, 0),
+            hyper_code::HYPERE_OK
+        ));
+        let mut req = unsafe { *Box::from_raw(req) };
+        req.finalize_request();
+
+        let exec = hyper_executor_new();
+        let weak_exec = {
+            let exec = unsafe { Arc::from_raw(exec) };
+            let weak_exec = hyper_executor::downgrade(&exec);
+            std::mem::forget(exec);
+            weak_exec
+        };
+        // As `hyper_clientconn_send` does.
+        req.start_continue_timer(&weak_exec);
+        assert_eq!(hyper_executor_next_timeout(exec), 0);
+        assert!(req.0.body_mut().data().now_or_never().is_none());
+
+        // The server never answered, so polling sends the body anyway.
+        assert!(hyper_executor_poll(exec).is_null());
+        let chunk = req.0.body_mut().data().now_or_never().expect("ready");
+        assert_eq!(chunk.expect("chunk").expect("data"), "hello");
+        assert_eq!(hyper_executor_next_timeout(exec), -1);
+
+        hyper_executor_free(exec);
+    }
+
+    #[test]
+    fn test_request_on_informational_task() {
+        use crate::ffi::task::{
+            hyper_executor_free, hyper_executor_new, hyper_executor_poll, hyper_task_free,
+            hyper_task_type, hyper_task_userdata, hyper_task_value,
+        };
+
+        let exec = hyper_executor_new();
+        let req = hyper_request_new();
+        let mut userdata = 0u8;
+        let userdata = &mut userdata as *mut u8 as *mut c_void;
+        assert!(matches!(
+            hyper_request_on_informational_task(req, exec, userdata),
+            hyper_code::HYPERE_OK
+        ));
+
+        let mut req = unsafe { Box::from_raw(req) };
+        let mut on = req.0.extensions_mut().remove::<OnInformational>().unwrap();
+        let hints = Response::builder()
+            .status(103)
+            .header("link", "</style.css>; rel=preload")
+            .body(Body::empty())
+            .unwrap();
+        on.call(hints);
+
+        let task = hyper_executor_poll(exec);
+        assert!(!task.is_null());
+        assert!(matches!(
+            hyper_task_type(task),
+            hyper_task_return_type::HYPER_TASK_RESPONSE
+        ));
+        assert_eq!(hyper_task_userdata(task), userdata);
+        let resp = unsafe { Box::from_raw(hyper_task_value(task) as *mut hyper_response) };
+        assert_eq!(resp.0.status(), 103);
+        assert_eq!(resp.0.headers()["link"], "</style.css>; rel=preload");
+        hyper_task_free(task);
+
+        assert!(hyper_executor_poll(exec).is_null());
+        hyper_executor_free(exec);
+    }
+
+    #[tokio::test]
+    async fn test_request_expect_continue_pipelined() {
+        use crate::proto::h1::dispatch::Client;
+        use crate::proto::h1::{ClientTransaction, Conn, Dispatcher};
+
+        extern "C" fn count(userdata: *mut c_void, _: *const hyper_response) {
+            let seen = unsafe { &*(userdata as *const AtomicU8) };
+            seen.fetch_add(1, Ordering::Relaxed);
+        }
+
+        // The `103` is for the first request, and the `100 Continue` for the
+        // second, which is written while the first response is read.
+        let io = tokio_test::io::Builder::new()
+            .write(b"GET /a HTTP/1.1\r\n\r\n")
+            .write(b"PUT /b HTTP/1.1\r\nexpect: 100-continue\r\ncontent-length: 5\r\n\r\n")
+            .read(b"HTTP/1.1 103 Early Hints\r\n\r\nHTTP/1.1 200 OK\r\ncontent-length: 0\r\n\r\n")
+            .read(b"HTTP/1.1 100 Continue\r\n\r\n")
+            .write(b"hello")
+            .read(b"HTTP/1.1 201 Created\r\ncontent-length: 0\r\n\r\n")
+            .build();
+
+        let (mut tx, rx) = crate::client::dispatch::channel();
+        let mut conn = Conn::<_, Bytes, ClientTransaction>::new(io);
+        conn.set_pipeline_depth(2);
+        let mut client = Client::new(rx);
+        client.set_pipeline_depth(2);
+        let dispatcher = tokio::spawn(Dispatcher::new(client, conn));
+
+        let seen = Box::new(AtomicU8::new(0));
+        let req = hyper_request_new();
+        hyper_request_set_method(req, b"PUT".as_ptr(), 3);
+        hyper_request_set_uri(req, b"/b".as_ptr(), 2);
+        let body = Box::into_raw(Box::new(hyper_body::new(Body::from("hello"))));
+        hyper_request_set_body(req, body);
+        hyper_request_expect_continue(req, 60_000);
+        let userdata = &*seen as *const AtomicU8 as *mut c_void;
+        hyper_request_on_informational(req, count, userdata);
+        let mut req = unsafe { *Box::from_raw(req) };
+        req.finalize_request();
+
+        let get = Request::get("/a").body(Body::empty()).unwrap();
+        let res_a = tx.send_queued(get).unwrap();
+        let res_b = tx.send_queued(req.0).unwrap();
+
+        let (res_a, res_b) =
+            tokio::time::timeout(Duration::from_secs(5), async { (res_a.await, res_b.await) })
+                .await
+                .expect("pipelined responses");
+        assert_eq!(res_a.unwrap().unwrap().status(), 200);
+        assert_eq!(res_b.unwrap().unwrap().status(), 201);
+        assert_eq!(seen.load(Ordering::Relaxed), 1);
+
+        drop(tx);
+        dispatcher.await.unwrap().unwrap();
+    }
 }
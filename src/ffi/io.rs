@@ -1,10 +1,14 @@
 use std::ffi::c_void;
+use std::io::IoSlice;
 use std::pin::Pin;
-use std::task::{Context, Poll};
+use std::sync::atomic::{AtomicU64, Ordering};
+use std::sync::{Arc, Mutex};
+use std::task::{Context, Poll, Waker};
 
 use libc::size_t;
 use tokio::io::{AsyncRead, AsyncWrite};
 
+use super::client::ConnStats;
 use super::task::hyper_context;
 
 /// Sentinel value to return from a read or write callback that the operation
@@ -18,12 +22,99 @@ type hyper_io_read_callback =
     extern "C" fn(*mut c_void, *mut hyper_context<'_>, *mut u8, size_t) -> size_t;
 type hyper_io_write_callback =
     extern "C" fn(*mut c_void, *mut hyper_context<'_>, *const u8, size_t) -> size_t;
+type hyper_io_write_vectored_callback =
+    extern "C" fn(*mut c_void, *mut hyper_context<'_>, *const hyper_io_slice, size_t) -> size_t;
+type hyper_io_submit_read_callback = extern "C" fn(*mut c_void, *mut u8, size_t);
+type hyper_io_submit_write_callback = extern "C" fn(*mut c_void, *const u8, size_t);
+
+/// The most slices passed to a single vectored write callback.
+///
+/// This matches the most buffers hyper's HTTP/1 encoder will flush at once.
+const MAX_WRITE_VECTORED_SLICES: usize = 64;
 
 /// An IO object used to represent a socket or similar concept.
 pub struct hyper_io {
     read: hyper_io_read_callback,
     write: hyper_io_write_callback,
+    write_vectored: Option<hyper_io_write_vectored_callback>,
     userdata: *mut c_void,
+    /// Set by a handshake with `hyper_clientconn_options_stats` enabled.
+    stats: Option<Arc<ConnStats>>,
+    completion: Option<Completion>,
+}
+
+/// A handle to report the completion of reads and writes submitted by a
+/// completion-based `hyper_io`.
+pub struct hyper_io_completion {
+    read: Mutex<ReadOp>,
+    write: Mutex<WriteOp>,
+}
+
+struct Completion {
+    submit_read: hyper_io_submit_read_callback,
+    submit_write: hyper_io_submit_write_callback,
+    shared: Arc<hyper_io_completion>,
+}
+
+/// The buffer is owned by hyper, but lent to C while an operation is
+/// submitted, so it is never resized.
+struct ReadOp {
+    buf: Box<[u8]>,
+    state: ReadState,
+    waker: Option<Waker>,
+}
+
+enum ReadState {
+    Idle,
+    Submitted,
+    /// The bytes in `buf[pos..end]` haven't been read by hyper yet.
+    Filled {
+        pos: usize,
+        end: usize,
+    },
+    Failed,
+}
+
+struct WriteOp {
+    buf: Box<[u8]>,
+    state: WriteState,
+    waker: Option<Waker>,
+}
+
+enum WriteState {
+    Idle,
+    /// `buf[pos..end]` has been submitted and not completed yet.
+    Submitted {
+        pos: usize,
+        end: usize,
+    },
+    /// Only part of a write completed, so the rest must be submitted again.
+    Partial {
+        pos: usize,
+        end: usize,
+    },
+    Failed,
+}
+
+/// Counters of the calls made to a read or write callback.
+#[derive(Default)]
+pub(super) struct IoCounters {
+    pub(super) calls: AtomicU64,
+    pub(super) pending: AtomicU64,
+    pub(super) bytes: AtomicU64,
+}
+
+/// A borrowed slice of bytes passed to a vectored write callback.
+///
+/// This has the same fields as a POSIX `struct iovec`, but the order and
+/// layout are not guaranteed to match it.
+#[repr(C)]
+#[derive(Clone, Copy)]
+pub struct hyper_io_slice {
+    /// A pointer to the bytes of this slice.
+    pub buf: *const u8,
+    /// The number of bytes in this slice.
+    pub len: size_t,
 }
 
 ffi_fn! {
@@ -35,7 +126,10 @@ ffi_fn! {
         Box::into_raw(Box::new(hyper_io {
             read: read_noop,
             write: write_noop,
+            write_vectored: None,
             userdata: std::ptr::null_mut(),
+            stats: None,
+            completion: None,
         }))
     } ?= std::ptr::null_mut()
 }
@@ -100,6 +194,139 @@ ffi_fn! {
     }
 }
 
+ffi_fn! {
+    /// Set the vectored write function for this IO transport.
+    ///
+    /// The `bufs` pointer is an array of `bufs_len` slices, which should be
+    /// written to the transport in order, as a single `writev` or `sendmsg`
+    /// would. The total number of bytes written should be the return value,
+    /// which may be less than the sum of all the slices.
+    ///
+    /// Setting a vectored write function tells hyper the transport supports
+    /// vectored writes, so it will keep headers and body buffers separate
+    /// instead of copying them into one buffer. The regular write function is
+    /// still used when hyper only has a single buffer to write.
+    ///
+    /// This must be set before the IO is passed to `hyper_clientconn_handshake()`.
+    ///
+    /// The waker and return value rules are the same as for the function set
+    /// with `hyper_io_set_write`.
+    fn hyper_io_set_write_vectored(io: *mut hyper_io, func: hyper_io_write_vectored_callback) {
+        unsafe { &mut *io }.write_vectored = Some(func);
+    }
+}
+
+ffi_fn! {
+    /// Make this IO transport completion-based, instead of readiness-based.
+    ///
+    /// Instead of trying a read or write right away, hyper calls
+    /// `submit_read` with a buffer it owns to read into, or `submit_write`
+    /// with a buffer of bytes to write, and the callback only queues the
+    /// operation, such as by preparing an io_uring submission. Once it has
+    /// completed, report it on the returned `hyper_io_completion *` with
+    /// `hyper_io_completion_read_done` or `hyper_io_completion_write_done`,
+    /// which wakes the connection's task. Only one read and one write are
+    /// submitted at a time, and their buffers hold `buf_size` bytes.
+    ///
+    /// The buffers stay valid until the operation is reported done, even if
+    /// the connection is closed in the meantime. The read and write functions
+    /// of this IO are not used anymore.
+    ///
+    /// The returned handle must be freed with `hyper_io_completion_free`, and
+    /// this must be set before the IO is passed to hyper. Returns `NULL` if
+    /// `buf_size` is `0`.
+    fn hyper_io_set_completion(io: *mut hyper_io, submit_read: hyper_io_submit_read_callback, submit_write: hyper_io_submit_write_callback, buf_size: size_t) -> *mut hyper_io_completion {
+        if io.is_null() || buf_size == 0 {
+            return std::ptr::null_mut();
+        }
+
+        let shared = Arc::new(hyper_io_completion {
+            read: Mutex::new(ReadOp {
+                buf: vec![0; buf_size].into_boxed_slice(),
+                state: ReadState::Idle,
+                waker: None,
+            }),
+            write: Mutex::new(WriteOp {
+                buf: vec![0; buf_size].into_boxed_slice(),
+                state: WriteState::Idle,
+                waker: None,
+            }),
+        });
+        unsafe { &mut *io }.completion = Some(Completion {
+            submit_read,
+            submit_write,
+            shared: shared.clone(),
+        });
+        Arc::into_raw(shared) as *mut hyper_io_completion
+    } ?= std::ptr::null_mut()
+}
+
+// ===== impl hyper_io_completion =====
+
+ffi_fn! {
+    /// Report that the submitted read completed.
+    ///
+    /// The `result` is the number of bytes read into the buffer, `0` if the
+    /// transport reached EOF, or `HYPER_IO_ERROR` if the read failed.
+    fn hyper_io_completion_read_done(completion: *const hyper_io_completion, result: size_t) {
+        let waker = {
+            let mut op = unsafe { &*completion }.read.lock().unwrap();
+            if let ReadState::Submitted = op.state {
+                op.state = if result == HYPER_IO_ERROR || result > op.buf.len() {
+                    ReadState::Failed
+                } else {
+                    ReadState::Filled {
+                        pos: 0,
+                        end: result,
+                    }
+                };
+            }
+            op.waker.take()
+        };
+        if let Some(waker) = waker {
+            waker.wake();
+        }
+    }
+}
+
+ffi_fn! {
+    /// Report that the submitted write completed.
+    ///
+    /// The `result` is the number of bytes written, which may be less than
+    /// were submitted, in which case hyper submits the rest again, or
+    /// `HYPER_IO_ERROR` if the write failed.
+    fn hyper_io_completion_write_done(completion: *const hyper_io_completion, result: size_t) {
+        let waker = {
+            let mut op = unsafe { &*completion }.write.lock().unwrap();
+            if let WriteState::Submitted { pos, end } = op.state {
+                op.state = if result == HYPER_IO_ERROR || result == 0 || result > end - pos {
+                    WriteState::Failed
+                } else if pos + result == end {
+                    WriteState::Idle
+                } else {
+                    WriteState::Partial {
+                        pos: pos + result,
+                        end,
+                    }
+                };
+            }
+            op.waker.take()
+        };
+        if let Some(waker) = waker {
+            waker.wake();
+        }
+    }
+}
+
+ffi_fn! {
+    /// Free a `hyper_io_completion *`.
+    ///
+    /// This must not be called while a read or write is still submitted.
+    fn hyper_io_completion_free(completion: *mut hyper_io_completion) {
+        drop(unsafe { Arc::from_raw(completion) });
+    }
+}
+
 /// cbindgen:ignore
 extern "C" fn read_noop(
     _userdata: *mut c_void,
@@ -126,10 +353,20 @@ impl AsyncRead for hyper_io {
         cx: &mut Context<'_>,
         buf: &mut tokio::io::ReadBuf<'_>,
     ) -> Poll<std::io::Result<()>> {
+        if let Some(ref completion) = self.completion {
+            let stats = self.stats.as_ref().map(|stats| &stats.read);
+            return completion.poll_read(self.userdata, stats, cx, buf);
+        }
+
         let buf_ptr = unsafe { buf.unfilled_mut() }.as_mut_ptr() as *mut u8;
         let buf_len = buf.remaining();
 
-        match (self.read)(self.userdata, hyper_context::wrap(cx), buf_ptr, buf_len) {
+        let ret = (self.read)(self.userdata, hyper_context::wrap(cx), buf_ptr, buf_len);
+        if let Some(ref stats) = self.stats {
+            stats.read.record(ret);
+        }
+
+        match ret {
             HYPER_IO_PENDING => Poll::Pending,
             HYPER_IO_ERROR => Poll::Ready(Err(std::io::Error::new(
                 std::io::ErrorKind::Other,
@@ -152,10 +389,72 @@ impl AsyncWrite for hyper_io {
         cx: &mut Context<'_>,
         buf: &[u8],
     ) -> Poll<std::io::Result<usize>> {
+        if let Some(ref completion) = self.completion {
+            let stats = self.stats.as_ref().map(|stats| &stats.write);
+            return completion.poll_write(self.userdata, stats, cx, &[IoSlice::new(buf)]);
+        }
+
         let buf_ptr = buf.as_ptr();
         let buf_len = buf.len();
 
-        match (self.write)(self.userdata, hyper_context::wrap(cx), buf_ptr, buf_len) {
+        let ret = (self.write)(self.userdata, hyper_context::wrap(cx), buf_ptr, buf_len);
+        if let Some(ref stats) = self.stats {
+            stats.write.record(ret);
+        }
+
+        match ret {
+            HYPER_IO_PENDING => Poll::Pending,
+            HYPER_IO_ERROR => Poll::Ready(Err(std::io::Error::new(
+                std::io::ErrorKind::Other,
+                "io error",
+            ))),
+            ok => Poll::Ready(Ok(ok)),
+        }
+    }
+
+    fn poll_write_vectored(
+        self: Pin<&mut Self>,
+        cx: &mut Context<'_>,
+        bufs: &[IoSlice<'_>],
+    ) -> Poll<std::io::Result<usize>> {
+        if let Some(ref completion) = self.completion {
+            let stats = self.stats.as_ref().map(|stats| &stats.write);
+            return completion.poll_write(self.userdata, stats, cx, bufs);
+        }
+
+        let write_vectored = match self.write_vectored.filter(|_| bufs.len() > 1) {
+            Some(func) => func,
+            None => {
+                let buf = bufs
+                    .iter()
+                    .find(|b| !b.is_empty())
+                    .map_or(&[][..], |b| &**b);
+                return self.poll_write(cx, buf);
+            }
+        };
+
+        let mut slices = [hyper_io_slice {
+            buf: std::ptr::null(),
+            len: 0,
+        }; MAX_WRITE_VECTORED_SLICES];
+        let mut n = 0;
+        for buf in bufs.iter().filter(|b| !b.is_empty()) {
+            if n == MAX_WRITE_VECTORED_SLICES {
+                break;
+            }
+            slices[n] = hyper_io_slice {
+                buf: buf.as_ptr(),
+                len: buf.len(),
+            };
+            n += 1;
+        }
+
+        let ret = write_vectored(self.userdata, hyper_context::wrap(cx), slices.as_ptr(), n);
+        if let Some(ref stats) = self.stats {
+            stats.write.record(ret);
+        }
+
+        match ret {
             HYPER_IO_PENDING => Poll::Pending,
             HYPER_IO_ERROR => Poll::Ready(Err(std::io::Error::new(
                 std::io::ErrorKind::Other,
@@ -165,14 +464,333 @@ impl AsyncWrite for hyper_io {
         }
     }
 
-    fn poll_flush(self: Pin<&mut Self>, _: &mut Context<'_>) -> Poll<std::io::Result<()>> {
-        Poll::Ready(Ok(()))
+    fn is_write_vectored(&self) -> bool {
+        // Completion writes copy into their own buffer anyway, so they can
+        // gather several buffers at once.
+        self.write_vectored.is_some() || self.completion.is_some()
+    }
+
+    fn poll_flush(self: Pin<&mut Self>, cx: &mut Context<'_>) -> Poll<std::io::Result<()>> {
+        match self.completion {
+            Some(ref completion) => {
+                let stats = self.stats.as_ref().map(|stats| &stats.write);
+                completion.poll_write_idle(self.userdata, stats, cx)
+            }
+            None => Poll::Ready(Ok(())),
+        }
     }
 
-    fn poll_shutdown(self: Pin<&mut Self>, _: &mut Context<'_>) -> Poll<std::io::Result<()>> {
-        Poll::Ready(Ok(()))
+    fn poll_shutdown(self: Pin<&mut Self>, cx: &mut Context<'_>) -> Poll<std::io::Result<()>> {
+        self.poll_flush(cx)
     }
 }
 
 unsafe impl Send for hyper_io {}
 unsafe impl Sync for hyper_io {}
+
+impl hyper_io {
+    pub(super) fn set_stats(&mut self, stats: Arc<ConnStats>) {
+        self.stats = Some(stats);
+    }
+}
+
+// ===== impl Completion =====
+
+impl Completion {
+    fn poll_read(
+        &self,
+        userdata: *mut c_void,
+        stats: Option<&IoCounters>,
+        cx: &mut Context<'_>,
+        buf: &mut tokio::io::ReadBuf<'_>,
+    ) -> Poll<std::io::Result<()>> {
+        let mut op = self.shared.read.lock().unwrap();
+        match op.state {
+            ReadState::Idle => {
+                op.state = ReadState::Submitted;
+                set_waker(&mut op.waker, cx);
+                let (ptr, len) = (op.buf.as_mut_ptr(), op.buf.len());
+                // The callback may complete the read right away.
+                drop(op);
+                (self.submit_read)(userdata, ptr, len);
+                if let Some(stats) = stats {
+                    let op = self.shared.read.lock().unwrap();
+                    stats.record_submit(matches!(op.state, ReadState::Submitted));
+                }
+                Poll::Pending
+            }
+            ReadState::Submitted => {
+                set_waker(&mut op.waker, cx);
+                Poll::Pending
+            }
+            ReadState::Filled { pos, end } => {
+                let n = std::cmp::min(end - pos, buf.remaining());
+                buf.put_slice(&op.buf[pos..pos + n]);
+                if let Some(stats) = stats {
+                    stats.bytes.fetch_add(n as u64, Ordering::Relaxed);
+                }
+                op.state = if pos + n == end {
+                    ReadState::Idle
+                } else {
+                    ReadState::Filled { pos: pos + n, end }
+                };
+                Poll::Ready(Ok(()))
+            }
+            ReadState::Failed => {
+                op.state = ReadState::Idle;
+                Poll::Ready(Err(std::io::Error::new(
+                    std::io::ErrorKind::Other,
+                    "io error",
+                )))
+            }
+        }
+    }
+
+    fn poll_write(
+        &self,
+        userdata: *mut c_void,
+        stats: Option<&IoCounters>,
+        cx: &mut Context<'_>,
+        bufs: &[IoSlice<'_>],
+    ) -> Poll<std::io::Result<usize>> {
+        ready!(self.poll_write_idle(userdata, stats, cx))?;
+
+        let mut op = self.shared.write.lock().unwrap();
+        let mut end = 0;
+        for buf in bufs {
+            let n = std::cmp::min(buf.len(), op.buf.len() - end);
+            op.buf[end..end + n].copy_from_slice(&buf[..n]);
+            end += n;
+            if end == op.buf.len() {
+                break;
+            }
+        }
+        if end == 0 {
+            return Poll::Ready(Ok(0));
+        }
+
+        op.state = WriteState::Submitted { pos: 0, end };
+        let ptr = op.buf.as_ptr();
+        drop(op);
+        (self.submit_write)(userdata, ptr, end);
+        if let Some(stats) = stats {
+            stats.record_submit(self.write_submitted());
+            stats.bytes.fetch_add(end as u64, Ordering::Relaxed);
+        }
+        // The bytes are hyper's own copy now, so they count as written.
+        Poll::Ready(Ok(end))
+    }
+
+    /// Wait for submitted writes to complete, submitting the rest of any
+    /// partial write again.
+    fn poll_write_idle(
+        &self,
+        userdata: *mut c_void,
+        stats: Option<&IoCounters>,
+        cx: &mut Context<'_>,
+    ) -> Poll<std::io::Result<()>> {
+        let mut op = self.shared.write.lock().unwrap();
+        match op.state {
+            WriteState::Idle => Poll::Ready(Ok(())),
+            WriteState::Submitted { .. } => {
+                set_waker(&mut op.waker, cx);
+                Poll::Pending
+            }
+            WriteState::Partial { pos, end } => {
+                op.state = WriteState::Submitted { pos, end };
+                set_waker(&mut op.waker, cx);
+                let ptr = op.buf[pos..].as_ptr();
+                drop(op);
+                (self.submit_write)(userdata, ptr, end - pos);
+                if let Some(stats) = stats {
+                    stats.record_submit(self.write_submitted());
+                }
+                Poll::Pending
+            }
+            WriteState::Failed => {
+                op.state = WriteState::Idle;
+                Poll::Ready(Err(std::io::Error::new(
+                    std::io::ErrorKind::Other,
+                    "io error",
+                )))
+            }
+        }
+    }
+
+    /// Whether the last submitted write is still in progress.
+    fn write_submitted(&self) -> bool {
+        let op = self.shared.write.lock().unwrap();
+        matches!(op.state, WriteState::Submitted { .. })
+    }
+}
+
+fn set_waker(slot: &mut Option<Waker>, cx: &Context<'_>) {
+    if !slot.as_ref().map_or(false, |w| w.will_wake(cx.waker())) {
+        *slot = Some(cx.waker().clone());
+    }
+}
+
+// ===== impl IoCounters =====
+
+impl IoCounters {
+    fn record(&self, ret: size_t) {
+        self.calls.fetch_add(1, Ordering::Relaxed);
+        match ret {
+            HYPER_IO_PENDING => {
+                self.pending.fetch_add(1, Ordering::Relaxed);
+            }
+            HYPER_IO_ERROR => (),
+            n => {
+                self.bytes.fetch_add(n as u64, Ordering::Relaxed);
+            }
+        }
+    }
+
+    /// Count a submission to a completion-based IO as a call, which is
+    /// pending if it was not completed by the time the callback returned.
+    ///
+    /// Its bytes are counted once hyper has them.
+    fn record_submit(&self, in_progress: bool) {
+        self.calls.fetch_add(1, Ordering::Relaxed);
+        if in_progress {
+            self.pending.fetch_add(1, Ordering::Relaxed);
+        }
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_io_stats_count_callbacks() {
+        extern "C" fn read_twice(
+            userdata: *mut c_void,
+            _: *mut hyper_context<'_>,
+            _buf: *mut u8,
+            buf_len: size_t,
+        ) -> size_t {
+            let calls = unsafe { &mut *(userdata as *mut usize) };
+            *calls += 1;
+            if *calls == 1 {
+                HYPER_IO_PENDING
+            } else {
+                buf_len.min(5)
+            }
+        }
+
+        let mut calls = 0usize;
+        let io = hyper_io_new();
+        hyper_io_set_userdata(io, &mut calls as *mut usize as *mut c_void);
+        hyper_io_set_read(io, read_twice);
+        let mut io = unsafe { Box::from_raw(io) };
+        let stats = Arc::new(ConnStats::default());
+        io.set_stats(stats.clone());
+
+        let waker = futures_util::task::noop_waker();
+        let mut cx = Context::from_waker(&waker);
+        let mut buf = [0u8; 16];
+        let mut buf = tokio::io::ReadBuf::new(&mut buf);
+        assert!(Pin::new(&mut *io).poll_read(&mut cx, &mut buf).is_pending());
+        assert!(Pin::new(&mut *io).poll_read(&mut cx, &mut buf).is_ready());
+
+        assert_eq!(stats.read.calls.load(Ordering::Relaxed), 2);
+        assert_eq!(stats.read.pending.load(Ordering::Relaxed), 1);
+        assert_eq!(stats.read.bytes.load(Ordering::Relaxed), 5);
+    }
+
+    #[derive(Default)]
+    struct Submitted {
+        read: Option<(*mut u8, size_t)>,
+        written: Vec<u8>,
+    }
+
+    extern "C" fn submit_read(userdata: *mut c_void, buf: *mut u8, buf_len: size_t) {
+        let submitted = unsafe { &mut *(userdata as *mut Submitted) };
+        submitted.read = Some((buf, buf_len));
+    }
+
+    extern "C" fn submit_write(userdata: *mut c_void, buf: *const u8, buf_len: size_t) {
+        let submitted = unsafe { &mut *(userdata as *mut Submitted) };
+        submitted
+            .written
+            .extend_from_slice(unsafe { std::slice::from_raw_parts(buf, buf_len) });
+    }
+
+    #[test]
+    fn test_completion_read() {
+        let mut submitted = Submitted::default();
+        let io = hyper_io_new();
+        hyper_io_set_userdata(io, &mut submitted as *mut Submitted as *mut c_void);
+        let completion = hyper_io_set_completion(io, submit_read, submit_write, 8);
+        let mut io = unsafe { Box::from_raw(io) };
+        let stats = Arc::new(ConnStats::default());
+        io.set_stats(stats.clone());
+
+        let waker = futures_util::task::noop_waker();
+        let mut cx = Context::from_waker(&waker);
+        let mut dst = [0u8; 4];
+
+        // The first poll only submits the read.
+        let mut buf = tokio::io::ReadBuf::new(&mut dst);
+        assert!(Pin::new(&mut *io).poll_read(&mut cx, &mut buf).is_pending());
+        let (ptr, len) = submitted.read.take().expect("submitted");
+        assert_eq!(len, 8);
+
+        unsafe { ptr.copy_from(b"hyper!".as_ptr(), 6) };
+        hyper_io_completion_read_done(completion, 6);
+
+        // Bytes that don't fit are kept for the next read.
+        assert!(Pin::new(&mut *io).poll_read(&mut cx, &mut buf).is_ready());
+        assert_eq!(buf.filled(), b"hype");
+        let mut buf = tokio::io::ReadBuf::new(&mut dst);
+        assert!(Pin::new(&mut *io).poll_read(&mut cx, &mut buf).is_ready());
+        assert_eq!(buf.filled(), b"r!");
+        assert!(submitted.read.is_none());
+
+        // Each submission counts as a call, and the bytes once read.
+        assert_eq!(stats.read.calls.load(Ordering::Relaxed), 1);
+        assert_eq!(stats.read.pending.load(Ordering::Relaxed), 1);
+        assert_eq!(stats.read.bytes.load(Ordering::Relaxed), 6);
+
+        drop(io);
+        hyper_io_completion_free(completion);
+    }
+
+    #[test]
+    fn test_completion_partial_write() {
+        let mut submitted = Submitted::default();
+        let io = hyper_io_new();
+        hyper_io_set_userdata(io, &mut submitted as *mut Submitted as *mut c_void);
+        let completion = hyper_io_set_completion(io, submit_read, submit_write, 8);
+        let mut io = unsafe { Box::from_raw(io) };
+        let stats = Arc::new(ConnStats::default());
+        io.set_stats(stats.clone());
+
+        let waker = futures_util::task::noop_waker();
+        let mut cx = Context::from_waker(&waker);
+
+        let bufs = [IoSlice::new(b"hello "), IoSlice::new(b"world")];
+        match Pin::new(&mut *io).poll_write_vectored(&mut cx, &bufs) {
+            Poll::Ready(Ok(n)) => assert_eq!(n, 8),
+            other => panic!("unexpected poll_write: {:?}", other),
+        }
+        assert_eq!(submitted.written, b"hello wo");
+
+        // Anything not written is submitted again when flushing.
+        assert!(Pin::new(&mut *io).poll_flush(&mut cx).is_pending());
+        hyper_io_completion_write_done(completion, 5);
+        assert!(Pin::new(&mut *io).poll_flush(&mut cx).is_pending());
+        assert_eq!(submitted.written, b"hello wo wo");
+        hyper_io_completion_write_done(completion, 3);
+        assert!(Pin::new(&mut *io).poll_flush(&mut cx).is_ready());
+
+        // Resubmitting the rest counts as another call, but not more bytes.
+        assert_eq!(stats.write.calls.load(Ordering::Relaxed), 2);
+        assert_eq!(stats.write.pending.load(Ordering::Relaxed), 2);
+        assert_eq!(stats.write.bytes.load(Ordering::Relaxed), 8);
+
+        drop(io);
+        hyper_io_completion_free(completion);
+    }
+}
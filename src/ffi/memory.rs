@@ -0,0 +1,311 @@
+use std::sync::atomic::{AtomicBool, AtomicU64, AtomicUsize, Ordering};
+use std::sync::Arc;
+
+use libc::size_t;
+
+use super::error::hyper_code;
+use crate::HeaderMap;
+
+/// A memory budget that client connections account their buffers to.
+///
+/// It counts the HTTP/1 read and write buffers of the connections made with
+/// it, and the headers of their responses that have not been freed yet.
+pub struct hyper_memory(Arc<MemoryBudget>);
+
+/// A snapshot of the memory held by a connection or a budget, in bytes.
+#[repr(C)]
+#[derive(Clone, Copy, Default)]
+pub struct hyper_memory_usage {
+    /// The capacity of the HTTP/1 read buffers.
+    pub read_buf: size_t,
+    /// The bytes waiting in the HTTP/1 write buffers, and the capacity of
+    /// the buffers message heads are written into.
+    pub write_buf: size_t,
+    /// The names and values of the headers of received responses that have
+    /// not been freed yet.
+    pub headers: size_t,
+    /// How many times a buffer was kept from growing because the budget's
+    /// limit was reached.
+    pub limited: u64,
+}
+
+#[derive(Debug)]
+pub(crate) struct MemoryBudget {
+    /// The most bytes that may be held at once, or `0` for no limit.
+    limit: usize,
+    usage: Usage,
+    limited: AtomicU64,
+}
+
+#[derive(Debug, Default)]
+struct Usage {
+    read_buf: AtomicUsize,
+    write_buf: AtomicUsize,
+    headers: AtomicUsize,
+}
+
+/// The memory held by one connection, which also counts towards its budget.
+#[derive(Debug)]
+pub(crate) struct ConnMemory {
+    usage: Usage,
+    budget: Arc<MemoryBudget>,
+}
+
+/// The buffer sizes a connection last reported to its `ConnMemory`.
+///
+/// Only changes are passed on, so reporting the same sizes again is cheap.
+pub(crate) struct BufferGauge {
+    conn: Arc<ConnMemory>,
+    read_buf: usize,
+    write_buf: usize,
+    /// Whether writes are being held back, so that is only counted once.
+    holding_writes: AtomicBool,
+}
+
+/// The headers of a response, counted until the response is freed.
+pub(crate) struct HeadersCharge {
+    conn: Arc<ConnMemory>,
+    bytes: usize,
+}
+
+// ===== impl hyper_memory =====
+
+ffi_fn! {
+    /// Create a memory budget, to be shared by client connections with
+    /// `hyper_clientconn_options_memory`.
+    ///
+    /// Once the connections hold `limit` bytes in total, their buffers stop
+    /// growing. A request body is then only polled once what was buffered of
+    /// it has been written, and a read that needs a bigger buffer fails the
+    /// connection. Pass `0` to only count, without a limit.
+    fn hyper_memory_new(limit: size_t) -> *mut hyper_memory {
+        Box::into_raw(Box::new(hyper_memory(Arc::new(MemoryBudget {
+            limit,
+            usage: Usage::default(),
+            limited: AtomicU64::new(0),
+        }))))
+    } ?= std::ptr::null_mut()
+}
+
+ffi_fn! {
+    /// Free a `hyper_memory *`.
+    ///
+    /// Connections made with it keep accounting to it until they are closed.
+    fn hyper_memory_free(memory: *mut hyper_memory) {
+        drop(unsafe { Box::from_raw(memory) });
+    }
+}
+
+ffi_fn! {
+    /// Copy the memory held by all connections of this budget into `usage`.
+    fn hyper_memory_get_usage(memory: *const hyper_memory, usage: *mut hyper_memory_usage) -> hyper_code {
+        if memory.is_null() || usage.is_null() {
+            return hyper_code::HYPERE_INVALID_ARG;
+        }
+        let budget = &unsafe { &*memory }.0;
+
+        let mut snapshot = budget.usage.snapshot();
+        snapshot.limited = budget.limited.load(Ordering::Relaxed);
+        unsafe { *usage = snapshot };
+        hyper_code::HYPERE_OK
+    }
+}
+
+impl hyper_memory {
+    pub(crate) fn budget(&self) -> Arc<MemoryBudget> {
+        self.0.clone()
+    }
+}
+
+// ===== impl MemoryBudget =====
+
+impl MemoryBudget {
+    /// Whether `more` bytes fit in the limit, counting it if they don't.
+    fn allows(&self, more: usize) -> bool {
+        if self.over_limit(more) {
+            self.limited.fetch_add(1, Ordering::Relaxed);
+            return false;
+        }
+        true
+    }
+
+    /// Whether `more` bytes would not fit in the limit, without counting it.
+    fn over_limit(&self, more: usize) -> bool {
+        self.limit != 0 && self.usage.total().saturating_add(more) > self.limit
+    }
+}
+
+// ===== impl Usage =====
+
+impl Usage {
+    fn total(&self) -> usize {
+        self.read_buf.load(Ordering::Relaxed)
+            + self.write_buf.load(Ordering::Relaxed)
+            + self.headers.load(Ordering::Relaxed)
+    }
+
+    fn snapshot(&self) -> hyper_memory_usage {
+        hyper_memory_usage {
+            read_buf: self.read_buf.load(Ordering::Relaxed),
+            write_buf: self.write_buf.load(Ordering::Relaxed),
+            headers: self.headers.load(Ordering::Relaxed),
+            limited: 0,
+        }
+    }
+}
+
+fn update(counter: &AtomicUsize, old: usize, new: usize) {
+    if new > old {
+        counter.fetch_add(new - old, Ordering::Relaxed);
+    } else {
+        counter.fetch_sub(old - new, Ordering::Relaxed);
+    }
+}
+
+// ===== impl ConnMemory =====
+
+impl ConnMemory {
+    pub(crate) fn new(budget: Arc<MemoryBudget>) -> Arc<ConnMemory> {
+        Arc::new(ConnMemory {
+            usage: Usage::default(),
+            budget,
+        })
+    }
+
+    pub(crate) fn snapshot(&self) -> hyper_memory_usage {
+        self.usage.snapshot()
+    }
+
+    fn update<F>(&self, field: F, old: usize, new: usize)
+    where
+        F: Fn(&Usage) -> &AtomicUsize,
+    {
+        update(field(&self.usage), old, new);
+        update(field(&self.budget.usage), old, new);
+    }
+}
+
+// ===== impl BufferGauge =====
+
+impl BufferGauge {
+    pub(crate) fn new(conn: Arc<ConnMemory>) -> BufferGauge {
+        BufferGauge {
+            conn,
+            read_buf: 0,
+            write_buf: 0,
+            holding_writes: AtomicBool::new(false),
+        }
+    }
+
+    pub(crate) fn report(&mut self, read_buf: usize, write_buf: usize) {
+        if read_buf != self.read_buf {
+            self.conn.update(|u| &u.read_buf, self.read_buf, read_buf);
+            self.read_buf = read_buf;
+        }
+        if write_buf != self.write_buf {
+            self.conn
+                .update(|u| &u.write_buf, self.write_buf, write_buf);
+            self.write_buf = write_buf;
+        }
+    }
+
+    /// Whether a buffer may grow by `more` bytes.
+    pub(crate) fn allows(&self, more: usize) -> bool {
+        self.conn.budget.allows(more)
+    }
+
+    /// Whether nothing more should be buffered for writing, because the
+    /// budget is used up.
+    ///
+    /// This is asked on every poll, so holding writes back is only counted
+    /// once, until the budget has room again.
+    pub(crate) fn holds_writes(&self) -> bool {
+        let over = self.conn.budget.over_limit(0);
+        if !over {
+            self.holding_writes.store(false, Ordering::Relaxed);
+        } else if !self.holding_writes.swap(true, Ordering::Relaxed) {
+            self.conn.budget.limited.fetch_add(1, Ordering::Relaxed);
+        }
+        over
+    }
+}
+
+impl Drop for BufferGauge {
+    fn drop(&mut self) {
+        self.report(0, 0);
+    }
+}
+
+// ===== impl HeadersCharge =====
+
+impl HeadersCharge {
+    pub(super) fn new(conn: Arc<ConnMemory>, headers: &HeaderMap) -> HeadersCharge {
+        let bytes = headers
+            .iter()
+            .map(|(name, value)| name.as_str().len() + value.len())
+            .sum();
+        conn.update(|u| &u.headers, 0, bytes);
+        HeadersCharge { conn, bytes }
+    }
+}
+
+impl Drop for HeadersCharge {
+    fn drop(&mut self) {
+        self.conn.update(|u| &u.headers, self.bytes, 0);
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_memory_accounts_connections_to_budget() {
+        let memory = hyper_memory_new(50_000);
+        let first = ConnMemory::new(unsafe { &*memory }.budget());
+        let second = ConnMemory::new(unsafe { &*memory }.budget());
+
+        let mut gauge = BufferGauge::new(first.clone());
+        gauge.report(16_384, 8_192);
+        let mut other = BufferGauge::new(second.clone());
+        other.report(8_192, 0);
+
+        let mut headers = HeaderMap::new();
+        headers.insert("content-type", "text/plain".parse().unwrap());
+        let charge = HeadersCharge::new(second.clone(), &headers);
+
+        assert_eq!(first.snapshot().read_buf, 16_384);
+        assert_eq!(second.snapshot().headers, 22);
+
+        let mut usage = hyper_memory_usage::default();
+        assert!(matches!(
+            hyper_memory_get_usage(memory, &mut usage),
+            hyper_code::HYPERE_OK
+        ));
+        assert_eq!(usage.read_buf, 24_576);
+        assert_eq!(usage.write_buf, 8_192);
+        assert_eq!(usage.headers, 22);
+
+        // Growing past the limit is refused, and counted.
+        assert!(gauge.allows(16_000));
+        assert!(!gauge.allows(20_000));
+
+        // Holding writes back is counted once, however often it is asked.
+        other.report(8_192, 20_000);
+        assert!(gauge.holds_writes());
+        assert!(gauge.holds_writes());
+        other.report(8_192, 0);
+        assert!(!gauge.holds_writes());
+
+        gauge.report(8_192, 0);
+        drop(other);
+        drop(charge);
+        hyper_memory_get_usage(memory, &mut usage);
+        assert_eq!(usage.read_buf, 8_192);
+        assert_eq!(usage.write_buf, 0);
+        assert_eq!(usage.headers, 0);
+        assert_eq!(usage.limited, 2);
+
+        hyper_memory_free(memory);
+    }
+}
@@ -27,6 +27,8 @@
 //! ```notrust
 //! RUSTFLAGS="--cfg hyper_unstable_ffi" cargo build --features client,http1,http2,ffi
 //! ```
+//!
+//! Add the `server` feature to also build the `hyper_serverconn` functions.
 
 // We may eventually allow the FFI to be enabled without `client` or `http1`,
 // that is why we don't auto enable them as `ffi = ["client", "http1"]` in
@@ -49,16 +51,27 @@ mod macros;
 
 mod body;
 mod client;
+mod codec;
 mod error;
 mod http_types;
 mod io;
+mod memory;
+mod reactor;
+mod recycle;
+#[cfg(feature = "server")]
+mod server;
 mod task;
 
 pub use self::body::*;
 pub use self::client::*;
+pub use self::codec::*;
 pub use self::error::*;
 pub use self::http_types::*;
 pub use self::io::*;
+pub use self::memory::*;
+pub use self::reactor::*;
+#[cfg(feature = "server")]
+pub use self::server::*;
 pub use self::task::*;
 
 /// Return in iter functions to continue iterating.
@@ -0,0 +1,525 @@
+use std::collections::HashMap;
+use std::ptr;
+use std::task::Waker;
+
+use libc::c_int;
+
+use super::error::hyper_code;
+use super::task::hyper_context;
+
+/// The most readiness events collected from the OS in one call to
+/// `hyper_reactor_run_once()`.
+const MAX_EVENTS: usize = 256;
+
+/// An IO reactor that waits for readiness of file descriptors, and wakes the
+/// tasks waiting on them.
+///
+/// This uses `epoll` on Linux and `kqueue` on BSD and macOS.
+pub struct hyper_reactor {
+    poller: sys::Poller,
+    sources: HashMap<c_int, Source>,
+}
+
+#[derive(Default)]
+struct Source {
+    read_waker: Option<Waker>,
+    write_waker: Option<Waker>,
+}
+
+struct Event {
+    fd: c_int,
+    readable: bool,
+    writable: bool,
+}
+
+// ===== impl hyper_reactor =====
+
+impl hyper_reactor {
+    fn run_once(&mut self, timeout_ms: c_int) -> std::io::Result<usize> {
+        let sources = &mut self.sources;
+        let mut woken = 0;
+
+        self.poller.wait(timeout_ms, |event| {
+            let source = match sources.get_mut(&event.fd) {
+                Some(source) => source,
+                // Deregistered since the event was queued.
+                None => return,
+            };
+
+            if event.readable {
+                if let Some(waker) = source.read_waker.take() {
+                    waker.wake();
+                    woken += 1;
+                }
+            }
+            if event.writable {
+                if let Some(waker) = source.write_waker.take() {
+                    waker.wake();
+                    woken += 1;
+                }
+            }
+        })?;
+
+        Ok(woken)
+    }
+
+    fn want(&mut self, fd: c_int, cx: *mut hyper_context<'_>, write: bool) -> hyper_code {
+        if cx.is_null() {
+            return hyper_code::HYPERE_INVALID_ARG;
+        }
+        let waker = unsafe { &*cx }.waker();
+
+        let source = match self.sources.get_mut(&fd) {
+            Some(source) => source,
+            None => return hyper_code::HYPERE_INVALID_ARG,
+        };
+        let slot = if write {
+            &mut source.write_waker
+        } else {
+            &mut source.read_waker
+        };
+
+        // Skip the clone if the same task is already waiting.
+        if !slot.as_ref().map_or(false, |w| w.will_wake(waker)) {
+            *slot = Some(waker.clone());
+        }
+
+        hyper_code::HYPERE_OK
+    }
+}
+
+ffi_fn! {
+    /// Creates a new IO reactor.
+    ///
+    /// Returns `NULL` if the reactor could not be created, such as when the
+    /// platform has neither `epoll` nor `kqueue`.
+    fn hyper_reactor_new() -> *mut hyper_reactor {
+        match sys::Poller::new() {
+            Ok(poller) => Box::into_raw(Box::new(hyper_reactor {
+                poller,
+                sources: HashMap::new(),
+            })),
+            Err(_) => ptr::null_mut(),
+        }
+    } ?= ptr::null_mut()
+}
+
+ffi_fn! {
+    /// Frees a reactor.
+    ///
+    /// Any wakers still registered are dropped without being woken. This does
+    /// not close any of the registered file descriptors.
+    fn hyper_reactor_free(reactor: *mut hyper_reactor) {
+        if reactor.is_null() {
+            return;
+        }
+
+        drop(unsafe { Box::from_raw(reactor) });
+    }
+}
+
+ffi_fn! {
+    /// Register a file descriptor with the reactor.
+    ///
+    /// The file descriptor should be in non-blocking mode. It is watched for
+    /// both read and write readiness until it is deregistered.
+    fn hyper_reactor_register_fd(reactor: *mut hyper_reactor, fd: c_int) -> hyper_code {
+        if reactor.is_null() || fd < 0 {
+            return hyper_code::HYPERE_INVALID_ARG;
+        }
+        let reactor = unsafe { &mut *reactor };
+
+        if reactor.sources.contains_key(&fd) {
+            return hyper_code::HYPERE_INVALID_ARG;
+        }
+        if reactor.poller.add(fd).is_err() {
+            return hyper_code::HYPERE_ERROR;
+        }
+        reactor.sources.insert(fd, Source::default());
+        hyper_code::HYPERE_OK
+    }
+}
+
+ffi_fn! {
+    /// Deregister a file descriptor from the reactor.
+    ///
+    /// This must be called before the file descriptor is closed. Any wakers
+    /// waiting on it are dropped without being woken.
+    fn hyper_reactor_deregister_fd(reactor: *mut hyper_reactor, fd: c_int) -> hyper_code {
+        if reactor.is_null() {
+            return hyper_code::HYPERE_INVALID_ARG;
+        }
+        let reactor = unsafe { &mut *reactor };
+
+        if reactor.sources.remove(&fd).is_none() {
+            return hyper_code::HYPERE_INVALID_ARG;
+        }
+        let _ = reactor.poller.delete(fd);
+        hyper_code::HYPERE_OK
+    }
+}
+
+ffi_fn! {
+    /// Register interest in the file descriptor becoming readable.
+    ///
+    /// This should be called from a `hyper_io` read callback when the read
+    /// would block, right before returning `HYPER_IO_PENDING`. The reactor
+    /// keeps the waker from `ctx`, and wakes it once the file descriptor is
+    /// readable again.
+    fn hyper_reactor_want_read(reactor: *mut hyper_reactor, fd: c_int, ctx: *mut hyper_context<'_>) -> hyper_code {
+        if reactor.is_null() {
+            return hyper_code::HYPERE_INVALID_ARG;
+        }
+        unsafe { &mut *reactor }.want(fd, ctx, false)
+    }
+}
+
+ffi_fn! {
+    /// Register interest in the file descriptor becoming writable.
+    ///
+    /// This should be called from a `hyper_io` write callback when the write
+    /// would block, right before returning `HYPER_IO_PENDING`. The reactor
+    /// keeps the waker from `ctx`, and wakes it once the file descriptor is
+    /// writable again.
+    fn hyper_reactor_want_write(reactor: *mut hyper_reactor, fd: c_int, ctx: *mut hyper_context<'_>) -> hyper_code {
+        if reactor.is_null() {
+            return hyper_code::HYPERE_INVALID_ARG;
+        }
+        unsafe { &mut *reactor }.want(fd, ctx, true)
+    }
+}
+
+ffi_fn! {
+    /// Wait for readiness events, and wake the tasks waiting on them.
+    ///
+    /// This blocks for up to `timeout_ms` milliseconds, or forever if it is
+    /// negative. It should be called once `hyper_executor_poll()` returns
+    /// `NULL`, and the executor polled again after it returns.
+    ///
+    /// The return value is the number of wakers that were woken, or `-1` if
+    /// waiting failed.
+    fn hyper_reactor_run_once(reactor: *mut hyper_reactor, timeout_ms: c_int) -> c_int {
+        if reactor.is_null() {
+            return -1;
+        }
+
+        match unsafe { &mut *reactor }.run_once(timeout_ms) {
+            Ok(woken) => woken as c_int,
+            Err(_) => -1,
+        }
+    } ?= -1
+}
+
+// ===== impl Poller =====
+
+#[cfg(any(target_os = "linux", target_os = "android"))]
+mod sys {
+    use std::io;
+
+    use libc::c_int;
+
+    use super::{Event, MAX_EVENTS};
+
+    pub(super) struct Poller {
+        epfd: c_int,
+    }
+
+    impl Poller {
+        pub(super) fn new() -> io::Result<Poller> {
+            let epfd = unsafe { libc::epoll_create1(libc::EPOLL_CLOEXEC) };
+            if epfd < 0 {
+                return Err(io::Error::last_os_error());
+            }
+            Ok(Poller { epfd })
+        }
+
+        pub(super) fn add(&self, fd: c_int) -> io::Result<()> {
+            // Edge-triggered, so a waker only needs to be registered after
+            // the transport has returned `EAGAIN`.
+            let mut event = libc::epoll_event {
+                events: (libc::EPOLLIN | libc::EPOLLOUT | libc::EPOLLRDHUP | libc::EPOLLET) as u32,
+                u64: fd as u64,
+            };
+            let ret = unsafe { libc::epoll_ctl(self.epfd, libc::EPOLL_CTL_ADD, fd, &mut event) };
+            if ret < 0 {
+                return Err(io::Error::last_os_error());
+            }
+            Ok(())
+        }
+
+        pub(super) fn delete(&self, fd: c_int) -> io::Result<()> {
+            let ret = unsafe {
+                libc::epoll_ctl(self.epfd, libc::EPOLL_CTL_DEL, fd, std::ptr::null_mut())
+            };
+            if ret < 0 {
+                return Err(io::Error::last_os_error());
+            }
+            Ok(())
+        }
+
+        pub(super) fn wait<F>(&self, timeout_ms: c_int, mut f: F) -> io::Result<()>
+        where
+            F: FnMut(Event),
+        {
+            let mut events: [libc::epoll_event; MAX_EVENTS] = unsafe { std::mem::zeroed() };
+            let n = unsafe {
+                libc::epoll_wait(
+                    self.epfd,
+                    events.as_mut_ptr(),
+                    MAX_EVENTS as c_int,
+                    timeout_ms,
+                )
+            };
+            if n < 0 {
+                let err = io::Error::last_os_error();
+                if err.kind() == io::ErrorKind::Interrupted {
+                    return Ok(());
+                }
+                return Err(err);
+            }
+
+            for event in &events[..n as usize] {
+                // `epoll_event` may be packed, so copy the fields out.
+                let flags = event.events as c_int;
+                let fd = event.u64 as c_int;
+                let closed = libc::EPOLLHUP | libc::EPOLLERR;
+                f(Event {
+                    fd,
+                    readable: flags & (libc::EPOLLIN | libc::EPOLLRDHUP | closed) != 0,
+                    writable: flags & (libc::EPOLLOUT | closed) != 0,
+                });
+            }
+            Ok(())
+        }
+    }
+
+    impl Drop for Poller {
+        fn drop(&mut self) {
+            unsafe {
+                libc::close(self.epfd);
+            }
+        }
+    }
+}
+
+#[cfg(any(
+    target_os = "macos",
+    target_os = "ios",
+    target_os = "freebsd",
+    target_os = "netbsd",
+    target_os = "openbsd",
+    target_os = "dragonfly",
+))]
+mod sys {
+    use std::io;
+    use std::ptr;
+
+    use libc::c_int;
+
+    use super::{Event, MAX_EVENTS};
+
+    pub(super) struct Poller {
+        kq: c_int,
+    }
+
+    impl Poller {
+        pub(super) fn new() -> io::Result<Poller> {
+            let kq = unsafe { libc::kqueue() };
+            if kq < 0 {
+                return Err(io::Error::last_os_error());
+            }
+            unsafe {
+                libc::fcntl(kq, libc::F_SETFD, libc::FD_CLOEXEC);
+            }
+            Ok(Poller { kq })
+        }
+
+        pub(super) fn add(&self, fd: c_int) -> io::Result<()> {
+            self.change(fd, true)
+        }
+
+        pub(super) fn delete(&self, fd: c_int) -> io::Result<()> {
+            self.change(fd, false)
+        }
+
+        fn change(&self, fd: c_int, add: bool) -> io::Result<()> {
+            // `EV_CLEAR` makes these edge-triggered, matching epoll's `EPOLLET`.
+            let flags = if add {
+                libc::EV_ADD | libc::EV_CLEAR
+            } else {
+                libc::EV_DELETE
+            };
+
+            let mut changes: [libc::kevent; 2] = unsafe { std::mem::zeroed() };
+            changes[0].ident = fd as _;
+            changes[0].filter = libc::EVFILT_READ;
+            changes[0].flags = flags;
+            changes[1].ident = fd as _;
+            changes[1].filter = libc::EVFILT_WRITE;
+            changes[1].flags = flags;
+
+            let ret = unsafe {
+                libc::kevent(
+                    self.kq,
+                    changes.as_ptr(),
+                    changes.len() as c_int,
+                    ptr::null_mut(),
+                    0,
+                    ptr::null(),
+                )
+            };
+            if ret < 0 {
+                return Err(io::Error::last_os_error());
+            }
+            Ok(())
+        }
+
+        pub(super) fn wait<F>(&self, timeout_ms: c_int, mut f: F) -> io::Result<()>
+        where
+            F: FnMut(Event),
+        {
+            let mut timeout: libc::timespec = unsafe { std::mem::zeroed() };
+            let timeout_ptr = if timeout_ms < 0 {
+                ptr::null()
+            } else {
+                timeout.tv_sec = (timeout_ms / 1000) as _;
+                timeout.tv_nsec = ((timeout_ms % 1000) * 1_000_000) as _;
+                &timeout as *const libc::timespec
+            };
+
+            let mut events: [libc::kevent; MAX_EVENTS] = unsafe { std::mem::zeroed() };
+            let n = unsafe {
+                libc::kevent(
+                    self.kq,
+                    ptr::null(),
+                    0,
+                    events.as_mut_ptr(),
+                    MAX_EVENTS as c_int,
+                    timeout_ptr,
+                )
+            };
+            if n < 0 {
+                let err = io::Error::last_os_error();
+                if err.kind() == io::ErrorKind::Interrupted {
+                    return Ok(());
+                }
+                return Err(err);
+            }
+
+            for event in &events[..n as usize] {
+                f(Event {
+                    fd: event.ident as c_int,
+                    readable: event.filter == libc::EVFILT_READ,
+                    writable: event.filter == libc::EVFILT_WRITE,
+                });
+            }
+            Ok(())
+        }
+    }
+
+    impl Drop for Poller {
+        fn drop(&mut self) {
+            unsafe {
+                libc::close(self.kq);
+            }
+        }
+    }
+}
+
+#[cfg(not(any(
+    target_os = "linux",
+    target_os = "android",
+    target_os = "macos",
+    target_os = "ios",
+    target_os = "freebsd",
+    target_os = "netbsd",
+    target_os = "openbsd",
+    target_os = "dragonfly",
+)))]
+mod sys {
+    use std::io;
+
+    use libc::c_int;
+
+    use super::Event;
+
+    pub(super) struct Poller(());
+
+    impl Poller {
+        pub(super) fn new() -> io::Result<Poller> {
+            Err(io::Error::new(
+                io::ErrorKind::Other,
+                "hyper_reactor is not supported on this platform",
+            ))
+        }
+
+        pub(super) fn add(&self, _fd: c_int) -> io::Result<()> {
+            unreachable!("Poller cannot be constructed")
+        }
+
+        pub(super) fn delete(&self, _fd: c_int) -> io::Result<()> {
+            unreachable!("Poller cannot be constructed")
+        }
+
+        pub(super) fn wait<F>(&self, _timeout_ms: c_int, _f: F) -> io::Result<()>
+        where
+            F: FnMut(Event),
+        {
+            unreachable!("Poller cannot be constructed")
+        }
+    }
+}
+
+#[cfg(all(test, target_os = "linux"))]
+mod tests {
+    use std::sync::atomic::{AtomicUsize, Ordering};
+    use std::sync::Arc;
+    use std::task::Context;
+
+    use super::*;
+
+    struct CountWaker(AtomicUsize);
+
+    impl futures_util::task::ArcWake for CountWaker {
+        fn wake_by_ref(me: &Arc<CountWaker>) {
+            me.0.fetch_add(1, Ordering::SeqCst);
+        }
+    }
+
+    #[test]
+    fn test_reactor_wakes_readable_fd() {
+        let mut fds = [0; 2];
+        assert_eq!(unsafe { libc::pipe(fds.as_mut_ptr()) }, 0);
+        let (rx, tx) = (fds[0], fds[1]);
+
+        let reactor = hyper_reactor_new();
+        assert!(!reactor.is_null());
+        assert!(matches!(
+            hyper_reactor_register_fd(reactor, rx),
+            hyper_code::HYPERE_OK
+        ));
+
+        let count = Arc::new(CountWaker(AtomicUsize::new(0)));
+        let waker = futures_util::task::waker(count.clone());
+        let mut cx = Context::from_waker(&waker);
+        assert!(matches!(
+            hyper_reactor_want_read(reactor, rx, hyper_context::wrap(&mut cx)),
+            hyper_code::HYPERE_OK
+        ));
+
+        assert_eq!(hyper_reactor_run_once(reactor, 0), 0);
+        assert_eq!(unsafe { libc::write(tx, b"x".as_ptr() as *const _, 1) }, 1);
+        assert_eq!(hyper_reactor_run_once(reactor, 1000), 1);
+        assert_eq!(count.0.load(Ordering::SeqCst), 1);
+
+        assert!(matches!(
+            hyper_reactor_deregister_fd(reactor, rx),
+            hyper_code::HYPERE_OK
+        ));
+        hyper_reactor_free(reactor);
+        unsafe {
+            libc::close(rx);
+            libc::close(tx);
+        }
+    }
+}
@@ -0,0 +1,166 @@
+use std::alloc::{self, Layout};
+use std::cell::RefCell;
+use std::mem;
+use std::ptr::{self, NonNull};
+
+/// How many freed allocations are kept for each layout.
+const MAX_FREE_PER_LAYOUT: usize = 32;
+
+/// How many different layouts are kept.
+const MAX_LAYOUTS: usize = 8;
+
+/// Freed allocations of the small wrappers handed to C, kept per thread to
+/// be reused by the next wrapper with the same layout.
+///
+/// Every request boxes a `hyper_request`, a `hyper_task` per send and body
+/// task, a `hyper_response`, and a `hyper_buf` per chunk. These are all
+/// freed by C a moment later, usually on the same thread, so reusing their
+/// allocations saves a trip to the allocator, and any locking it does when
+/// many threads poll executors at once.
+///
+/// The allocations are interchangeable with those of a `Box<T>` of the
+/// same layout, so a recycled box can still be dropped normally, and any
+/// box can be recycled.
+struct FreeLists {
+    lists: Vec<FreeList>,
+}
+
+struct FreeList {
+    layout: Layout,
+    free: Vec<NonNull<u8>>,
+}
+
+thread_local! {
+    static FREE_LISTS: RefCell<FreeLists> = RefCell::new(FreeLists { lists: Vec::new() });
+}
+
+/// Box a value, reusing a freed allocation if there is one.
+pub(super) fn boxed<T>(value: T) -> Box<T> {
+    let layout = Layout::new::<T>();
+    if layout.size() == 0 {
+        return Box::new(value);
+    }
+
+    let reused = FREE_LISTS
+        .try_with(|lists| lists.try_borrow_mut().ok()?.pop(layout))
+        .ok()
+        .flatten();
+    match reused {
+        Some(ptr) => unsafe {
+            let ptr = ptr.as_ptr() as *mut T;
+            ptr.write(value);
+            Box::from_raw(ptr)
+        },
+        None => Box::new(value),
+    }
+}
+
+/// Drop a boxed value, keeping its allocation for reuse.
+pub(super) fn free<T>(b: Box<T>) {
+    let ptr = Box::into_raw(b);
+    unsafe {
+        ptr::drop_in_place(ptr);
+        recycle(ptr as *mut u8, Layout::new::<T>());
+    }
+}
+
+/// Move a value out of its box, keeping the allocation for reuse.
+pub(super) fn unbox<T>(b: Box<T>) -> T {
+    let ptr = Box::into_raw(b);
+    unsafe {
+        let value = ptr::read(ptr);
+        recycle(ptr as *mut u8, Layout::new::<T>());
+        value
+    }
+}
+
+/// Safety: `ptr` must have been allocated by the global allocator with
+/// `layout`, and must not be used again.
+unsafe fn recycle(ptr: *mut u8, layout: Layout) {
+    if layout.size() == 0 {
+        return;
+    }
+
+    let ptr = NonNull::new_unchecked(ptr);
+    let kept = FREE_LISTS
+        .try_with(|lists| match lists.try_borrow_mut() {
+            Ok(mut lists) => lists.push(layout, ptr),
+            Err(_) => false,
+        })
+        .unwrap_or(false);
+    if !kept {
+        alloc::dealloc(ptr.as_ptr(), layout);
+    }
+}
+
+// ===== impl FreeLists =====
+
+impl FreeLists {
+    fn pop(&mut self, layout: Layout) -> Option<NonNull<u8>> {
+        self.lists
+            .iter_mut()
+            .find(|list| list.layout == layout)?
+            .free
+            .pop()
+    }
+
+    fn push(&mut self, layout: Layout, ptr: NonNull<u8>) -> bool {
+        let idx = match self.lists.iter().position(|list| list.layout == layout) {
+            Some(idx) => idx,
+            None if self.lists.len() < MAX_LAYOUTS => {
+                self.lists.push(FreeList {
+                    layout,
+                    free: Vec::new(),
+                });
+                self.lists.len() - 1
+            }
+            None => return false,
+        };
+
+        let list = &mut self.lists[idx];
+        if list.free.len() == MAX_FREE_PER_LAYOUT {
+            return false;
+        }
+        list.free.push(ptr);
+        true
+    }
+}
+
+impl Drop for FreeLists {
+    fn drop(&mut self) {
+        for list in mem::replace(&mut self.lists, Vec::new()) {
+            for ptr in list.free {
+                unsafe { alloc::dealloc(ptr.as_ptr(), list.layout) };
+            }
+        }
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_freed_allocation_is_reused() {
+        let first = boxed([1u64; 5]);
+        let addr = &*first as *const [u64; 5];
+        free(first);
+
+        let second = boxed([2u64; 5]);
+        assert_eq!(&*second as *const [u64; 5], addr);
+        assert_eq!(*second, [2; 5]);
+
+        // A recycled box can be dropped normally too.
+        drop(second);
+    }
+
+    #[test]
+    fn test_unbox_moves_value_out() {
+        let s = unbox(boxed(String::from("hyper")));
+        assert_eq!(s, "hyper");
+
+        let b = boxed(String::from("reused"));
+        assert_eq!(*b, "reused");
+        free(b);
+    }
+}
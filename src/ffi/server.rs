@@ -0,0 +1,280 @@
+use std::ffi::c_void;
+use std::sync::Arc;
+
+use libc::c_int;
+use tokio::sync::oneshot;
+
+use crate::common::exec::Exec;
+use crate::common::{task, Future, Pin, Poll};
+use crate::server::conn::Http;
+use crate::service::Service;
+use crate::{Body, Request, Response};
+
+use super::error::hyper_code;
+use super::http_types::{hyper_request, hyper_response};
+use super::io::hyper_io;
+use super::recycle;
+use super::task::{hyper_executor, hyper_task};
+use super::UserDataPointer;
+
+/// An options builder to configure an HTTP server connection.
+pub struct hyper_serverconn_options {
+    http: Http<Exec>,
+}
+
+/// A service that answers the requests received on a server connection.
+///
+/// The callback is called with each request, and a `hyper_response_channel *`
+/// that the response is sent on.
+pub struct hyper_service {
+    func: hyper_service_callback,
+    userdata: UserDataPointer,
+}
+
+/// A channel to send the response to a request received by a `hyper_service`.
+pub struct hyper_response_channel {
+    tx: oneshot::Sender<Box<hyper_response>>,
+}
+
+type hyper_service_callback =
+    extern "C" fn(*mut c_void, *mut hyper_request, *mut hyper_response_channel);
+
+// ===== impl hyper_serverconn =====
+
+ffi_fn! {
+    /// Serve an HTTP server connection over the provided IO transport, passing
+    /// each request received to the `service`.
+    ///
+    /// Both the `io` and the `service` are consumed in this function call. The
+    /// `options` are not, so they can be used to serve many connections.
+    ///
+    /// The returned `hyper_task *` must be polled with an executor until the
+    /// connection closes, at which point it yields an empty value, or a
+    /// `hyper_error *` if the connection failed.
+    fn hyper_serverconn_serve(io: *mut hyper_io, service: *mut hyper_service, options: *const hyper_serverconn_options) -> *mut hyper_task {
+        if io.is_null() || service.is_null() || options.is_null() {
+            return std::ptr::null_mut();
+        }
+
+        let options = unsafe { &*options };
+        let io = unsafe { Box::from_raw(io) };
+        let service = unsafe { Box::from_raw(service) };
+
+        let conn = options.http.serve_connection(io, *service);
+        Box::into_raw(hyper_task::boxed(conn))
+    } ?= std::ptr::null_mut()
+}
+
+// ===== impl hyper_serverconn_options =====
+
+ffi_fn! {
+    /// Creates a new set of HTTP server connection options.
+    ///
+    /// The `exec` runs the background tasks of HTTP2 connections. This does
+    /// not consume the `exec`.
+    fn hyper_serverconn_options_new(exec: *const hyper_executor) -> *mut hyper_serverconn_options {
+        if exec.is_null() {
+            return std::ptr::null_mut();
+        }
+
+        let exec = unsafe { Arc::from_raw(exec) };
+        let weak_exec = hyper_executor::downgrade(&exec);
+        std::mem::forget(exec);
+
+        let mut http = Http::new().with_executor(Exec::Executor(Arc::new(weak_exec)));
+        http.http1_preserve_header_case(true);
+
+        Box::into_raw(Box::new(hyper_serverconn_options { http }))
+    } ?= std::ptr::null_mut()
+}
+
+ffi_fn! {
+    /// Free a `hyper_serverconn_options *`.
+    fn hyper_serverconn_options_free(opts: *mut hyper_serverconn_options) {
+        drop(unsafe { Box::from_raw(opts) });
+    }
+}
+
+ffi_fn! {
+    /// Set whether HTTP/1 connections should support keep-alive.
+    ///
+    /// Pass `0` to disable, `1` to enable. Default is enabled.
+    fn hyper_serverconn_options_http1_keep_alive(opts: *mut hyper_serverconn_options, enabled: c_int) -> hyper_code {
+        let opts = unsafe { &mut *opts };
+        opts.http.http1_keep_alive(enabled != 0);
+        hyper_code::HYPERE_OK
+    }
+}
+
+ffi_fn! {
+    /// Set the whether to serve only HTTP2.
+    ///
+    /// Pass `0` to disable, `1` to enable.
+    fn hyper_serverconn_options_http2(opts: *mut hyper_serverconn_options, enabled: c_int) -> hyper_code {
+        #[cfg(feature = "http2")]
+        {
+            let opts = unsafe { &mut *opts };
+            opts.http.http2_only(enabled != 0);
+            hyper_code::HYPERE_OK
+        }
+
+        #[cfg(not(feature = "http2"))]
+        {
+            drop(opts);
+            drop(enabled);
+            hyper_code::HYPERE_FEATURE_NOT_ENABLED
+        }
+    }
+}
+
+// ===== impl hyper_service =====
+
+ffi_fn! {
+    /// Create a service that calls `func` with each request received.
+    ///
+    /// The callback takes ownership of the `hyper_request *`, and must send a
+    /// response on the `hyper_response_channel *`, either right away or later
+    /// from another callback.
+    fn hyper_service_new(func: hyper_service_callback) -> *mut hyper_service {
+        Box::into_raw(Box::new(hyper_service {
+            func,
+            userdata: UserDataPointer(std::ptr::null_mut()),
+        }))
+    } ?= std::ptr::null_mut()
+}
+
+ffi_fn! {
+    /// Set the user data pointer passed to the service callback.
+    fn hyper_service_set_userdata(service: *mut hyper_service, userdata: *mut c_void) {
+        let service = unsafe { &mut *service };
+        service.userdata = UserDataPointer(userdata);
+    }
+}
+
+ffi_fn! {
+    /// Free a `hyper_service *` that was not given to a connection.
+    fn hyper_service_free(service: *mut hyper_service) {
+        drop(unsafe { Box::from_raw(service) });
+    }
+}
+
+impl Service<Request<Body>> for hyper_service {
+    type Response = Response<Body>;
+    type Error = crate::Error;
+    type Future = ResponseFuture;
+
+    fn poll_ready(&mut self, _: &mut task::Context<'_>) -> Poll<Result<(), Self::Error>> {
+        Poll::Ready(Ok(()))
+    }
+
+    fn call(&mut self, req: Request<Body>) -> Self::Future {
+        let (tx, rx) = oneshot::channel();
+        let req = Box::into_raw(recycle::boxed(hyper_request::wrap(req)));
+        let channel = Box::into_raw(Box::new(hyper_response_channel { tx }));
+
+        (self.func)(self.userdata.0, req, channel);
+
+        ResponseFuture { rx }
+    }
+}
+
+/// Waits for the C service to send on its `hyper_response_channel`.
+///
+/// cbindgen:ignore
+pub struct ResponseFuture {
+    rx: oneshot::Receiver<Box<hyper_response>>,
+}
+
+impl Future for ResponseFuture {
+    type Output = crate::Result<Response<Body>>;
+
+    fn poll(mut self: Pin<&mut Self>, cx: &mut task::Context<'_>) -> Poll<Self::Output> {
+        match ready!(Pin::new(&mut self.rx).poll(cx)) {
+            Ok(resp) => {
+                let mut resp = recycle::unbox(resp);
+                resp.finalize_response();
+                Poll::Ready(Ok(resp.0))
+            }
+            Err(_) => {
+                Poll::Ready(Err(crate::Error::new_canceled()
+                    .with("response channel was freed without a response")))
+            }
+        }
+    }
+}
+
+// ===== impl hyper_response_channel =====
+
+ffi_fn! {
+    /// Send the response to a request received by a `hyper_service`.
+    ///
+    /// Both the `channel` and the `response` are consumed in this function
+    /// call. If the connection has closed in the meantime, the response is
+    /// freed.
+    fn hyper_response_channel_send(channel: *mut hyper_response_channel, response: *mut hyper_response) {
+        if channel.is_null() {
+            return;
+        }
+        let channel = unsafe { Box::from_raw(channel) };
+        if response.is_null() {
+            return;
+        }
+        let response = unsafe { Box::from_raw(response) };
+
+        let _ = channel.tx.send(response);
+    }
+}
+
+ffi_fn! {
+    /// Free a `hyper_response_channel *` without sending a response.
+    ///
+    /// The request fails, which closes an HTTP/1 connection, or resets the
+    /// stream of an HTTP2 one.
+    fn hyper_response_channel_free(channel: *mut hyper_response_channel) {
+        drop(unsafe { Box::from_raw(channel) });
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use futures_util::future::FutureExt as _;
+
+    #[test]
+    fn test_service_responds_through_channel() {
+        extern "C" fn respond(
+            userdata: *mut c_void,
+            req: *mut hyper_request,
+            channel: *mut hyper_response_channel,
+        ) {
+            let calls = unsafe { &mut *(userdata as *mut usize) };
+            *calls += 1;
+
+            let req = unsafe { Box::from_raw(req) };
+            assert_eq!(req.0.uri().path(), "/hello");
+
+            let resp = hyper_response_new();
+            assert!(matches!(
+                hyper_response_set_status(resp, 204),
+                hyper_code::HYPERE_OK
+            ));
+            hyper_response_channel_send(channel, resp);
+        }
+
+        let mut calls = 0usize;
+        let service = hyper_service_new(respond);
+        hyper_service_set_userdata(service, &mut calls as *mut usize as *mut c_void);
+        let mut service = unsafe { Box::from_raw(service) };
+
+        let req = Request::get("/hello").body(Body::empty()).unwrap();
+        // The callback responds right away, so the future is already ready.
+        let resp = service
+            .call(req)
+            .now_or_never()
+            .expect("ready")
+            .expect("response");
+
+        assert_eq!(calls, 1);
+        assert_eq!(resp.status(), 204);
+    }
+}
@@ -1,17 +1,20 @@
+use std::collections::BinaryHeap;
 use std::ffi::c_void;
 use std::future::Future;
 use std::pin::Pin;
 use std::ptr;
 use std::sync::{
-    atomic::{AtomicBool, Ordering},
+    atomic::{AtomicBool, AtomicPtr, AtomicU8, AtomicUsize, Ordering},
     Arc, Mutex, Weak,
 };
-use std::task::{Context, Poll};
+use std::task::{Context, Poll, Waker};
+use std::time::{Duration, Instant};
 
 use futures_util::stream::{FuturesUnordered, Stream};
-use libc::c_int;
+use libc::{c_int, size_t};
 
 use super::error::hyper_code;
+use super::recycle;
 use super::UserDataPointer;
 
 type BoxFuture<T> = Pin<Box<dyn Future<Output = T> + Send>>;
@@ -29,7 +32,25 @@ pub const HYPER_POLL_ERROR: c_int = 3;
 
 /// A task executor for `hyper_task`s.
 pub struct hyper_executor {
-    /// The executor of all task futures.
+    /// The shards of this executor, each driving its own set of tasks.
+    ///
+    /// An executor made with `hyper_executor_new()` has a single shard. One
+    /// made with `hyper_executor_new_multi()` has a shard per polling thread,
+    /// so several threads can drive tasks at the same time.
+    shards: Vec<Shard>,
+
+    /// Which shard the next spawned task is queued on.
+    next_spawn: AtomicUsize,
+
+    /// Called when the executor has work to do again.
+    wake_callback: Arc<WakeCallbackSlot>,
+
+    /// The deadlines of the tasks pushed with `hyper_task_set_timeout`.
+    timers: Mutex<BinaryHeap<Timer>>,
+}
+
+struct Shard {
+    /// The executor of all task futures in this shard.
     ///
     /// There should never be contention on the mutex, as it is only locked
     /// to drive the futures. However, we cannot gaurantee proper usage from
@@ -40,25 +61,95 @@ pub struct hyper_executor {
 
     /// The queue of futures that need to be pushed into the `driver`.
     ///
-    /// This is has a separate mutex since `spawn` could be called from inside
-    /// a future, which would mean the driver's mutex is already locked.
-    spawn_queue: Mutex<Vec<TaskFuture>>,
+    /// This is separate since `spawn` could be called from inside a future,
+    /// which would mean the driver's mutex is already locked. It is lock-free,
+    /// so threads handing tasks to this shard never wait on each other or on
+    /// the polling thread.
+    spawn_queue: SpawnQueue,
 
     /// This is used to track when a future calls `wake` while we are within
-    /// `hyper_executor::poll_next`.
+    /// `Shard::poll_next`, or a task is spawned.
     is_woken: Arc<ExecWaker>,
 }
 
+/// A lock-free stack of spawned tasks, pushed from any thread and taken all
+/// at once by the thread driving the shard.
+///
+/// Since the consumer always takes the whole stack, nodes are never popped
+/// one at a time, which avoids the ABA problem of a Treiber stack.
+struct SpawnQueue {
+    head: AtomicPtr<SpawnNode>,
+}
+
+struct SpawnNode {
+    task: TaskFuture,
+    next: *mut SpawnNode,
+}
+
+/// The deadline of a task pushed to the executor, or of anything else that
+/// waits on one, such as a request waiting for `100 Continue`.
+///
+/// Only the earliest deadline is ever needed, to expire its target or to
+/// tell C how long to wait, so they are kept in a heap ordered soonest first.
+struct Timer {
+    deadline: Instant,
+    target: Weak<dyn Expire>,
+}
+
+/// What a `Timer` acts on once its deadline has passed.
+pub(crate) trait Expire: Send + Sync {
+    /// Whether it is still waiting on the deadline.
+    fn is_pending(&self) -> bool;
+
+    /// The deadline has passed.
+    fn expire(&self);
+}
+
+/// Whether a task was canceled or timed out, shared by the task, its
+/// `hyper_canceler`s and its `Timer`.
+struct TaskControl {
+    state: AtomicU8,
+    waker: Mutex<Option<Waker>>,
+}
+
+const TASK_RUNNING: u8 = 0;
+const TASK_DONE: u8 = 1;
+const TASK_CANCELED: u8 = 2;
+const TASK_TIMED_OUT: u8 = 3;
+
+type hyper_executor_wake_callback = extern "C" fn(*mut c_void);
+
+/// The callback set with `hyper_executor_set_wake_callback`, if any.
+///
+/// It can only be set once, so it can be read without a lock.
+struct WakeCallbackSlot(AtomicPtr<WakeCallback>);
+
+struct WakeCallback {
+    func: hyper_executor_wake_callback,
+    userdata: UserDataPointer,
+}
+
 #[derive(Clone)]
 pub(crate) struct WeakExec(Weak<hyper_executor>);
 
-struct ExecWaker(AtomicBool);
+struct ExecWaker {
+    woken: AtomicBool,
+    callback: Arc<WakeCallbackSlot>,
+}
 
 /// An async task.
 pub struct hyper_task {
     future: BoxFuture<BoxAny>,
     output: Option<BoxAny>,
     userdata: UserDataPointer,
+    /// The timeout set with `hyper_task_set_timeout`, until it is pushed.
+    timeout: Option<Duration>,
+    control: Option<Arc<TaskControl>>,
+}
+
+/// A handle to cancel a task, even once it has been pushed to an executor.
+pub struct hyper_canceler {
+    control: Arc<TaskControl>,
 }
 
 struct TaskFuture {
@@ -86,6 +177,8 @@ pub enum hyper_task_return_type {
     HYPER_TASK_RESPONSE,
     /// The value of this task is `hyper_buf *`.
     HYPER_TASK_BUF,
+    /// The value of this task is `hyper_headers *`.
+    HYPER_TASK_HEADERS,
 }
 
 pub(crate) unsafe trait AsTaskType {
@@ -99,11 +192,15 @@ pub(crate) trait IntoDynTaskType {
 // ===== impl hyper_executor =====
 
 impl hyper_executor {
-    fn new() -> Arc<hyper_executor> {
+    fn new(shards: usize) -> Arc<hyper_executor> {
+        let wake_callback = Arc::new(WakeCallbackSlot(AtomicPtr::new(ptr::null_mut())));
         Arc::new(hyper_executor {
-            driver: Mutex::new(FuturesUnordered::new()),
-            spawn_queue: Mutex::new(Vec::new()),
-            is_woken: Arc::new(ExecWaker(AtomicBool::new(false))),
+            shards: (0..shards)
+                .map(|_| Shard::new(wake_callback.clone()))
+                .collect(),
+            next_spawn: AtomicUsize::new(0),
+            wake_callback,
+            timers: Mutex::new(BinaryHeap::new()),
         })
     }
 
@@ -111,61 +208,285 @@ impl hyper_executor {
         WeakExec(Arc::downgrade(exec))
     }
 
-    fn spawn(&self, task: Box<hyper_task>) {
-        self.spawn_queue
-            .lock()
-            .unwrap()
-            .push(TaskFuture { task: Some(task) });
+    fn spawn(&self, mut task: Box<hyper_task>) {
+        // A deadline too far away to represent never expires anyway.
+        let deadline = task
+            .timeout
+            .take()
+            .and_then(|timeout| Instant::now().checked_add(timeout));
+        if let Some(deadline) = deadline {
+            let control: Arc<dyn Expire> =
+                task.control.get_or_insert_with(TaskControl::new).clone();
+            self.add_timer(deadline, Arc::downgrade(&control));
+        }
+
+        let idx = if self.shards.len() == 1 {
+            0
+        } else {
+            self.next_spawn.fetch_add(1, Ordering::Relaxed) % self.shards.len()
+        };
+        self.shards[idx].spawn(task);
     }
 
     fn poll_next(&self) -> Option<Box<hyper_task>> {
+        let mut out = None;
+        self.poll_ready(1, |task| out = Some(task));
+        out
+    }
+
+    /// Poll the tasks, passing up to `max` completed ones to `f`.
+    ///
+    /// Returns how many tasks were completed.
+    fn poll_ready<F>(&self, max: usize, mut f: F) -> usize
+    where
+        F: FnMut(Box<hyper_task>),
+    {
+        self.fire_timers();
+
+        if let [ref shard] = self.shards[..] {
+            return shard.poll_ready(&mut shard.driver.lock().unwrap(), max, &mut f);
+        }
+
+        // Start with this thread's own shard, then steal from the others.
+        // Shards being driven by another thread right now are skipped.
+        let len = self.shards.len();
+        let home = home_shard(len);
+        let mut done = 0;
+        for i in 0..len {
+            if done == max {
+                break;
+            }
+            let shard = &self.shards[(home + i) % len];
+            if let Ok(mut driver) = shard.driver.try_lock() {
+                done += shard.poll_ready(&mut driver, max - done, &mut f);
+            }
+        }
+        done
+    }
+
+    fn add_timer(&self, deadline: Instant, target: Weak<dyn Expire>) {
+        self.timers.lock().unwrap().push(Timer { deadline, target });
+    }
+
+    /// Expire the timers whose deadline has passed.
+    ///
+    /// Tasks are woken, and complete with an error when polled next.
+    fn fire_timers(&self) {
+        let mut timers = self.timers.lock().unwrap();
+        if timers.is_empty() {
+            return;
+        }
+
+        let now = Instant::now();
+        while let Some(timer) = timers.peek() {
+            if timer.deadline > now {
+                break;
+            }
+            if let Some(target) = timers.pop().unwrap().target.upgrade() {
+                target.expire();
+            }
+        }
+    }
+
+    /// How long until the earliest deadline of a timer that is still pending.
+    fn next_timeout(&self) -> Option<Duration> {
+        let mut timers = self.timers.lock().unwrap();
+        loop {
+            let timer = timers.peek()?;
+            let pending = timer
+                .target
+                .upgrade()
+                .map_or(false, |target| target.is_pending());
+            if pending {
+                return Some(timer.deadline.saturating_duration_since(Instant::now()));
+            }
+            // Whatever it was for completed before its deadline.
+            timers.pop();
+        }
+    }
+}
+
+/// Pick the shard a polling thread starts with, spreading threads evenly.
+fn home_shard(len: usize) -> usize {
+    static NEXT_THREAD: AtomicUsize = AtomicUsize::new(0);
+
+    thread_local! {
+        static THREAD_IDX: usize = NEXT_THREAD.fetch_add(1, Ordering::Relaxed);
+    }
+
+    THREAD_IDX.with(|idx| *idx % len)
+}
+
+// ===== impl Shard =====
+
+impl Shard {
+    fn new(callback: Arc<WakeCallbackSlot>) -> Shard {
+        Shard {
+            driver: Mutex::new(FuturesUnordered::new()),
+            spawn_queue: SpawnQueue {
+                head: AtomicPtr::new(ptr::null_mut()),
+            },
+            is_woken: Arc::new(ExecWaker::new(callback)),
+        }
+    }
+
+    fn spawn(&self, task: Box<hyper_task>) {
+        self.spawn_queue.push(TaskFuture { task: Some(task) });
+        self.is_woken.set_woken();
+    }
+
+    fn poll_ready<F>(
+        &self,
+        driver: &mut FuturesUnordered<TaskFuture>,
+        max: usize,
+        f: &mut F,
+    ) -> usize
+    where
+        F: FnMut(Box<hyper_task>),
+    {
+        // Any wake from here on means there may be more to do, and should
+        // reach the wake callback again.
+        self.is_woken.woken.store(false, Ordering::SeqCst);
+
         // Drain the queue first.
-        self.drain_queue();
+        self.drain_queue(driver);
 
         let waker = futures_util::task::waker_ref(&self.is_woken);
         let mut cx = Context::from_waker(&waker);
+        let mut done = 0;
 
-        loop {
-            match Pin::new(&mut *self.driver.lock().unwrap()).poll_next(&mut cx) {
-                Poll::Ready(val) => return val,
+        while done < max {
+            match Pin::new(&mut *driver).poll_next(&mut cx) {
+                Poll::Ready(Some(task)) => {
+                    f(task);
+                    done += 1;
+                }
+                Poll::Ready(None) => break,
                 Poll::Pending => {
                     // Check if any of the pending tasks tried to spawn
                     // some new tasks. If so, drain into the driver and loop.
-                    if self.drain_queue() {
+                    if self.drain_queue(driver) {
                         continue;
                     }
 
                     // If the driver called `wake` while we were polling,
                     // we should poll again immediately!
-                    if self.is_woken.0.swap(false, Ordering::SeqCst) {
+                    if self.is_woken.woken.swap(false, Ordering::SeqCst) {
                         continue;
                     }
 
-                    return None;
+                    break;
                 }
             }
         }
+
+        done
     }
 
-    fn drain_queue(&self) -> bool {
-        let mut queue = self.spawn_queue.lock().unwrap();
-        if queue.is_empty() {
-            return false;
+    fn drain_queue(&self, driver: &mut FuturesUnordered<TaskFuture>) -> bool {
+        self.spawn_queue.drain(|task| driver.push(task))
+    }
+}
+
+// ===== impl SpawnQueue =====
+
+// The tasks are `Send`, and only move between threads through the atomic
+// head, which the compiler can't check through a raw pointer.
+unsafe impl Send for SpawnQueue {}
+unsafe impl Sync for SpawnQueue {}
+
+impl SpawnQueue {
+    fn push(&self, task: TaskFuture) {
+        let node = Box::into_raw(Box::new(SpawnNode {
+            task,
+            next: ptr::null_mut(),
+        }));
+        let mut head = self.head.load(Ordering::Relaxed);
+        loop {
+            unsafe { (*node).next = head };
+            match self
+                .head
+                .compare_exchange_weak(head, node, Ordering::Release, Ordering::Relaxed)
+            {
+                Ok(_) => return,
+                Err(actual) => head = actual,
+            }
         }
+    }
 
-        let driver = self.driver.lock().unwrap();
+    /// Take every queued task, passing them to `f` in the order they were
+    /// pushed.
+    ///
+    /// Returns whether there were any.
+    fn drain<F>(&self, mut f: F) -> bool
+    where
+        F: FnMut(TaskFuture),
+    {
+        let mut node = self.head.swap(ptr::null_mut(), Ordering::Acquire);
+        if node.is_null() {
+            return false;
+        }
 
-        for task in queue.drain(..) {
-            driver.push(task);
+        // The stack is newest first, so reverse it.
+        let mut prev = ptr::null_mut();
+        while !node.is_null() {
+            let next = unsafe { (*node).next };
+            unsafe { (*node).next = prev };
+            prev = node;
+            node = next;
         }
 
+        let mut node = prev;
+        while !node.is_null() {
+            let boxed = unsafe { Box::from_raw(node) };
+            node = boxed.next;
+            f(boxed.task);
+        }
         true
     }
 }
 
+impl Drop for SpawnQueue {
+    fn drop(&mut self) {
+        self.drain(drop);
+    }
+}
+
+// ===== impl ExecWaker =====
+
+impl ExecWaker {
+    fn new(callback: Arc<WakeCallbackSlot>) -> ExecWaker {
+        ExecWaker {
+            woken: AtomicBool::new(false),
+            callback,
+        }
+    }
+
+    fn set_woken(&self) {
+        // Only the first wake since the executor was last polled needs to
+        // reach the callback.
+        if !self.woken.swap(true, Ordering::SeqCst) {
+            let callback = self.callback.0.load(Ordering::Acquire);
+            if !callback.is_null() {
+                let callback = unsafe { &*callback };
+                (callback.func)(callback.userdata.0);
+            }
+        }
+    }
+}
+
 impl futures_util::task::ArcWake for ExecWaker {
     fn wake_by_ref(me: &Arc<ExecWaker>) {
-        me.0.store(true, Ordering::SeqCst);
+        me.set_woken();
+    }
+}
+
+impl Drop for WakeCallbackSlot {
+    fn drop(&mut self) {
+        let callback = *self.0.get_mut();
+        if !callback.is_null() {
+            drop(unsafe { Box::from_raw(callback) });
+        }
     }
 }
 
@@ -175,6 +496,31 @@ impl WeakExec {
     pub(crate) fn new() -> Self {
         WeakExec(Weak::new())
     }
+
+    /// Push a task that has already completed with `value`, to be returned
+    /// by the next poll of the executor, if it still exists.
+    pub(crate) fn push_ready<T>(&self, value: T, userdata: UserDataPointer)
+    where
+        T: IntoDynTaskType + Send + Sync + 'static,
+    {
+        if let Some(exec) = self.0.upgrade() {
+            let mut task = hyper_task::boxed(async move { value });
+            task.userdata = userdata;
+            exec.spawn(task);
+        }
+    }
+
+    /// Expire `target` once `timeout` has passed, if the executor still
+    /// exists.
+    pub(crate) fn add_timer(&self, timeout: Duration, target: Weak<dyn Expire>) {
+        let exec = match self.0.upgrade() {
+            Some(exec) => exec,
+            None => return,
+        };
+        if let Some(deadline) = Instant::now().checked_add(timeout) {
+            exec.add_timer(deadline, target);
+        }
+    }
 }
 
 impl crate::rt::Executor<BoxFuture<()>> for WeakExec {
@@ -188,7 +534,29 @@ impl crate::rt::Executor<BoxFuture<()>> for WeakExec {
 ffi_fn! {
     /// Creates a new task executor.
     fn hyper_executor_new() -> *const hyper_executor {
-        Arc::into_raw(hyper_executor::new())
+        Arc::into_raw(hyper_executor::new(1))
+    } ?= ptr::null()
+}
+
+ffi_fn! {
+    /// Creates a new task executor that can be polled from several threads at
+    /// the same time.
+    ///
+    /// The `threads` argument should be the number of threads that will call
+    /// `hyper_executor_poll()`. Tasks are spread over that many independent
+    /// queues. Each polling thread prefers its own queue, and takes over
+    /// other queues that no thread is currently polling, so work keeps
+    /// moving even if some threads are busy.
+    ///
+    /// A completed task is always returned to the thread whose
+    /// `hyper_executor_poll()` call finished it.
+    ///
+    /// Returns `NULL` if `threads` is `0`.
+    fn hyper_executor_new_multi(threads: size_t) -> *const hyper_executor {
+        if threads == 0 {
+            return ptr::null();
+        }
+        Arc::into_raw(hyper_executor::new(threads))
     } ?= ptr::null()
 }
 
@@ -199,6 +567,47 @@ ffi_fn! {
     }
 }
 
+ffi_fn! {
+    /// Set a callback that is called when the executor has work to do again.
+    ///
+    /// The callback is called with `userdata` when a task is pushed, or a
+    /// pending task is woken, and the executor hasn't been polled since the
+    /// last time. A loop can sleep in `epoll_wait` or similar until then, such
+    /// as by having the callback write to an `eventfd`. Once
+    /// `hyper_executor_poll` returns `NULL`, the callback is called again
+    /// before any more work is ready.
+    ///
+    /// The callback may be called from any thread that pushes or wakes tasks,
+    /// so it should only signal the polling thread, and not call back into
+    /// the executor.
+    ///
+    /// This can only be set once. Returns `HYPERE_INVALID_ARG` if it was
+    /// already set.
+    fn hyper_executor_set_wake_callback(exec: *const hyper_executor, func: hyper_executor_wake_callback, userdata: *mut c_void) -> hyper_code {
+        if exec.is_null() {
+            return hyper_code::HYPERE_INVALID_ARG;
+        }
+        let exec = unsafe { &*exec };
+
+        let callback = Box::into_raw(Box::new(WakeCallback {
+            func,
+            userdata: UserDataPointer(userdata),
+        }));
+        match exec.wake_callback.0.compare_exchange(
+            ptr::null_mut(),
+            callback,
+            Ordering::AcqRel,
+            Ordering::Acquire,
+        ) {
+            Ok(_) => hyper_code::HYPERE_OK,
+            Err(_) => {
+                drop(unsafe { Box::from_raw(callback) });
+                hyper_code::HYPERE_INVALID_ARG
+            }
+        }
+    }
+}
+
 ffi_fn! {
     /// Push a task onto the executor.
     ///
@@ -215,6 +624,34 @@ ffi_fn! {
     }
 }
 
+ffi_fn! {
+    /// Get how many milliseconds are left until the earliest deadline of the
+    /// tasks in this executor, or of a request on one of its connections
+    /// that waits for `100 Continue`.
+    ///
+    /// A loop should not wait on IO for longer than this, such as by passing
+    /// it to `hyper_reactor_run_once()`, before polling the executor again.
+    /// Polling is what completes the tasks whose deadline has passed.
+    ///
+    /// Returns `-1` if no running task has a deadline, and `0` if one has
+    /// already passed.
+    fn hyper_executor_next_timeout(exec: *const hyper_executor) -> c_int {
+        if exec.is_null() {
+            return -1;
+        }
+        let exec = unsafe { &*exec };
+
+        match exec.next_timeout() {
+            Some(left) => {
+                // Rounded up, so waiting this long reaches the deadline.
+                let ms = (left.as_nanos() + 999_999) / 1_000_000;
+                std::cmp::min(ms, c_int::MAX as u128) as c_int
+            }
+            None => -1,
+        }
+    } ?= -1
+}
+
 ffi_fn! {
     /// Polls the executor, trying to make progress on any tasks that have notified
     /// that they are ready again.
@@ -233,6 +670,32 @@ ffi_fn! {
     } ?= ptr::null_mut()
 }
 
+ffi_fn! {
+    /// Polls the executor like `hyper_executor_poll`, returning up to `cap`
+    /// completed tasks at once.
+    ///
+    /// The completed tasks are written to the `out` array, which must have
+    /// room for at least `cap` pointers. The return value is the number of
+    /// tasks written, which is `0` if there are no ready tasks.
+    ///
+    /// This drives the tasks while holding the executor's internal lock only
+    /// once, so it is cheaper than calling `hyper_executor_poll` repeatedly
+    /// when many tasks complete together.
+    fn hyper_executor_poll_many(exec: *const hyper_executor, out: *mut *mut hyper_task, cap: size_t) -> size_t {
+        if exec.is_null() || out.is_null() || cap == 0 {
+            return 0;
+        }
+        let exec = unsafe { &*exec };
+        let out = unsafe { std::slice::from_raw_parts_mut(out, cap) };
+
+        let mut n = 0;
+        exec.poll_ready(cap, |task| {
+            out[n] = Box::into_raw(task);
+            n += 1;
+        })
+    } ?= 0
+}
+
 // ===== impl hyper_task =====
 
 impl hyper_task {
@@ -241,10 +704,12 @@ impl hyper_task {
         F: Future + Send + 'static,
         F::Output: IntoDynTaskType + Send + Sync + 'static,
     {
-        Box::new(hyper_task {
+        recycle::boxed(hyper_task {
             future: Box::pin(async move { fut.await.into_dyn_task_type() }),
             output: None,
             userdata: UserDataPointer(ptr::null_mut()),
+            timeout: None,
+            control: None,
         })
     }
 
@@ -260,9 +725,25 @@ impl Future for TaskFuture {
     type Output = Box<hyper_task>;
 
     fn poll(mut self: Pin<&mut Self>, cx: &mut Context<'_>) -> Poll<Self::Output> {
+        let stopped = match self.task.as_ref().unwrap().control {
+            Some(ref control) => control.poll_stopped(cx),
+            None => None,
+        };
+        if let Some(err) = stopped {
+            let mut task = self.task.take().unwrap();
+            // Drop whatever the task was doing right away, instead of when C
+            // frees the task.
+            task.future = Box::pin(futures_util::future::pending());
+            task.output = Some(err.into_dyn_task_type());
+            return Poll::Ready(task);
+        }
+
         match Pin::new(&mut self.task.as_mut().unwrap().future).poll(cx) {
             Poll::Ready(val) => {
                 let mut task = self.task.take().unwrap();
+                if let Some(ref control) = task.control {
+                    control.state.store(TASK_DONE, Ordering::Release);
+                }
                 task.output = Some(val);
                 Poll::Ready(task)
             }
@@ -274,7 +755,7 @@ impl Future for TaskFuture {
 ffi_fn! {
     /// Free a task.
     fn hyper_task_free(task: *mut hyper_task) {
-        drop(unsafe { Box::from_raw(task) });
+        recycle::free(unsafe { Box::from_raw(task) });
     }
 }
 
@@ -333,6 +814,45 @@ ffi_fn! {
     }
 }
 
+ffi_fn! {
+    /// Set a deadline for this task, `timeout_ms` milliseconds after it is
+    /// pushed to an executor.
+    ///
+    /// If the task has not completed by then, it is stopped, dropping
+    /// whatever it was doing, and returned by `hyper_executor_poll` with a
+    /// `hyper_error *` whose code is `HYPERE_TIMED_OUT`. See
+    /// `hyper_executor_next_timeout` for how long a loop may wait before
+    /// polling again.
+    ///
+    /// A timeout too large to be a deadline, such as `UINT64_MAX`, never
+    /// expires. This must be called before the task is pushed.
+    fn hyper_task_set_timeout(task: *mut hyper_task, timeout_ms: u64) -> hyper_code {
+        if task.is_null() {
+            return hyper_code::HYPERE_INVALID_ARG;
+        }
+
+        unsafe { &mut *task }.timeout = Some(Duration::from_millis(timeout_ms));
+        hyper_code::HYPERE_OK
+    }
+}
+
+ffi_fn! {
+    /// Get a handle that can cancel this task, even after it has been pushed
+    /// to an executor.
+    ///
+    /// The `hyper_canceler *` must be freed with `hyper_canceler_free`, or
+    /// consumed by `hyper_canceler_cancel`. It can outlive the task.
+    fn hyper_task_canceler(task: *mut hyper_task) -> *mut hyper_canceler {
+        if task.is_null() {
+            return ptr::null_mut();
+        }
+
+        let task = unsafe { &mut *task };
+        let control = task.control.get_or_insert_with(TaskControl::new).clone();
+        Box::into_raw(Box::new(hyper_canceler { control }))
+    } ?= ptr::null_mut()
+}
+
 ffi_fn! {
     /// Retrieve the userdata that has been set via `hyper_task_set_userdata`.
     fn hyper_task_userdata(task: *mut hyper_task) -> *mut c_void {
@@ -344,6 +864,115 @@ ffi_fn! {
     } ?= ptr::null_mut()
 }
 
+// ===== impl TaskControl =====
+
+impl TaskControl {
+    fn new() -> Arc<TaskControl> {
+        Arc::new(TaskControl {
+            state: AtomicU8::new(TASK_RUNNING),
+            waker: Mutex::new(None),
+        })
+    }
+
+    /// Stop the task, if it is still running, and wake it to notice.
+    fn stop(&self, state: u8) {
+        let stopped = self
+            .state
+            .compare_exchange(TASK_RUNNING, state, Ordering::AcqRel, Ordering::Acquire)
+            .is_ok();
+        if stopped {
+            if let Some(waker) = self.waker.lock().unwrap().take() {
+                waker.wake();
+            }
+        }
+    }
+
+    /// Get the error to complete the task with, if it was stopped.
+    ///
+    /// Otherwise, the waker is kept to wake the task if it is stopped later.
+    fn poll_stopped(&self, cx: &mut Context<'_>) -> Option<crate::Error> {
+        if self.state.load(Ordering::Acquire) == TASK_RUNNING {
+            let mut waker = self.waker.lock().unwrap();
+            match *waker {
+                Some(ref waker) if waker.will_wake(cx.waker()) => {}
+                _ => *waker = Some(cx.waker().clone()),
+            }
+        }
+        // Checked again after storing the waker, in case the task was
+        // stopped in the meantime.
+        match self.state.load(Ordering::Acquire) {
+            TASK_CANCELED => Some(crate::Error::new_canceled().with(crate::error::CanceledByUser)),
+            TASK_TIMED_OUT => Some(crate::Error::new_canceled().with(crate::error::TimedOut)),
+            _ => None,
+        }
+    }
+}
+
+impl Expire for TaskControl {
+    fn is_pending(&self) -> bool {
+        self.state.load(Ordering::Acquire) == TASK_RUNNING
+    }
+
+    fn expire(&self) {
+        self.stop(TASK_TIMED_OUT);
+    }
+}
+
+// ===== impl Timer =====
+
+impl PartialEq for Timer {
+    fn eq(&self, other: &Timer) -> bool {
+        self.deadline == other.deadline
+    }
+}
+
+impl Eq for Timer {}
+
+impl PartialOrd for Timer {
+    fn partial_cmp(&self, other: &Timer) -> Option<std::cmp::Ordering> {
+        Some(self.cmp(other))
+    }
+}
+
+impl Ord for Timer {
+    fn cmp(&self, other: &Timer) -> std::cmp::Ordering {
+        // Reversed, so the heap pops the soonest deadline first.
+        other.deadline.cmp(&self.deadline)
+    }
+}
+
+// ===== impl hyper_canceler =====
+
+ffi_fn! {
+    /// Cancel the task of this canceler.
+    ///
+    /// A running task is stopped, dropping whatever it was doing, and
+    /// returned by `hyper_executor_poll` with a `hyper_error *` whose code is
+    /// `HYPERE_CANCELED`. If the task has already completed, this does
+    /// nothing.
+    ///
+    /// A `hyper_clientconn_send` task whose request has not been written
+    /// yet leaves the connection ready for the next request. Once writing
+    /// has started, an HTTP/1 connection is closed, since it cannot be
+    /// reused, and an HTTP/2 stream is reset.
+    ///
+    /// This consumes the canceler.
+    fn hyper_canceler_cancel(canceler: *mut hyper_canceler) {
+        if canceler.is_null() {
+            return;
+        }
+        let canceler = unsafe { Box::from_raw(canceler) };
+        canceler.control.stop(TASK_CANCELED);
+    }
+}
+
+ffi_fn! {
+    /// Free a `hyper_canceler *` without canceling its task.
+    fn hyper_canceler_free(canceler: *mut hyper_canceler) {
+        drop(unsafe { Box::from_raw(canceler) });
+    }
+}
+
 // ===== impl AsTaskType =====
 
 unsafe impl AsTaskType for () {
@@ -363,7 +992,7 @@ where
     T: AsTaskType + Send + Sync + 'static,
 {
     fn into_dyn_task_type(self) -> BoxAny {
-        Box::new(self)
+        recycle::boxed(self)
     }
 }
 
@@ -374,7 +1003,7 @@ where
     fn into_dyn_task_type(self) -> BoxAny {
         match self {
             Ok(val) => val.into_dyn_task_type(),
-            Err(err) => Box::new(err),
+            Err(err) => recycle::boxed(err),
         }
     }
 }
@@ -398,13 +1027,41 @@ impl hyper_context<'_> {
         // A struct with only one field has the same layout as that field.
         unsafe { std::mem::transmute::<&mut Context<'_>, &mut hyper_context<'_>>(cx) }
     }
+
+    pub(crate) fn waker(&self) -> &std::task::Waker {
+        self.0.waker()
+    }
 }
 
 ffi_fn! {
     /// Copies a waker out of the task context.
     fn hyper_context_waker(cx: *mut hyper_context<'_>) -> *mut hyper_waker {
         let waker = unsafe { &mut *cx }.0.waker().clone();
-        Box::into_raw(Box::new(hyper_waker { waker }))
+        Box::into_raw(recycle::boxed(hyper_waker { waker }))
+    } ?= ptr::null_mut()
+}
+
+ffi_fn! {
+    /// Store the waker of the task context in `waker`, and return it.
+    ///
+    /// If `waker` is `NULL`, this returns a new waker, like
+    /// `hyper_context_waker`. Otherwise the `waker` is reused: it is kept as
+    /// is if it already wakes this task, or updated in place if not. IO
+    /// callbacks can call this every time they return `HYPER_IO_PENDING`
+    /// without allocating a new waker each time.
+    fn hyper_context_waker_update(cx: *mut hyper_context<'_>, waker: *mut hyper_waker) -> *mut hyper_waker {
+        let current = unsafe { &mut *cx }.0.waker();
+        if waker.is_null() {
+            return Box::into_raw(recycle::boxed(hyper_waker {
+                waker: current.clone(),
+            }));
+        }
+
+        let stored = unsafe { &mut *waker };
+        if !stored.waker.will_wake(current) {
+            stored.waker = current.clone();
+        }
+        waker
     } ?= ptr::null_mut()
 }
 
@@ -413,14 +1070,250 @@ ffi_fn! {
 ffi_fn! {
     /// Free a waker that hasn't been woken.
     fn hyper_waker_free(waker: *mut hyper_waker) {
-        drop(unsafe { Box::from_raw(waker) });
+        recycle::free(unsafe { Box::from_raw(waker) });
     }
 }
 
 ffi_fn! {
-    /// Free a waker that hasn't been woken.
+    /// Wake up the task associated with a waker.
+    ///
+    /// This consumes the waker, it must not be used or freed afterwards.
     fn hyper_waker_wake(waker: *mut hyper_waker) {
-        let waker = unsafe { Box::from_raw(waker) };
+        let waker = recycle::unbox(unsafe { Box::from_raw(waker) });
         waker.waker.wake();
     }
 }
+
+ffi_fn! {
+    /// Wake up the task associated with a waker, without consuming it.
+    ///
+    /// The waker can be woken again later, and must still be freed.
+    fn hyper_waker_wake_by_ref(waker: *const hyper_waker) {
+        unsafe { &*waker }.waker.wake_by_ref();
+    }
+}
+
+ffi_fn! {
+    /// Returns `1` if the `waker` would wake the same task as the waker of the
+    /// task context, or `0` if not.
+    fn hyper_waker_will_wake(waker: *const hyper_waker, cx: *mut hyper_context<'_>) -> c_int {
+        let current = unsafe { &mut *cx }.0.waker();
+        unsafe { &*waker }.waker.will_wake(current) as c_int
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_executor_multi_polls_every_shard() {
+        let exec = hyper_executor::new(4);
+        for _ in 0..8 {
+            exec.spawn(hyper_task::boxed(async { () }));
+        }
+
+        // A single polling thread still finishes tasks on every shard.
+        let mut done = 0;
+        while let Some(task) = exec.poll_next() {
+            assert!(matches!(
+                task.output_type(),
+                hyper_task_return_type::HYPER_TASK_EMPTY
+            ));
+            done += 1;
+        }
+        assert_eq!(done, 8);
+    }
+
+    #[test]
+    fn test_executor_poll_many() {
+        let exec = hyper_executor::new(1);
+        for _ in 0..5 {
+            exec.spawn(hyper_task::boxed(async { () }));
+        }
+
+        let exec_ptr = &*exec as *const hyper_executor;
+        let mut out = [ptr::null_mut(); 5];
+        assert_eq!(hyper_executor_poll_many(exec_ptr, out.as_mut_ptr(), 3), 3);
+        assert_eq!(
+            hyper_executor_poll_many(exec_ptr, out[3..].as_mut_ptr(), 2),
+            2
+        );
+
+        let mut rest = [ptr::null_mut(); 1];
+        assert_eq!(hyper_executor_poll_many(exec_ptr, rest.as_mut_ptr(), 1), 0);
+
+        for task in &out {
+            hyper_task_free(*task);
+        }
+    }
+
+    #[test]
+    fn test_executor_wake_callback() {
+        extern "C" fn count(userdata: *mut c_void) {
+            let calls = unsafe { &*(userdata as *const AtomicUsize) };
+            calls.fetch_add(1, Ordering::SeqCst);
+        }
+
+        let calls = AtomicUsize::new(0);
+        let userdata = &calls as *const AtomicUsize as *mut c_void;
+        let exec = hyper_executor::new(1);
+        let exec_ptr = &*exec as *const hyper_executor;
+        assert!(matches!(
+            hyper_executor_set_wake_callback(exec_ptr, count, userdata),
+            hyper_code::HYPERE_OK
+        ));
+        assert!(matches!(
+            hyper_executor_set_wake_callback(exec_ptr, count, userdata),
+            hyper_code::HYPERE_INVALID_ARG
+        ));
+
+        // Only the first push since the last poll calls back.
+        exec.spawn(hyper_task::boxed(async { () }));
+        exec.spawn(hyper_task::boxed(async { () }));
+        assert_eq!(calls.load(Ordering::SeqCst), 1);
+
+        let mut done = 0;
+        while let Some(task) = exec.poll_next() {
+            hyper_task_free(Box::into_raw(task));
+            done += 1;
+        }
+        assert_eq!(done, 2);
+
+        exec.spawn(hyper_task::boxed(async { () }));
+        assert_eq!(calls.load(Ordering::SeqCst), 2);
+    }
+
+    #[test]
+    fn test_spawn_queue_keeps_order() {
+        let queue = SpawnQueue {
+            head: AtomicPtr::new(ptr::null_mut()),
+        };
+        let mut pushed = Vec::new();
+        for _ in 0..3 {
+            let task = hyper_task::boxed(async { () });
+            pushed.push(&*task as *const hyper_task);
+            queue.push(TaskFuture { task: Some(task) });
+        }
+
+        let mut drained = Vec::new();
+        assert!(queue.drain(|fut| {
+            drained.push(&**fut.task.as_ref().unwrap() as *const hyper_task);
+        }));
+        assert_eq!(drained, pushed);
+        assert!(!queue.drain(|_| ()));
+    }
+
+    #[test]
+    fn test_waker_update_reuses_waker() {
+        let slot = Arc::new(WakeCallbackSlot(AtomicPtr::new(ptr::null_mut())));
+        let wakes = Arc::new(ExecWaker::new(slot.clone()));
+        let waker = futures_util::task::waker(wakes.clone());
+        let mut cx = Context::from_waker(&waker);
+        let cx = hyper_context::wrap(&mut cx);
+
+        let first = hyper_context_waker_update(cx, ptr::null_mut());
+        assert!(!first.is_null());
+        assert_eq!(hyper_waker_will_wake(first, cx), 1);
+
+        // The same task doesn't get a new waker.
+        assert_eq!(hyper_context_waker_update(cx, first), first);
+
+        // Another task's waker is updated in place.
+        let other = Arc::new(ExecWaker::new(slot));
+        let other_waker = futures_util::task::waker(other.clone());
+        let mut other_cx = Context::from_waker(&other_waker);
+        let other_cx = hyper_context::wrap(&mut other_cx);
+        assert_eq!(hyper_waker_will_wake(first, other_cx), 0);
+        assert_eq!(hyper_context_waker_update(other_cx, first), first);
+        assert_eq!(hyper_waker_will_wake(first, other_cx), 1);
+
+        hyper_waker_wake_by_ref(first);
+        assert!(other.woken.load(Ordering::SeqCst));
+        assert!(!wakes.woken.load(Ordering::SeqCst));
+
+        hyper_waker_wake(first);
+    }
+
+    fn error_code(task: Box<hyper_task>) -> hyper_code {
+        use crate::ffi::{hyper_error_code, hyper_error_free};
+
+        let task = Box::into_raw(task);
+        assert!(matches!(
+            hyper_task_type(task),
+            hyper_task_return_type::HYPER_TASK_ERROR
+        ));
+        let err = hyper_task_value(task) as *mut crate::ffi::hyper_error;
+        let code = hyper_error_code(err);
+        hyper_error_free(err);
+        hyper_task_free(task);
+        code
+    }
+
+    #[test]
+    fn test_task_cancel_drops_future() {
+        struct SetOnDrop(Arc<AtomicBool>);
+
+        impl Drop for SetOnDrop {
+            fn drop(&mut self) {
+                self.0.store(true, Ordering::SeqCst);
+            }
+        }
+
+        let dropped = Arc::new(AtomicBool::new(false));
+        let guard = SetOnDrop(dropped.clone());
+        let task = Box::into_raw(hyper_task::boxed(async move {
+            let _guard = guard;
+            futures_util::future::pending::<()>().await
+        }));
+        let canceler = hyper_task_canceler(task);
+
+        let exec = hyper_executor::new(1);
+        exec.spawn(unsafe { Box::from_raw(task) });
+        assert!(exec.poll_next().is_none());
+
+        hyper_canceler_cancel(canceler);
+        let task = exec.poll_next().expect("canceled task");
+        assert!(dropped.load(Ordering::SeqCst));
+        assert!(matches!(error_code(task), hyper_code::HYPERE_CANCELED));
+    }
+
+    #[test]
+    fn test_task_timeout() {
+        let exec = hyper_executor::new(1);
+        let exec_ptr = &*exec as *const hyper_executor;
+        assert_eq!(hyper_executor_next_timeout(exec_ptr), -1);
+
+        // A task that completes in time doesn't count anymore.
+        let task = Box::into_raw(hyper_task::boxed(async { () }));
+        assert!(matches!(
+            hyper_task_set_timeout(task, 60_000),
+            hyper_code::HYPERE_OK
+        ));
+        exec.spawn(unsafe { Box::from_raw(task) });
+        assert!(hyper_executor_next_timeout(exec_ptr) > 0);
+        hyper_task_free(Box::into_raw(exec.poll_next().expect("done")));
+        assert_eq!(hyper_executor_next_timeout(exec_ptr), -1);
+
+        let task = Box::into_raw(hyper_task::boxed(futures_util::future::pending::<()>()));
+        hyper_task_set_timeout(task, 0);
+        exec.spawn(unsafe { Box::from_raw(task) });
+        assert_eq!(hyper_executor_next_timeout(exec_ptr), 0);
+
+        let task = exec.poll_next().expect("timed out task");
+        assert!(matches!(error_code(task), hyper_code::HYPERE_TIMED_OUT));
+        assert_eq!(hyper_executor_next_timeout(exec_ptr), -1);
+
+        // A timeout that may not fit in a deadline doesn't overflow.
+        let task = Box::into_raw(hyper_task::boxed(async { () }));
+        hyper_task_set_timeout(task, u64::MAX);
+        exec.spawn(unsafe { Box::from_raw(task) });
+        let task = Box::into_raw(exec.poll_next().expect("done"));
+        assert!(matches!(
+            hyper_task_type(task),
+            hyper_task_return_type::HYPER_TASK_EMPTY
+        ));
+        hyper_task_free(task);
+        assert_eq!(hyper_executor_next_timeout(exec_ptr), -1);
+    }
+}
@@ -1,3 +1,4 @@
+use std::collections::VecDeque;
 use std::fmt;
 use std::io;
 use std::marker::PhantomData;
@@ -52,9 +53,14 @@ where
                 #[cfg(feature = "ffi")]
                 on_informational: None,
                 #[cfg(feature = "ffi")]
+                pipelined_informational: VecDeque::new(),
+                #[cfg(feature = "ffi")]
                 raw_headers: false,
                 notify_read: false,
+                pipeline_depth: 1,
+                pipelined: VecDeque::new(),
                 reading: Reading::Init,
+                trailers: None,
                 writing: Writing::Init,
                 upgrade: None,
                 // We assume a modern world where the remote speaks HTTP/1.1.
@@ -65,6 +71,11 @@ where
         }
     }
 
+    #[cfg(feature = "ffi")]
+    pub(crate) fn set_pipeline_depth(&mut self, depth: usize) {
+        self.state.pipeline_depth = depth.max(1);
+    }
+
     #[cfg(feature = "server")]
     pub(crate) fn set_flush_pipeline(&mut self, enabled: bool) {
         self.io.set_flush_pipeline(enabled);
@@ -74,6 +85,35 @@ where
         self.io.set_max_buf_size(max);
     }
 
+    #[cfg(feature = "ffi")]
+    pub(crate) fn set_read_buf_init_size(&mut self, sz: usize) {
+        self.io.set_read_buf_init_size(sz);
+    }
+
+    #[cfg(feature = "ffi")]
+    pub(crate) fn set_writev(&mut self, enabled: bool) {
+        if enabled {
+            self.io.set_write_strategy_queue();
+        } else {
+            self.io.set_write_strategy_flatten();
+        }
+    }
+
+    #[cfg(feature = "ffi")]
+    pub(crate) fn set_write_watermarks(&mut self, low: usize, high: usize) {
+        self.io.set_write_watermarks(low, high);
+    }
+
+    #[cfg(feature = "ffi")]
+    pub(crate) fn set_memory(&mut self, memory: std::sync::Arc<crate::ffi::ConnMemory>) {
+        self.io.set_memory(memory);
+    }
+
+    #[cfg(feature = "ffi")]
+    pub(crate) fn set_release_idle_buffers(&mut self, enabled: bool) {
+        self.io.set_release_idle_buffers(enabled);
+    }
+
     #[cfg(feature = "client")]
     pub(crate) fn set_read_buf_exact_size(&mut self, sz: usize) {
         self.io.set_read_buf_exact_size(sz);
@@ -130,7 +170,9 @@ where
                     true
                 } else {
                     match self.state.writing {
-                        Writing::Init => false,
+                        // A pipelined request may still be waiting on its
+                        // response, even if nothing is being written.
+                        Writing::Init => !self.state.pipelined.is_empty(),
                         _ => true,
                     }
                 }
@@ -163,6 +205,19 @@ where
         debug_assert!(self.can_read_head());
         trace!("Conn::read_head");
 
+        if self.state.is_pipelining() {
+            // Responses arrive in the order their requests were written.
+            self.state.method = self.state.pipelined.front().cloned();
+        }
+
+        // While pipelining, 1xx responses are for the oldest request in
+        // flight, not the one written last.
+        #[cfg(feature = "ffi")]
+        let on_informational = match self.state.pipelined_informational.front_mut() {
+            Some(on_informational) => on_informational,
+            None => &mut self.state.on_informational,
+        };
+
         let msg = match ready!(self.io.parse::<T>(
             cx,
             ParseContext {
@@ -172,7 +227,7 @@ where
                 preserve_header_case: self.state.preserve_header_case,
                 h09_responses: self.state.h09_responses,
                 #[cfg(feature = "ffi")]
-                on_informational: &mut self.state.on_informational,
+                on_informational,
                 #[cfg(feature = "ffi")]
                 raw_headers: self.state.raw_headers,
             }
@@ -192,7 +247,10 @@ where
         // Drop any OnInformational callbacks, we're done there!
         #[cfg(feature = "ffi")]
         {
-            self.state.on_informational = None;
+            match self.state.pipelined_informational.front_mut() {
+                Some(on_informational) => *on_informational = None,
+                None => self.state.on_informational = None,
+            }
         }
 
         self.state.busy();
@@ -261,6 +319,7 @@ where
                     Ok(slice) => {
                         let (reading, chunk) = if decoder.is_eof() {
                             debug!("incoming body completed");
+                            self.state.trailers = decoder.take_trailers();
                             (
                                 Reading::KeepAlive,
                                 if !slice.is_empty() {
@@ -306,6 +365,12 @@ where
         ret
     }
 
+    /// Take the trailers of the incoming body, once it has been read to
+    /// the end.
+    pub(crate) fn take_trailers(&mut self) -> Option<HeaderMap> {
+        self.state.trailers.take()
+    }
+
     pub(crate) fn wants_read_again(&mut self) -> bool {
         let ret = self.state.notify_read;
         self.state.notify_read = false;
@@ -449,7 +514,15 @@ where
     }
 
     fn try_keep_alive(&mut self, cx: &mut task::Context<'_>) {
+        #[cfg(feature = "ffi")]
+        let was_idle = self.state.is_idle();
         self.state.try_keep_alive::<T>();
+        #[cfg(feature = "ffi")]
+        {
+            if !was_idle && self.state.is_idle() {
+                self.io.release_idle_buffers();
+            }
+        }
         self.maybe_notify(cx);
     }
 
@@ -532,17 +605,31 @@ where
             buf,
         ) {
             Ok(encoder) => {
+                #[cfg(feature = "ffi")]
+                let on_informational = head
+                    .extensions
+                    .remove::<crate::ffi::OnInformational>()
+                    .map(crate::ffi::OnInformational::armed);
+
+                if self.state.is_pipelining() {
+                    if let Some(method) = self.state.method.take() {
+                        self.state.pipelined.push_back(method);
+                        #[cfg(feature = "ffi")]
+                        self.state
+                            .pipelined_informational
+                            .push_back(on_informational);
+                    }
+                } else {
+                    #[cfg(feature = "ffi")]
+                    {
+                        self.state.on_informational = on_informational;
+                    }
+                }
+
                 debug_assert!(self.state.cached_headers.is_none());
                 debug_assert!(head.headers.is_empty());
                 self.state.cached_headers = Some(head.headers);
 
-                #[cfg(feature = "ffi")]
-                {
-                    self.state.on_informational = head
-                        .extensions
-                        .remove::<crate::ffi::OnInformational>();
-                }
-
                 Some(encoder)
             }
             Err(err) => {
@@ -798,13 +885,26 @@ struct State {
     /// received.
     #[cfg(feature = "ffi")]
     on_informational: Option<crate::ffi::OnInformational>,
+    /// When pipelining, what to do with the 1xx responses of each request
+    /// in `pipelined`, in the same order.
+    #[cfg(feature = "ffi")]
+    pipelined_informational: VecDeque<Option<crate::ffi::OnInformational>>,
     #[cfg(feature = "ffi")]
     raw_headers: bool,
     /// Set to true when the Dispatcher should poll read operations
     /// again. See the `maybe_notify` method for more.
     notify_read: bool,
+    /// How many requests a client may write before reading their
+    /// responses. `1` disables pipelining.
+    pipeline_depth: usize,
+    /// When pipelining, the methods of requests that have been written
+    /// but whose responses have not been fully read, oldest first.
+    pipelined: VecDeque<Method>,
     /// State of allowed reads
     reading: Reading,
+    /// The trailers of the incoming body that has just ended, until the
+    /// Dispatcher takes them.
+    trailers: Option<HeaderMap>,
     /// State of allowed writes
     writing: Writing,
     /// An expected pending HTTP upgrade.
@@ -932,6 +1032,10 @@ impl State {
     }
 
     fn try_keep_alive<T: Http1Transaction>(&mut self) {
+        if self.is_pipelining() {
+            self.try_pipeline();
+        }
+
         match (&self.reading, &self.writing) {
             (&Reading::KeepAlive, &Writing::KeepAlive) => {
                 if let KA::Busy = self.keep_alive.status() {
@@ -952,6 +1056,67 @@ impl State {
         }
     }
 
+    fn is_pipelining(&self) -> bool {
+        self.pipeline_depth > 1
+    }
+
+    // Lets reading and writing move on to different messages while
+    // pipelining. Whatever is left for the regular keep-alive rules is
+    // the same as when only one request is in flight.
+    fn try_pipeline(&mut self) {
+        if let Reading::KeepAlive = self.reading {
+            self.pipelined.pop_front();
+            #[cfg(feature = "ffi")]
+            self.pipelined_informational.pop_front();
+            if self.pipelined.is_empty() {
+                if let Writing::Init = self.writing {
+                    // Nothing new was started while this response was read,
+                    // so this was the last exchange in flight.
+                    self.writing = Writing::KeepAlive;
+                }
+            } else if self.wants_keep_alive() {
+                trace!(
+                    "pipelined response done, {} more in flight",
+                    self.pipelined.len()
+                );
+                self.method = None;
+                self.reading = Reading::Init;
+                self.notify_read = true;
+            } else {
+                trace!(
+                    "connection closing with {} pipelined requests in flight",
+                    self.pipelined.len()
+                );
+                self.close();
+                return;
+            }
+        }
+
+        match (&self.writing, &self.reading) {
+            (&Writing::KeepAlive, &Reading::Init) | (&Writing::KeepAlive, &Reading::Body(..)) => {
+                // Only idempotent requests are pipelined, as a later request
+                // could be lost if the connection closes early.
+                let idempotent = self
+                    .pipelined
+                    .back()
+                    .map_or(false, |method| method.is_idempotent());
+                if idempotent
+                    && self.pipelined.len() < self.pipeline_depth
+                    && self.wants_keep_alive()
+                {
+                    trace!(
+                        "pipelining next request, {} in flight",
+                        self.pipelined.len()
+                    );
+                    self.writing = Writing::Init;
+                    // Let the Dispatcher poll the pending requests stream again.
+                    self.notify_read = true;
+                }
+            }
+            _ => (),
+        }
+    }
+
     fn disable_keep_alive(&mut self) {
         self.keep_alive.disable()
     }
@@ -3,7 +3,8 @@ use std::fmt;
 use std::io;
 use std::usize;
 
-use bytes::Bytes;
+use bytes::{BufMut, Bytes, BytesMut};
+use http::header::{HeaderMap, HeaderName, HeaderValue};
 
 use crate::common::{task, Poll};
 
@@ -19,8 +20,17 @@ use self::Kind::{Chunked, Eof, Length};
 #[derive(Clone, PartialEq)]
 pub(crate) struct Decoder {
     kind: Kind,
+    /// The trailer lines of a chunked body, as they are read.
+    trailers_buf: Option<BytesMut>,
+    /// The trailers of a chunked body, once it has ended.
+    trailers: Option<HeaderMap>,
 }
 
+/// The most bytes of trailer lines accepted after a chunked body.
+const TRAILERS_LIMIT: usize = 16 * 1024;
+/// The most trailer fields accepted after a chunked body.
+const MAX_TRAILERS: usize = 100;
+
 #[derive(Debug, Clone, Copy, PartialEq)]
 enum Kind {
     /// A Reader used when a Content-Length header is passed with a positive integer.
@@ -68,18 +78,24 @@ impl Decoder {
     pub(crate) fn length(x: u64) -> Decoder {
         Decoder {
             kind: Kind::Length(x),
+            trailers_buf: None,
+            trailers: None,
         }
     }
 
     pub(crate) fn chunked() -> Decoder {
         Decoder {
             kind: Kind::Chunked(ChunkedState::Size, 0),
+            trailers_buf: None,
+            trailers: None,
         }
     }
 
     pub(crate) fn eof() -> Decoder {
         Decoder {
             kind: Kind::Eof(false),
+            trailers_buf: None,
+            trailers: None,
         }
     }
 
@@ -97,6 +113,11 @@ impl Decoder {
         matches!(self.kind, Length(0) | Chunked(ChunkedState::End, _) | Eof(true))
     }
 
+    /// Take the trailers that followed a chunked body, once it has ended.
+    pub(crate) fn take_trailers(&mut self) -> Option<HeaderMap> {
+        self.trailers.take()
+    }
+
     pub(crate) fn decode<R: MemRead>(
         &mut self,
         cx: &mut task::Context<'_>,
@@ -127,10 +148,21 @@ impl Decoder {
             Chunked(ref mut state, ref mut size) => {
                 loop {
                     let mut buf = None;
-                    // advances the chunked state
-                    *state = ready!(state.step(cx, body, size, &mut buf))?;
+                    // advances the chunked state, a whole size line at once
+                    // when it is already buffered
+                    *state = match state.read_size_fast(body, size) {
+                        Some(next) => next,
+                        None => {
+                            ready!(state.step(cx, body, size, &mut buf, &mut self.trailers_buf))?
+                        }
+                    };
                     if *state == ChunkedState::End {
                         trace!("end of chunked");
+                        if let Some(mut buf) = self.trailers_buf.take() {
+                            // The empty line that ends the trailers.
+                            buf.put_slice(b"\r\n");
+                            self.trailers = Some(parse_trailers(&buf)?);
+                        }
                         return Poll::Ready(Ok(Bytes::new()));
                     }
                     if let Some(buf) = buf {
@@ -185,6 +217,7 @@ impl ChunkedState {
         body: &mut R,
         size: &mut u64,
         buf: &mut Option<Bytes>,
+        trailers: &mut Option<BytesMut>,
     ) -> Poll<Result<ChunkedState, io::Error>> {
         use self::ChunkedState::*;
         match *self {
@@ -195,13 +228,63 @@ impl ChunkedState {
             Body => ChunkedState::read_body(cx, body, size, buf),
             BodyCr => ChunkedState::read_body_cr(cx, body),
             BodyLf => ChunkedState::read_body_lf(cx, body),
-            Trailer => ChunkedState::read_trailer(cx, body),
-            TrailerLf => ChunkedState::read_trailer_lf(cx, body),
-            EndCr => ChunkedState::read_end_cr(cx, body),
+            Trailer => ChunkedState::read_trailer(cx, body, trailers),
+            TrailerLf => ChunkedState::read_trailer_lf(cx, body, trailers),
+            EndCr => ChunkedState::read_end_cr(cx, body, trailers),
             EndLf => ChunkedState::read_end_lf(cx, body),
             End => Poll::Ready(Ok(ChunkedState::End)),
         }
     }
+    /// Read the CRLF ending the previous chunk, if any, and the next chunk
+    /// size line in one go, if they are already buffered.
+    ///
+    /// Only the common form of the line, hex digits and a CRLF, is handled
+    /// here. That saves stepping through the line a byte at a time, which is
+    /// most of the work of decoding a body sent in many small chunks.
+    /// Anything else, such as extensions, whitespace, a partial line, or an
+    /// invalid one, returns `None` to take the byte-by-byte path, which
+    /// handles and reports those.
+    fn read_size_fast<R: MemRead>(&self, rdr: &mut R, size: &mut u64) -> Option<ChunkedState> {
+        // A size already partly read is kept, as the slow path would.
+        let skip = match *self {
+            ChunkedState::Size => 0,
+            ChunkedState::BodyCr => 2,
+            _ => return None,
+        };
+
+        let buf = rdr.buffered();
+        if buf.get(..skip)? != &b"\r\n"[..skip] {
+            return None;
+        }
+        let line = &buf[skip..];
+
+        // Up to 16 hex digits can't overflow, on top of any leading zeros.
+        let max_digits = 16 - (64 - size.leading_zeros() as usize + 3) / 4;
+        let digits = line
+            .iter()
+            .take(max_digits + 1)
+            .position(|b| !b.is_ascii_hexdigit())?;
+        if digits == 0 || line.get(digits..digits + 2)? != b"\r\n" {
+            return None;
+        }
+
+        *size = line[..digits].iter().fold(*size, |acc, &b| {
+            let digit = match b {
+                b'0'..=b'9' => b - b'0',
+                b'a'..=b'f' => b + 10 - b'a',
+                _ => b + 10 - b'A',
+            };
+            acc << 4 | digit as u64
+        });
+        rdr.consume(skip + digits + 2);
+
+        if *size == 0 {
+            Some(ChunkedState::EndCr)
+        } else {
+            debug!("incoming chunked header: {0:#X} ({0} bytes)", *size);
+            Some(ChunkedState::Body)
+        }
+    }
     fn read_size<R: MemRead>(
         cx: &mut task::Context<'_>,
         rdr: &mut R,
@@ -367,19 +450,27 @@ impl ChunkedState {
     fn read_trailer<R: MemRead>(
         cx: &mut task::Context<'_>,
         rdr: &mut R,
+        trailers: &mut Option<BytesMut>,
     ) -> Poll<Result<ChunkedState, io::Error>> {
         trace!("read_trailer");
         match byte!(rdr, cx) {
             b'\r' => Poll::Ready(Ok(ChunkedState::TrailerLf)),
-            _ => Poll::Ready(Ok(ChunkedState::Trailer)),
+            byte => {
+                push_trailer_bytes(trailers, &[byte])?;
+                Poll::Ready(Ok(ChunkedState::Trailer))
+            }
         }
     }
     fn read_trailer_lf<R: MemRead>(
         cx: &mut task::Context<'_>,
         rdr: &mut R,
+        trailers: &mut Option<BytesMut>,
     ) -> Poll<Result<ChunkedState, io::Error>> {
         match byte!(rdr, cx) {
-            b'\n' => Poll::Ready(Ok(ChunkedState::EndCr)),
+            b'\n' => {
+                push_trailer_bytes(trailers, b"\r\n")?;
+                Poll::Ready(Ok(ChunkedState::EndCr))
+            }
             _ => Poll::Ready(Err(io::Error::new(
                 io::ErrorKind::InvalidInput,
                 "Invalid trailer end LF",
@@ -390,10 +481,14 @@ impl ChunkedState {
     fn read_end_cr<R: MemRead>(
         cx: &mut task::Context<'_>,
         rdr: &mut R,
+        trailers: &mut Option<BytesMut>,
     ) -> Poll<Result<ChunkedState, io::Error>> {
         match byte!(rdr, cx) {
             b'\r' => Poll::Ready(Ok(ChunkedState::EndLf)),
-            _ => Poll::Ready(Ok(ChunkedState::Trailer)),
+            byte => {
+                push_trailer_bytes(trailers, &[byte])?;
+                Poll::Ready(Ok(ChunkedState::Trailer))
+            }
         }
     }
     fn read_end_lf<R: MemRead>(
@@ -410,6 +505,40 @@ impl ChunkedState {
     }
 }
 
+/// Keep more of the trailer lines, as long as they stay within the limit.
+fn push_trailer_bytes(trailers: &mut Option<BytesMut>, bytes: &[u8]) -> Result<(), io::Error> {
+    let buf = trailers.get_or_insert_with(BytesMut::new);
+    if buf.len() + bytes.len() > TRAILERS_LIMIT {
+        return Err(io::Error::new(
+            io::ErrorKind::InvalidData,
+            "chunked trailers too large",
+        ));
+    }
+    buf.put_slice(bytes);
+    Ok(())
+}
+
+fn parse_trailers(buf: &[u8]) -> Result<HeaderMap, io::Error> {
+    let invalid = |msg: &'static str| io::Error::new(io::ErrorKind::InvalidData, msg);
+
+    let mut fields = [httparse::EMPTY_HEADER; MAX_TRAILERS];
+    let fields = match httparse::parse_headers(buf, &mut fields) {
+        Ok(httparse::Status::Complete((_, fields))) => fields,
+        Ok(httparse::Status::Partial) => return Err(invalid("incomplete chunked trailers")),
+        Err(_) => return Err(invalid("invalid chunked trailers")),
+    };
+
+    let mut trailers = HeaderMap::with_capacity(fields.len());
+    for field in fields {
+        let name = HeaderName::from_bytes(field.name.as_bytes())
+            .map_err(|_| invalid("invalid chunked trailer name"))?;
+        let value = HeaderValue::from_bytes(field.value)
+            .map_err(|_| invalid("invalid chunked trailer value"))?;
+        trailers.append(name, value);
+    }
+    Ok(trailers)
+}
+
 #[derive(Debug)]
 struct IncompleteBody;
 
@@ -440,6 +569,14 @@ mod tests {
                 Poll::Ready(Ok(Bytes::new()))
             }
         }
+
+        fn buffered(&self) -> &[u8] {
+            self
+        }
+
+        fn consume(&mut self, n: usize) {
+            *self = &self[n..];
+        }
     }
 
     impl<'a> MemRead for &'a mut (dyn AsyncRead + Unpin) {
@@ -594,6 +731,46 @@ mod tests {
         assert_eq!(e.kind(), io::ErrorKind::InvalidInput);
     }
 
+    #[tokio::test]
+    async fn test_read_chunked_trailers() {
+        let mut mock_buf = &b"5\r\nhello\r\n0\r\nx-checksum: abc\r\nx-more: 1\r\n\r\n"[..];
+        let mut decoder = Decoder::chunked();
+        let buf = decoder.decode_fut(&mut mock_buf).await.expect("decode");
+        assert_eq!(buf, "hello");
+        assert!(decoder.take_trailers().is_none());
+
+        let buf = decoder.decode_fut(&mut mock_buf).await.expect("decode");
+        assert!(buf.is_empty());
+        assert!(decoder.is_eof());
+        let trailers = decoder.take_trailers().expect("trailers");
+        assert_eq!(trailers.len(), 2);
+        assert_eq!(trailers["x-checksum"], "abc");
+        assert_eq!(trailers["x-more"], "1");
+
+        // A body without trailers has none.
+        let mut mock_buf = &b"0\r\n\r\n"[..];
+        let mut decoder = Decoder::chunked();
+        decoder.decode_fut(&mut mock_buf).await.expect("decode");
+        assert!(decoder.is_eof());
+        assert!(decoder.take_trailers().is_none());
+    }
+
+    #[tokio::test]
+    async fn test_read_chunked_trailers_invalid() {
+        let mut mock_buf = &b"0\r\nno colon\r\n\r\n"[..];
+        let mut decoder = Decoder::chunked();
+        let e = decoder.decode_fut(&mut mock_buf).await.unwrap_err();
+        assert_eq!(e.kind(), io::ErrorKind::InvalidData);
+
+        let mut huge = b"0\r\nx-big: ".to_vec();
+        huge.extend(std::iter::repeat(b'a').take(TRAILERS_LIMIT));
+        huge.extend_from_slice(b"\r\n\r\n");
+        let mut mock_buf = &huge[..];
+        let mut decoder = Decoder::chunked();
+        let e = decoder.decode_fut(&mut mock_buf).await.unwrap_err();
+        assert_eq!(e.kind(), io::ErrorKind::InvalidData);
+    }
+
     #[tokio::test]
     async fn test_read_chunked_after_eof() {
         let mut mock_buf = &b"10\r\n1234567890abcdef\r\n0\r\n\r\n"[..];
@@ -614,6 +791,48 @@ mod tests {
         assert_eq!(0, buf.len());
     }
 
+    #[tokio::test]
+    async fn test_read_chunked_fast_and_slow_size_lines() {
+        // Plain size lines take the fast path, the others fall back to it.
+        let mut mock_buf = &b"\
+            3\r\nfoo\r\n\
+            A\r\n0123456789\r\n\
+            2;ext=1\r\nhi\r\n\
+            1  \r\n!\r\n\
+            00000000000000000001\r\n?\r\n\
+            0\r\n\r\n\
+        "[..];
+        let mut decoder = Decoder::chunked();
+
+        let mut chunks = Vec::new();
+        loop {
+            let buf = decoder.decode_fut(&mut mock_buf).await.expect("decode");
+            if buf.is_empty() {
+                break;
+            }
+            chunks.push(buf);
+        }
+        assert_eq!(chunks, ["foo", "0123456789", "hi", "!", "?"]);
+        assert!(decoder.is_eof());
+        assert!(mock_buf.is_empty());
+    }
+
+    #[tokio::test]
+    async fn test_read_chunked_fast_path_rejects_bad_lines() {
+        for bad in &[&b"3\r\nfooX\r\n"[..], b"f0000000000000003\r\n", b"3\n"] {
+            let mut mock_buf = *bad;
+            let mut decoder = Decoder::chunked();
+            let mut result = Ok(Bytes::new());
+            for _ in 0..3 {
+                result = decoder.decode_fut(&mut mock_buf).await;
+                if result.is_err() {
+                    break;
+                }
+            }
+            assert!(result.is_err(), "decoded {:?}", bad);
+        }
+    }
+
     // perform an async read using a custom buffer size and causing a blocking
     // read at the specified byte
     async fn read_async(mut decoder: Decoder, content: &[u8], block_at: usize) -> String {
@@ -1,3 +1,4 @@
+use std::collections::VecDeque;
 use std::error::Error as StdError;
 
 use bytes::{Buf, Bytes};
@@ -46,7 +47,8 @@ cfg_server! {
 cfg_client! {
     pin_project_lite::pin_project! {
         pub(crate) struct Client<B> {
-            callback: Option<crate::client::dispatch::Callback<Request<B>, http::Response<Body>>>,
+            callbacks: InFlight<B>,
+            pipeline_depth: usize,
             #[pin]
             rx: ClientRx<B>,
             rx_closed: bool,
@@ -54,6 +56,13 @@ cfg_client! {
     }
 
     type ClientRx<B> = crate::client::dispatch::Receiver<Request<B>, http::Response<Body>>;
+    type ClientCallback<B> = crate::client::dispatch::Callback<Request<B>, http::Response<Body>>;
+
+    /// Callbacks of the requests written so far, oldest first.
+    ///
+    /// When pipelining there can be more than the one being answered, so
+    /// any left once the connection goes away are told that it closed.
+    struct InFlight<B>(VecDeque<ClientCallback<B>>);
 }
 
 impl<D, Bs, I, T> Dispatcher<D, Bs, I, T>
@@ -214,6 +223,10 @@ where
                             }
                         },
                         Poll::Ready(None) => {
+                            if let Some(trailers) = self.conn.take_trailers() {
+                                // the receiver may not care about them
+                                let _ = body.try_send_trailers(trailers);
+                            }
                             // just drop, the body will close automatically
                         }
                         Poll::Pending => {
@@ -541,11 +554,28 @@ cfg_client! {
     impl<B> Client<B> {
         pub(crate) fn new(rx: ClientRx<B>) -> Client<B> {
             Client {
-                callback: None,
+                callbacks: InFlight(VecDeque::new()),
+                pipeline_depth: 1,
                 rx,
                 rx_closed: false,
             }
         }
+
+        #[cfg(feature = "ffi")]
+        pub(crate) fn set_pipeline_depth(&mut self, depth: usize) {
+            self.pipeline_depth = depth.max(1);
+        }
+    }
+
+    impl<B> Drop for InFlight<B> {
+        fn drop(&mut self) {
+            for cb in self.0.drain(..) {
+                cb.send(Err((
+                    crate::Error::new_canceled().with("connection closed"),
+                    None,
+                )));
+            }
+        }
     }
 
     impl<B> Dispatch for Client<B>
@@ -562,42 +592,59 @@ cfg_client! {
             cx: &mut task::Context<'_>,
         ) -> Poll<Option<Result<(Self::PollItem, Self::PollBody), crate::common::Never>>> {
             let mut this = self.as_mut();
-            debug_assert!(!this.rx_closed);
-            match this.rx.poll_recv(cx) {
-                Poll::Ready(Some((req, mut cb))) => {
-                    // check that future hasn't been canceled already
-                    match cb.poll_canceled(cx) {
-                        Poll::Ready(()) => {
-                            trace!("request canceled");
-                            Poll::Ready(None)
-                        }
-                        Poll::Pending => {
-                            let (parts, body) = req.into_parts();
-                            let head = RequestHead {
-                                version: parts.version,
-                                subject: crate::proto::RequestLine(parts.method, parts.uri),
-                                headers: parts.headers,
-                                extensions: parts.extensions,
-                            };
-                            this.callback = Some(cb);
-                            Poll::Ready(Some(Ok((head, body))))
+            if this.rx_closed {
+                // The sender went away while pipelined responses were still
+                // being read, close once they are done.
+                return if this.callbacks.0.is_empty() {
+                    Poll::Ready(None)
+                } else {
+                    Poll::Pending
+                };
+            }
+            loop {
+                match this.rx.poll_recv(cx) {
+                    Poll::Ready(Some((req, mut cb))) => {
+                        // check that future hasn't been canceled already
+                        match cb.poll_canceled(cx) {
+                            Poll::Ready(()) => {
+                                // None of it was written yet, so the
+                                // connection can move on to the next one.
+                                trace!("request canceled");
+                                continue;
+                            }
+                            Poll::Pending => {
+                                let (parts, body) = req.into_parts();
+                                let head = RequestHead {
+                                    version: parts.version,
+                                    subject: crate::proto::RequestLine(parts.method, parts.uri),
+                                    headers: parts.headers,
+                                    extensions: parts.extensions,
+                                };
+                                this.callbacks.0.push_back(cb);
+                                return Poll::Ready(Some(Ok((head, body))));
+                            }
                         }
                     }
+                    Poll::Ready(None) => {
+                        // user has dropped sender handle
+                        trace!("client tx closed");
+                        this.rx_closed = true;
+                        return if this.callbacks.0.is_empty() {
+                            Poll::Ready(None)
+                        } else {
+                            // Let the pipelined responses finish first.
+                            Poll::Pending
+                        };
+                    }
+                    Poll::Pending => return Poll::Pending,
                 }
-                Poll::Ready(None) => {
-                    // user has dropped sender handle
-                    trace!("client tx closed");
-                    this.rx_closed = true;
-                    Poll::Ready(None)
-                }
-                Poll::Pending => Poll::Pending,
             }
         }
 
         fn recv_msg(&mut self, msg: crate::Result<(Self::RecvItem, Body)>) -> crate::Result<()> {
             match msg {
                 Ok((msg, body)) => {
-                    if let Some(cb) = self.callback.take() {
+                    if let Some(cb) = self.callbacks.0.pop_front() {
                         let res = msg.into_response(body);
                         cb.send(Ok(res));
                         Ok(())
@@ -609,7 +656,7 @@ cfg_client! {
                     }
                 }
                 Err(err) => {
-                    if let Some(cb) = self.callback.take() {
+                    if let Some(cb) = self.callbacks.0.pop_front() {
                         cb.send(Err((err, None)));
                         Ok(())
                     } else if !self.rx_closed {
@@ -631,8 +678,8 @@ cfg_client! {
         }
 
         fn poll_ready(&mut self, cx: &mut task::Context<'_>) -> Poll<Result<(), ()>> {
-            match self.callback {
-                Some(ref mut cb) => match cb.poll_canceled(cx) {
+            match self.callbacks.0.front_mut() {
+                Some(cb) => match cb.poll_canceled(cx) {
                     Poll::Ready(()) => {
                         trace!("callback receiver has dropped");
                         Poll::Ready(Err(()))
@@ -644,7 +691,7 @@ cfg_client! {
         }
 
         fn should_poll(&self) -> bool {
-            self.callback.is_none()
+            self.callbacks.0.len() < self.pipeline_depth
         }
     }
 }
@@ -719,4 +766,118 @@ mod tests {
         // If it is, it will trigger an assertion.
         assert!(dispatcher.poll().is_pending());
     }
+
+    #[cfg(feature = "ffi")]
+    #[tokio::test]
+    async fn client_pipelines_requests_in_order() {
+        let _ = pretty_env_logger::try_init();
+
+        // The second request must be written before the first response is
+        // read, or the mock never gets to the responses.
+        let io = tokio_test::io::Builder::new()
+            .write(b"GET /a HTTP/1.1\r\n\r\n")
+            .write(b"GET /b HTTP/1.1\r\n\r\n")
+            .read(b"HTTP/1.1 200 OK\r\ncontent-length: 0\r\n\r\n")
+            .read(b"HTTP/1.1 404 Not Found\r\ncontent-length: 0\r\n\r\n")
+            .build();
+
+        let (mut tx, rx) = crate::client::dispatch::channel();
+        let mut conn = Conn::<_, bytes::Bytes, ClientTransaction>::new(io);
+        conn.set_pipeline_depth(2);
+        let mut client = Client::new(rx);
+        client.set_pipeline_depth(2);
+        let dispatcher = tokio::spawn(Dispatcher::new(client, conn));
+
+        let req = |path: &'static str| {
+            crate::Request::builder()
+                .uri(path)
+                .body(crate::Body::empty())
+                .unwrap()
+        };
+        let res_a = tx.send_queued(req("/a")).unwrap();
+        let res_b = tx.send_queued(req("/b")).unwrap();
+
+        let (res_a, res_b) = tokio::time::timeout(Duration::from_secs(5), async {
+            (res_a.await, res_b.await)
+        })
+        .await
+        .expect("pipelined responses");
+        assert_eq!(res_a.unwrap().unwrap().status(), 200);
+        assert_eq!(res_b.unwrap().unwrap().status(), 404);
+
+        drop(tx);
+        dispatcher.await.unwrap().unwrap();
+    }
+
+    #[tokio::test]
+    async fn client_receives_trailers() {
+        use crate::body::HttpBody as _;
+
+        let _ = pretty_env_logger::try_init();
+
+        let io = tokio_test::io::Builder::new()
+            .write(b"GET / HTTP/1.1\r\n\r\n")
+            .read(b"HTTP/1.1 200 OK\r\ntransfer-encoding: chunked\r\n\r\n")
+            .read(b"5\r\nhello\r\n0\r\nx-checksum: abc\r\n\r\n")
+            .build();
+
+        let (mut tx, rx) = crate::client::dispatch::channel();
+        let conn = Conn::<_, bytes::Bytes, ClientTransaction>::new(io);
+        let dispatcher = tokio::spawn(Dispatcher::new(Client::new(rx), conn));
+
+        let req = crate::Request::new(crate::Body::empty());
+        let res_rx = tx.try_send(req).unwrap();
+        let mut body = tokio::time::timeout(Duration::from_secs(5), res_rx)
+            .await
+            .expect("response")
+            .unwrap()
+            .unwrap()
+            .into_body();
+
+        let chunk = body.data().await.expect("chunk").expect("data");
+        assert_eq!(chunk, "hello");
+        assert!(body.data().await.is_none());
+        let trailers = body.trailers().await.expect("trailers").expect("some");
+        assert_eq!(trailers["x-checksum"], "abc");
+
+        drop(tx);
+        dispatcher.await.unwrap().unwrap();
+    }
+
+    #[tokio::test]
+    async fn client_skips_canceled_queued_request() {
+        let _ = pretty_env_logger::try_init();
+
+        // Only the second request is ever written.
+        let io = tokio_test::io::Builder::new()
+            .write(b"GET /b HTTP/1.1\r\n\r\n")
+            .read(b"HTTP/1.1 200 OK\r\ncontent-length: 0\r\n\r\n")
+            .build();
+
+        let (mut tx, rx) = crate::client::dispatch::channel();
+        let conn = Conn::<_, bytes::Bytes, ClientTransaction>::new(io);
+        let mut dispatcher = tokio_test::task::spawn(Dispatcher::new(Client::new(rx), conn));
+
+        // First poll is needed to allow tx to send...
+        assert!(dispatcher.poll().is_pending());
+
+        let req = |path: &'static str| {
+            crate::Request::builder()
+                .uri(path)
+                .body(crate::Body::empty())
+                .unwrap()
+        };
+        let res_a = tx.try_send(req("/a")).unwrap();
+        drop(res_a);
+
+        // The canceled request is skipped, and the connection stays open.
+        assert!(dispatcher.poll().is_pending());
+
+        let mut res_b = tokio_test::task::spawn(tx.try_send(req("/b")).unwrap());
+        assert!(dispatcher.poll().is_pending());
+        let res = tokio_test::assert_ready!(res_b.poll())
+            .expect("callback")
+            .expect("response");
+        assert_eq!(res.status(), 200);
+    }
 }
@@ -36,6 +36,10 @@ pub(crate) struct Buffered<T, B> {
     read_buf: BytesMut,
     read_buf_strategy: ReadStrategy,
     write_buf: WriteBuf<B>,
+    #[cfg(feature = "ffi")]
+    memory: Option<crate::ffi::BufferGauge>,
+    #[cfg(feature = "ffi")]
+    release_idle_buffers: bool,
 }
 
 impl<T, B> fmt::Debug for Buffered<T, B>
@@ -69,6 +73,10 @@ where
             read_buf: BytesMut::with_capacity(0),
             read_buf_strategy: ReadStrategy::default(),
             write_buf,
+            #[cfg(feature = "ffi")]
+            memory: None,
+            #[cfg(feature = "ffi")]
+            release_idle_buffers: false,
         }
     }
 
@@ -91,12 +99,49 @@ where
         self.write_buf.max_buf_size = max;
     }
 
+    /// Once `high` bytes are buffered, stop buffering more until the
+    /// buffer is flushed down to `low` bytes.
+    #[cfg(feature = "ffi")]
+    pub(crate) fn set_write_watermarks(&mut self, low: usize, high: usize) {
+        assert!(
+            low < high,
+            "The low write watermark must be below the high one."
+        );
+        self.write_buf.max_buf_size = high;
+        self.write_buf.low_watermark = Some(low);
+    }
+
     #[cfg(feature = "client")]
     pub(crate) fn set_read_buf_exact_size(&mut self, sz: usize) {
         self.read_buf_strategy = ReadStrategy::Exact(sz);
     }
 
-    #[cfg(feature = "server")]
+    /// Set the size of the first read, which adaptive reads then grow or
+    /// shrink from.
+    #[cfg(feature = "ffi")]
+    pub(crate) fn set_read_buf_init_size(&mut self, sz: usize) {
+        if let ReadStrategy::Adaptive {
+            ref mut next, max, ..
+        } = self.read_buf_strategy
+        {
+            *next = cmp::min(cmp::max(sz, INIT_BUFFER_SIZE), max);
+        }
+    }
+
+    /// Account the buffers to `memory`, and keep them within its budget.
+    #[cfg(feature = "ffi")]
+    pub(crate) fn set_memory(&mut self, memory: std::sync::Arc<crate::ffi::ConnMemory>) {
+        self.memory = Some(crate::ffi::BufferGauge::new(memory));
+    }
+
+    /// Free the buffers whenever the connection goes idle, instead of
+    /// keeping them for the next message.
+    #[cfg(feature = "ffi")]
+    pub(crate) fn set_release_idle_buffers(&mut self, enabled: bool) {
+        self.release_idle_buffers = enabled;
+    }
+
+    #[cfg(any(feature = "server", feature = "ffi"))]
     pub(crate) fn set_write_strategy_flatten(&mut self) {
         // this should always be called only at construction time,
         // so this assert is here to catch myself
@@ -104,6 +149,12 @@ where
         self.write_buf.set_strategy(WriteStrategy::Flatten);
     }
 
+    #[cfg(feature = "ffi")]
+    pub(crate) fn set_write_strategy_queue(&mut self) {
+        debug_assert!(self.write_buf.queue.bufs_cnt() == 0);
+        self.write_buf.set_strategy(WriteStrategy::Queue);
+    }
+
     pub(crate) fn read_buf(&self) -> &[u8] {
         self.read_buf.as_ref()
     }
@@ -130,11 +181,53 @@ where
     }
 
     pub(crate) fn buffer<BB: Buf + Into<B>>(&mut self, buf: BB) {
-        self.write_buf.buffer(buf)
+        self.write_buf.buffer(buf);
+        #[cfg(feature = "ffi")]
+        self.account();
     }
 
     pub(crate) fn can_buffer(&self) -> bool {
-        self.flush_pipeline || self.write_buf.can_buffer()
+        if self.flush_pipeline {
+            return true;
+        }
+        #[cfg(feature = "ffi")]
+        {
+            // Over budget, nothing more is buffered until what is already
+            // queued has been written, so a body still makes progress.
+            if self.write_buf.has_remaining() {
+                if let Some(ref memory) = self.memory {
+                    if memory.holds_writes() {
+                        return false;
+                    }
+                }
+            }
+        }
+        self.write_buf.can_buffer()
+    }
+
+    /// Report the current size of the buffers to the memory budget.
+    #[cfg(feature = "ffi")]
+    fn account(&mut self) {
+        if let Some(ref mut memory) = self.memory {
+            memory.report(self.read_buf.capacity(), self.write_buf.memory());
+        }
+    }
+
+    /// Free the buffers of a connection that just went idle, if enabled.
+    ///
+    /// They are allocated again by the next message.
+    #[cfg(feature = "ffi")]
+    pub(crate) fn release_idle_buffers(&mut self) {
+        if !self.release_idle_buffers {
+            return;
+        }
+        if self.read_buf.is_empty() {
+            self.read_buf = BytesMut::new();
+        }
+        if !self.write_buf.has_remaining() {
+            self.write_buf.headers = Cursor::new(Vec::new());
+        }
+        self.account();
     }
 
     pub(crate) fn consume_leading_lines(&mut self) {
@@ -199,7 +292,13 @@ where
         self.read_blocked = false;
         let next = self.read_buf_strategy.next();
         if self.read_buf_remaining_mut() < next {
-            self.read_buf.reserve(next);
+            #[cfg(feature = "ffi")]
+            let grow = self.read_buf_may_grow(next)?;
+            #[cfg(not(feature = "ffi"))]
+            let grow = true;
+            if grow {
+                self.read_buf.reserve(next);
+            }
         }
 
         let dst = self.read_buf.chunk_mut();
@@ -215,6 +314,8 @@ where
                     self.read_buf.advance_mut(n);
                 }
                 self.read_buf_strategy.record(n);
+                #[cfg(feature = "ffi")]
+                self.account();
                 Poll::Ready(Ok(n))
             }
             Poll::Pending => {
@@ -225,6 +326,25 @@ where
         }
     }
 
+    /// Whether the read buffer may grow by `more` bytes within the memory
+    /// budget.
+    ///
+    /// If it may not, what is left of it is still read into, and only once
+    /// it is full is it an error.
+    #[cfg(feature = "ffi")]
+    fn read_buf_may_grow(&self, more: usize) -> io::Result<bool> {
+        match self.memory {
+            Some(ref memory) if !memory.allows(more) => {
+                if self.read_buf_remaining_mut() == 0 {
+                    debug!("memory limit reached, closing");
+                    return Err(io::Error::new(io::ErrorKind::Other, "memory limit reached"));
+                }
+                Ok(false)
+            }
+            _ => Ok(true),
+        }
+    }
+
     pub(crate) fn into_inner(self) -> (T, Bytes) {
         (self.io, self.read_buf.freeze())
     }
@@ -238,6 +358,9 @@ where
     }
 
     pub(crate) fn poll_flush(&mut self, cx: &mut task::Context<'_>) -> Poll<io::Result<()>> {
+        #[cfg(feature = "ffi")]
+        self.account();
+        self.write_buf.update_draining();
         if self.flush_pipeline && !self.read_buf.is_empty() {
             Poll::Ready(Ok(()))
         } else if self.write_buf.remaining() == 0 {
@@ -258,6 +381,9 @@ where
                 // `poll_write_buf` doesn't exist in Tokio 0.3 yet...when
                 // `poll_write_buf` comes back, the manual advance will need to leave!
                 self.write_buf.advance(n);
+                self.write_buf.update_draining();
+                #[cfg(feature = "ffi")]
+                self.account();
                 debug!("flushed {} bytes", n);
                 if self.write_buf.remaining() == 0 {
                     break;
@@ -282,8 +408,11 @@ where
             let n = ready!(Pin::new(&mut self.io).poll_write(cx, self.write_buf.headers.chunk()))?;
             debug!("flushed {} bytes", n);
             self.write_buf.headers.advance(n);
+            self.write_buf.update_draining();
             if self.write_buf.headers.remaining() == 0 {
                 self.write_buf.headers.reset();
+                #[cfg(feature = "ffi")]
+                self.account();
                 break;
             } else if n == 0 {
                 trace!(
@@ -308,6 +437,16 @@ impl<T: Unpin, B> Unpin for Buffered<T, B> {}
 // TODO: This trait is old... at least rename to PollBytes or something...
 pub(crate) trait MemRead {
     fn read_mem(&mut self, cx: &mut task::Context<'_>, len: usize) -> Poll<io::Result<Bytes>>;
+
+    /// The bytes that are already buffered, and can be read without polling.
+    fn buffered(&self) -> &[u8] {
+        &[]
+    }
+
+    /// Discard `n` bytes from the front of `buffered()`.
+    fn consume(&mut self, n: usize) {
+        debug_assert_eq!(n, 0, "consume past buffered bytes");
+    }
 }
 
 impl<T, B> MemRead for Buffered<T, B>
@@ -324,6 +463,14 @@ where
             Poll::Ready(Ok(self.read_buf.split_to(::std::cmp::min(len, n)).freeze()))
         }
     }
+
+    fn buffered(&self) -> &[u8] {
+        &self.read_buf
+    }
+
+    fn consume(&mut self, n: usize) {
+        self.read_buf.advance(n);
+    }
 }
 
 #[derive(Clone, Copy, Debug)]
@@ -484,6 +631,10 @@ pub(super) struct WriteBuf<B> {
     /// Re-usable buffer that holds message headers
     headers: Cursor<Vec<u8>>,
     max_buf_size: usize,
+    /// If set, once `max_buf_size` is reached nothing more is buffered
+    /// until the buffer drains down to this many bytes.
+    low_watermark: Option<usize>,
+    draining: bool,
     /// Deque of user buffers if strategy is Queue
     queue: BufList<B>,
     strategy: WriteStrategy,
@@ -494,6 +645,8 @@ impl<B: Buf> WriteBuf<B> {
         WriteBuf {
             headers: Cursor::new(Vec::with_capacity(INIT_BUFFER_SIZE)),
             max_buf_size: DEFAULT_MAX_BUFFER_SIZE,
+            low_watermark: None,
+            draining: false,
             queue: BufList::new(),
             strategy,
         }
@@ -504,7 +657,7 @@ impl<B> WriteBuf<B>
 where
     B: Buf,
 {
-    #[cfg(feature = "server")]
+    #[cfg(any(feature = "server", feature = "ffi"))]
     fn set_strategy(&mut self, strategy: WriteStrategy) {
         self.strategy = strategy;
     }
@@ -547,6 +700,9 @@ where
     }
 
     fn can_buffer(&self) -> bool {
+        if self.draining {
+            return false;
+        }
         match self.strategy {
             WriteStrategy::Flatten => self.remaining() < self.max_buf_size,
             WriteStrategy::Queue => {
@@ -555,10 +711,29 @@ where
         }
     }
 
+    /// Start draining when the high watermark is reached, and stop when
+    /// the low watermark is reached again.
+    fn update_draining(&mut self) {
+        if let Some(low) = self.low_watermark {
+            let remaining = self.remaining();
+            if remaining >= self.max_buf_size {
+                self.draining = true;
+            } else if remaining <= low {
+                self.draining = false;
+            }
+        }
+    }
+
     fn headers_mut(&mut self) -> &mut Cursor<Vec<u8>> {
         debug_assert!(!self.queue.has_remaining());
         &mut self.headers
     }
+
+    /// The bytes held by this buffer.
+    #[cfg(feature = "ffi")]
+    fn memory(&self) -> usize {
+        self.headers.bytes.capacity() + self.queue.remaining()
+    }
 }
 
 impl<B: Buf> fmt::Debug for WriteBuf<B> {
@@ -723,6 +898,25 @@ mod tests {
         assert_eq!(strategy.next(), max, "never goes over max");
     }
 
+    #[cfg(feature = "ffi")]
+    #[test]
+    fn read_strategy_adaptive_init_size() {
+        let mock = Mock::new().build();
+        let mut buffered = Buffered::<_, Cursor<Vec<u8>>>::new(mock);
+        buffered.set_max_buf_size(65536);
+
+        buffered.set_read_buf_init_size(32768);
+        assert_eq!(buffered.read_buf_strategy.next(), 32768);
+
+        // still grows and shrinks from there
+        buffered.read_buf_strategy.record(32768);
+        assert_eq!(buffered.read_buf_strategy.next(), 65536);
+
+        // but never starts over the max
+        buffered.set_read_buf_init_size(1 << 20);
+        assert_eq!(buffered.read_buf_strategy.next(), 65536);
+    }
+
     #[test]
     fn read_strategy_adaptive_decrements() {
         let mut strategy = ReadStrategy::default();
@@ -892,6 +1086,32 @@ mod tests {
         assert_eq!(write_buf.headers.pos, 0);
     }
 
+    #[test]
+    fn write_buf_watermarks() {
+        let mut write_buf = WriteBuf::<Cursor<Vec<u8>>>::new(WriteStrategy::Flatten);
+        write_buf.max_buf_size = 10;
+        write_buf.low_watermark = Some(4);
+
+        write_buf.buffer(Cursor::new(vec![b'X'; 6]));
+        write_buf.update_draining();
+        assert!(write_buf.can_buffer());
+
+        // reaching the high watermark stops buffering...
+        write_buf.buffer(Cursor::new(vec![b'X'; 6]));
+        write_buf.update_draining();
+        assert!(!write_buf.can_buffer());
+
+        // ...even once below it again...
+        write_buf.advance(4);
+        write_buf.update_draining();
+        assert!(!write_buf.can_buffer());
+
+        // ...until the low watermark is reached
+        write_buf.advance(4);
+        write_buf.update_draining();
+        assert!(write_buf.can_buffer());
+    }
+
     #[tokio::test]
     async fn write_buf_queue_disable_auto() {
         let _ = pretty_env_logger::try_init();
@@ -920,6 +1140,69 @@ mod tests {
         assert_eq!(buffered.write_buf.queue.bufs_cnt(), 0);
     }
 
+    #[cfg(feature = "ffi")]
+    #[tokio::test]
+    async fn release_idle_buffers_is_accounted() {
+        use crate::ffi::{hyper_memory_free, hyper_memory_new, ConnMemory};
+
+        let _ = pretty_env_logger::try_init();
+        let memory = hyper_memory_new(0);
+        let conn = ConnMemory::new(unsafe { &*memory }.budget());
+
+        let mock = Mock::new().read(b"HTTP/1.1 200 OK\r\n\r\n").build();
+        let mut buffered = Buffered::<_, Cursor<Vec<u8>>>::new(mock);
+        buffered.set_memory(conn.clone());
+        buffered.set_release_idle_buffers(true);
+
+        futures_util::future::poll_fn(|cx| buffered.poll_read_from_io(cx))
+            .await
+            .expect("read");
+        assert_eq!(conn.snapshot().read_buf, buffered.read_buf.capacity());
+        assert!(conn.snapshot().read_buf > 0);
+
+        // Nothing is freed while unparsed bytes are buffered...
+        buffered.release_idle_buffers();
+        assert!(conn.snapshot().read_buf > 0);
+
+        // ...but once the message is consumed, the buffer goes away.
+        let len = buffered.read_buf.len();
+        buffered.read_buf.advance(len);
+        buffered.release_idle_buffers();
+        assert_eq!(conn.snapshot().read_buf, 0);
+
+        drop(buffered);
+        hyper_memory_free(memory);
+    }
+
+    #[cfg(feature = "ffi")]
+    #[tokio::test]
+    async fn flush_is_accounted() {
+        use crate::ffi::{hyper_memory_free, hyper_memory_new, ConnMemory};
+
+        let _ = pretty_env_logger::try_init();
+        let memory = hyper_memory_new(0);
+        let conn = ConnMemory::new(unsafe { &*memory }.budget());
+
+        let mock = Mock::new().write(b"hello world").build();
+        let mut buffered = Buffered::<_, Cursor<Vec<u8>>>::new(mock);
+        buffered.write_buf.set_strategy(WriteStrategy::Queue);
+        buffered.set_memory(conn.clone());
+
+        buffered.headers_buf().extend(b"hello ");
+        buffered.buffer(Cursor::new(b"world".to_vec()));
+        let before = conn.snapshot().write_buf;
+
+        // Written bytes stop counting as soon as they are flushed, not only
+        // the next time the connection writes.
+        buffered.flush().await.expect("flush");
+        let after = conn.snapshot().write_buf;
+        assert!(after < before);
+        assert_eq!(after, buffered.write_buf.memory());
+
+        drop(buffered);
+        hyper_memory_free(memory);
+    }
+
     // #[cfg(feature = "nightly")]
     // #[bench]
     // fn bench_write_buf_flatten_buffer_chunk(b: &mut Bencher) {
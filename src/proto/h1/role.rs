@@ -17,6 +17,8 @@ use crate::body::DecodedLength;
 #[cfg(feature = "server")]
 use crate::common::date;
 use crate::error::Parse;
+#[cfg(all(feature = "client", feature = "ffi"))]
+use crate::ext::EncodedHeaders;
 use crate::ext::HeaderCaseMap;
 use crate::headers;
 use crate::proto::h1::{
@@ -926,7 +928,14 @@ impl Http1Transaction for Client {
 
             let mut keep_alive = version == Version::HTTP_11;
 
-            let mut header_case_map = if ctx.preserve_header_case {
+            // The raw header spans already keep the original casing, so the
+            // case map can be rebuilt from them if it's ever needed.
+            #[cfg(feature = "ffi")]
+            let preserve_header_case = ctx.preserve_header_case && !ctx.raw_headers;
+            #[cfg(not(feature = "ffi"))]
+            let preserve_header_case = ctx.preserve_header_case;
+
+            let mut header_case_map = if preserve_header_case {
                 Some(HeaderCaseMap::default())
             } else {
                 None
@@ -970,7 +979,16 @@ impl Http1Transaction for Client {
 
             #[cfg(feature = "ffi")]
             if ctx.raw_headers {
-                extensions.insert(crate::ffi::RawHeaders(crate::ffi::hyper_buf(slice)));
+                let spans = headers_indices[..headers_len]
+                    .iter()
+                    .map(|header| crate::ffi::hyper_header_span {
+                        name_offset: header.name.0,
+                        name_len: header.name.1 - header.name.0,
+                        value_offset: header.value.0,
+                        value_len: header.value.1 - header.value.0,
+                    })
+                    .collect();
+                extensions.insert(crate::ffi::RawHeaders::new(slice, spans));
             }
 
             let head = MessageHead {
@@ -1036,6 +1054,22 @@ impl Http1Transaction for Client {
         }
         extend(dst, b"\r\n");
 
+        #[cfg(feature = "ffi")]
+        {
+            if let Some(encoded) = msg.head.extensions.get::<EncodedHeaders>() {
+                write_headers_with_encoded(
+                    &msg.head.headers,
+                    encoded,
+                    msg.head.extensions.get::<HeaderCaseMap>(),
+                    dst,
+                    msg.title_case_headers,
+                );
+                extend(dst, b"\r\n");
+                msg.head.headers.clear(); //TODO: remove when switching to drain()
+                return Ok(body);
+            }
+        }
+
         if let Some(orig_headers) = msg.head.extensions.get::<HeaderCaseMap>() {
             write_headers_original_case(
                 &msg.head.headers,
@@ -1395,6 +1429,42 @@ fn write_headers_original_case(
     }
 }
 
+/// Write a block of headers that was encoded ahead of time, and then the
+/// headers it doesn't hold, like `write_headers_original_case` would.
+#[cfg(all(feature = "client", feature = "ffi"))]
+fn write_headers_with_encoded(
+    headers: &HeaderMap,
+    encoded: &EncodedHeaders,
+    orig_case: Option<&HeaderCaseMap>,
+    dst: &mut Vec<u8>,
+    title_case_headers: bool,
+) {
+    extend(dst, encoded.block());
+
+    for name in headers.keys() {
+        if encoded.contains(name) {
+            continue;
+        }
+        let mut names = orig_case.map(|orig_case| orig_case.get_all_internal(name));
+
+        for value in headers.get_all(name) {
+            match names.as_mut().and_then(|names| names.next()) {
+                Some(orig_name) => extend(dst, orig_name.as_ref()),
+                None if title_case_headers => title_case(dst, name.as_str().as_bytes()),
+                None => extend(dst, name.as_str().as_bytes()),
+            }
+
+            if value.is_empty() {
+                extend(dst, b":\r\n");
+            } else {
+                extend(dst, b": ");
+                extend(dst, value.as_bytes());
+                extend(dst, b"\r\n");
+            }
+        }
+    }
+}
+
 struct FastWrite<'a>(&'a mut Vec<u8>);
 
 impl<'a> fmt::Write for FastWrite<'a> {
@@ -1474,6 +1544,45 @@ mod tests {
         assert_eq!(msg.head.headers["Content-Length"], "0");
     }
 
+    #[cfg(feature = "ffi")]
+    #[test]
+    fn test_parse_response_raw_header_spans() {
+        let mut raw = BytesMut::from("HTTP/1.1 200 OK\r\nX-Foo: bar\r\ncontent-length: 0\r\n\r\n");
+        let ctx = ParseContext {
+            cached_headers: &mut None,
+            req_method: &mut Some(crate::Method::GET),
+            h1_parser_config: Default::default(),
+            preserve_header_case: true,
+            h09_responses: false,
+            on_informational: &mut None,
+            raw_headers: true,
+        };
+        let msg = Client::parse(&mut raw, ctx).unwrap().unwrap();
+        assert_eq!(msg.head.headers.len(), 2);
+        // The spans replace the case map.
+        assert!(msg.head.extensions.get::<HeaderCaseMap>().is_none());
+
+        let raw = msg.head.extensions.get::<crate::ffi::RawHeaders>().unwrap();
+        let headers = raw
+            .spans
+            .iter()
+            .map(|span| {
+                let bytes = &raw.buf.0[..];
+                (
+                    &bytes[span.name_offset..span.name_offset + span.name_len],
+                    &bytes[span.value_offset..span.value_offset + span.value_len],
+                )
+            })
+            .collect::<Vec<_>>();
+        assert_eq!(
+            headers,
+            [
+                (&b"X-Foo"[..], &b"bar"[..]),
+                (&b"content-length"[..], &b"0"[..]),
+            ]
+        );
+    }
+
     #[test]
     fn test_parse_request_errors() {
         let mut raw = BytesMut::from("GET htt:p// HTTP/1.1\r\nHost: hyper.rs\r\n\r\n");
@@ -2251,6 +2360,53 @@ mod tests {
                 .as_ref(),
         );
     }
+    #[cfg(feature = "ffi")]
+    #[test]
+    fn test_client_request_encode_pre_encoded() {
+        use crate::ext::EncodedHeaders;
+        use crate::proto::BodyLength;
+        use http::header::{HeaderValue, CONTENT_LENGTH};
+
+        let mut head = MessageHead::default();
+        head.headers
+            .insert("content-length", HeaderValue::from_static("10"));
+        head.headers
+            .insert("x-api-key", HeaderValue::from_static("secret"));
+
+        let mut orig_headers = HeaderCaseMap::default();
+        orig_headers.insert(CONTENT_LENGTH, "CONTENT-LENGTH".into());
+        orig_headers.insert("x-api-key".parse().unwrap(), "X-Api-Key".into());
+
+        let encoded = EncodedHeaders::new(&head.headers, &orig_headers).expect("encoded");
+        // Content-Length may be changed by the encoder, so it isn't cached.
+        assert_eq!(encoded.block(), b"X-Api-Key: secret\r\n");
+
+        // Headers added later are written after the block.
+        head.headers
+            .insert("x-trace", HeaderValue::from_static("abc"));
+        head.extensions.insert(orig_headers);
+        head.extensions.insert(encoded);
+
+        let mut vec = Vec::new();
+        Client::encode(
+            Encode {
+                head: &mut head,
+                body: Some(BodyLength::Known(10)),
+                keep_alive: true,
+                req_method: &mut None,
+                title_case_headers: true,
+            },
+            &mut vec,
+        )
+        .unwrap();
+
+        assert_eq!(
+            &*vec,
+            b"GET / HTTP/1.1\r\nX-Api-Key: secret\r\nCONTENT-LENGTH: 10\r\nX-Trace: abc\r\n\r\n"
+                .as_ref(),
+        );
+    }
+
     #[test]
     fn test_client_request_encode_orig_and_title_case() {
         use crate::proto::BodyLength;